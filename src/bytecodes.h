@@ -75,6 +75,7 @@ namespace toit {
   FORMAT(OP_SII, 3)              \
   FORMAT(OP_SB_SB, 5)            \
   FORMAT(OP_SU_SU, 5)            \
+  FORMAT(OP_BS_SO_BS_BU, 6)      \
 
 
 // Format Toit bytecodes
@@ -156,6 +157,7 @@ enum BytecodeFormat {
   BYTECODE(INVOKE_VIRTUAL_WIDE,        5, OP_SS_SO, "invoke virtual wide")     \
   BYTECODE(INVOKE_VIRTUAL_GET,         3, OP_SO, "invoke virtual get")         \
   BYTECODE(INVOKE_VIRTUAL_SET,         3, OP_SO, "invoke virtual set")         \
+  BYTECODE(INVOKE_VIRTUAL_TAIL,        6, OP_BS_SO_BS_BU, "invoke virtual tail") \
   \
   BYTECODE(INVOKE_EQ,                  1, OP, "invoke eq")                     \
   BYTECODE(INVOKE_LT,                  1, OP, "invoke lt")                     \
@@ -22,6 +22,7 @@
 #include "symbol.h"
 #include "token.h"
 #include "toitdoc.h"
+#include "zone.h"
 
 namespace toit {
 namespace compiler {
@@ -97,7 +98,7 @@ NODES(DECLARE)
 #undef DECLARE
 };
 
-class Node {
+class Node : public ZoneAllocated {
  public:
   Node() : range_(Source::Range::invalid()) {}
   virtual void accept(Visitor* visitor) = 0;
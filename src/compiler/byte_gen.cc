@@ -600,6 +600,24 @@ void ByteGen::_generate_call(Call* node,
   if (is_for_effect()) __ pop(1);
 }
 
+// Whether the marked tail call [node] can reuse the frame of the current
+// method. Must be called when the arguments are on the stack.
+bool ByteGen::can_tail_call(Call* node, int arity) {
+  if (!node->is_tail_call()) return false;
+  // Returns from within blocks are non-local and unwind the block frames.
+  if (!outer_emitters_stack_.empty()) return false;
+  // Blocks that are created by this method live in its frame. Block
+  // parameters live in the frames of callers and can be passed on.
+  for (auto argument : node->arguments()) {
+    if (argument->is_ReferenceLocal() &&
+        argument->as_ReferenceLocal()->target()->is_Parameter()) {
+      continue;
+    }
+    if (argument->is_Code() || argument->is_block()) return false;
+  }
+  return emitter()->can_tail_call(arity);
+}
+
 void ByteGen::visit_Super(Super* node) {
   if (node->expression() != null) {
     visit(node->expression());
@@ -637,7 +655,7 @@ void ByteGen::visit_CallStatic(CallStatic* node) {
   int target_index = dispatch_table()->slot_index_for(node->target()->target());
 
   auto compile_invocation = [&, this, target_index, arity]() {
-    __ invoke_global(target_index, arity, node->is_tail_call());
+    __ invoke_global(target_index, arity, can_tail_call(node, arity));
   };
 
   _generate_call(node, compile_target, arguments, compile_invocation);
@@ -660,7 +678,8 @@ void ByteGen::visit_CallVirtual(CallVirtual* node) {
     Selector<PlainShape> selector(node->target()->selector(), shape.to_plain_shape());
     int offset = dispatch_table()->dispatch_offset_for(selector);
     if (offset != -1) {
-      __ invoke_virtual(node->opcode(), offset, arity);
+      bool is_tail_call = node->opcode() == INVOKE_VIRTUAL && can_tail_call(node, arity);
+      __ invoke_virtual(node->opcode(), offset, arity, is_tail_call);
     } else {
       // No method in the whole program implements that selector.
       // Pop all arguments, and push the name of the method on the stack.
@@ -843,10 +862,11 @@ void ByteGen::visit_Return(Return* node) {
       emitter()->remember(1);
     } else {
       visit_for_value(node->value());
-      if (node->value()->is_CallStatic() &&
-          node->value()->as_Call()->is_tail_call()) {
+      Opcode previous = emitter()->previous_opcode();
+      if (node->value()->is_Call() &&
+          node->value()->as_Call()->is_tail_call() &&
+          (previous == INVOKE_STATIC_TAIL || previous == INVOKE_VIRTUAL_TAIL)) {
         // Don't do anything. The call will return for us.
-        ASSERT(emitter()->previous_opcode() == INVOKE_STATIC_TAIL);
       } else {
         __ ret();
       }
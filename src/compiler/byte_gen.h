@@ -166,6 +166,7 @@ class ByteGen : private ir::Visitor {
                       const T& compile_target,
                       List<ir::Expression*> arguments,
                       const T2& compile_invocation);
+  bool can_tail_call(ir::Call* node, int arity);
   void visit_Super(ir::Super* node);
   void visit_CallConstructor(ir::CallConstructor* node);
   void visit_CallStatic(ir::CallStatic* node);
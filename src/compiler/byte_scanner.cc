@@ -0,0 +1,252 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "byte_scanner.h"
+
+#include "../flags.h"
+#include "../utils.h"
+
+#if defined(__x86_64__)
+#include <emmintrin.h>  // SSE2 primitives.
+#define TOIT_VECTOR_SCANNER
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define TOIT_VECTOR_SCANNER
+#endif
+
+namespace toit {
+namespace compiler {
+
+enum {
+  BLANK = 1 << 0,
+  SPACE = 1 << 1,
+  IDENTIFIER_PART = 1 << 2,
+  LINE_TEXT = 1 << 3,
+  STRING_TEXT = 1 << 4,
+  COMMENT_TEXT = 1 << 5,
+};
+
+// The classes each byte belongs to.
+static const uint8 character_classes[256] = {
+  0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x39, 0x20, 0x38, 0x38, 0x20, 0x38, 0x38,
+  0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38,
+  0x3b, 0x38, 0x28, 0x38, 0x28, 0x38, 0x38, 0x38, 0x38, 0x38, 0x18, 0x38, 0x38, 0x38, 0x38, 0x18,
+  0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38,
+  0x38, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c,
+  0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x38, 0x08, 0x38, 0x38, 0x3c,
+  0x38, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c,
+  0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x3c, 0x38, 0x38, 0x38, 0x38, 0x38,
+  0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38,
+  0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38,
+  0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38,
+  0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38,
+  0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38,
+  0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38,
+  0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38,
+  0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38,
+};
+
+#ifdef TOIT_VECTOR_SCANNER
+
+static const int VECTOR_SIZE = 16;
+
+#if defined(__x86_64__)
+
+typedef __m128i Vector;
+
+static inline Vector load(const uint8* from) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(from));
+}
+
+static inline Vector equals(Vector bytes, uint8 c) {
+  return _mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(c)));
+}
+
+static inline Vector either(Vector a, Vector b) {
+  return _mm_or_si128(a, b);
+}
+
+static inline Vector to_lower_letter(Vector bytes) {
+  return _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+}
+
+// Bytes in [low, low + count[.
+// SSE2 only has signed comparisons, so the range is moved to the bottom of
+// the signed range first.
+static inline Vector in_range(Vector bytes, uint8 low, uint8 count) {
+  Vector shifted = _mm_sub_epi8(bytes, _mm_set1_epi8(static_cast<char>(low - 0x80)));
+  return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(count - 0x80)));
+}
+
+// Returns the index of the first byte that is set in the mask, or -1.
+static inline int first_set(Vector mask) {
+  int bits = _mm_movemask_epi8(mask);
+  return bits == 0 ? -1 : Utils::ctz(bits);
+}
+
+// Returns the index of the first byte that is clear in the mask, or -1.
+static inline int first_clear(Vector mask) {
+  int bits = ~_mm_movemask_epi8(mask) & 0xffff;
+  return bits == 0 ? -1 : Utils::ctz(bits);
+}
+
+#else  // __aarch64__
+
+typedef uint8x16_t Vector;
+
+static inline Vector load(const uint8* from) {
+  return vld1q_u8(from);
+}
+
+static inline Vector equals(Vector bytes, uint8 c) {
+  return vceqq_u8(bytes, vdupq_n_u8(c));
+}
+
+static inline Vector either(Vector a, Vector b) {
+  return vorrq_u8(a, b);
+}
+
+static inline Vector to_lower_letter(Vector bytes) {
+  return vorrq_u8(bytes, vdupq_n_u8(0x20));
+}
+
+// Bytes in [low, low + count[.
+static inline Vector in_range(Vector bytes, uint8 low, uint8 count) {
+  return vcltq_u8(vsubq_u8(bytes, vdupq_n_u8(low)), vdupq_n_u8(count));
+}
+
+// NEON has no movemask. Narrowing each 16-bit lane by 4 bits leaves a
+// 64-bit word with one nibble per byte of the mask.
+static inline int first_set(Vector mask) {
+  uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(mask), 4);
+  uint64 bits = vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+  return bits == 0 ? -1 : Utils::ctz(bits) >> 2;
+}
+
+static inline int first_clear(Vector mask) {
+  return first_set(vmvnq_u8(mask));
+}
+
+#endif
+
+// Each class gives the index of the first byte of a vector that doesn't
+// belong to it, or -1.
+struct Blanks {
+  static const int CLASS = BLANK;
+  static int first_other(Vector bytes) {
+    return first_clear(either(equals(bytes, ' '), equals(bytes, '\t')));
+  }
+};
+
+struct Spaces {
+  static const int CLASS = SPACE;
+  static int first_other(Vector bytes) {
+    return first_clear(equals(bytes, ' '));
+  }
+};
+
+struct IdentifierParts {
+  static const int CLASS = IDENTIFIER_PART;
+  static int first_other(Vector bytes) {
+    Vector letters = in_range(to_lower_letter(bytes), 'a', 26);
+    Vector digits = in_range(bytes, '0', 10);
+    return first_clear(either(either(letters, digits), equals(bytes, '_')));
+  }
+};
+
+struct LineText {
+  static const int CLASS = LINE_TEXT;
+  static int first_other(Vector bytes) {
+    return first_set(either(equals(bytes, '\n'), equals(bytes, '\r')));
+  }
+};
+
+struct StringText {
+  static const int CLASS = STRING_TEXT;
+  static int first_other(Vector bytes) {
+    Vector quotes = either(equals(bytes, '"'), equals(bytes, '\\'));
+    Vector newlines = either(equals(bytes, '\n'), equals(bytes, '\r'));
+    return first_set(either(either(quotes, newlines), equals(bytes, '$')));
+  }
+};
+
+struct CommentText {
+  static const int CLASS = COMMENT_TEXT;
+  static int first_other(Vector bytes) {
+    Vector delimiters = either(equals(bytes, '*'), equals(bytes, '/'));
+    return first_set(either(delimiters, equals(bytes, '\\')));
+  }
+};
+
+#else  // TOIT_VECTOR_SCANNER
+
+struct Blanks { static const int CLASS = BLANK; };
+struct Spaces { static const int CLASS = SPACE; };
+struct IdentifierParts { static const int CLASS = IDENTIFIER_PART; };
+struct LineText { static const int CLASS = LINE_TEXT; };
+struct StringText { static const int CLASS = STRING_TEXT; };
+struct CommentText { static const int CLASS = COMMENT_TEXT; };
+
+#endif  // TOIT_VECTOR_SCANNER
+
+template<typename Class>
+static inline const uint8* skip(const uint8* from, const uint8* to) {
+#ifdef TOIT_VECTOR_SCANNER
+  if (!Flags::scalar_scanner) {
+    while (to - from >= VECTOR_SIZE) {
+      int index = Class::first_other(load(from));
+      if (index >= 0) return from + index;
+      from += VECTOR_SIZE;
+    }
+  }
+#endif
+  while (from < to && (character_classes[*from] & Class::CLASS) != 0) from++;
+  return from;
+}
+
+const uint8* ByteScanner::skip_blanks(const uint8* from, const uint8* to) {
+  return skip<Blanks>(from, to);
+}
+
+const uint8* ByteScanner::skip_spaces(const uint8* from, const uint8* to) {
+  return skip<Spaces>(from, to);
+}
+
+const uint8* ByteScanner::skip_identifier_part(const uint8* from, const uint8* to) {
+  return skip<IdentifierParts>(from, to);
+}
+
+const uint8* ByteScanner::skip_line_text(const uint8* from, const uint8* to) {
+  return skip<LineText>(from, to);
+}
+
+const uint8* ByteScanner::skip_string_text(const uint8* from, const uint8* to) {
+  return skip<StringText>(from, to);
+}
+
+const uint8* ByteScanner::skip_comment_text(const uint8* from, const uint8* to) {
+  return skip<CommentText>(from, to);
+}
+
+bool ByteScanner::has_vector_support() {
+#ifdef TOIT_VECTOR_SCANNER
+  return true;
+#else
+  return false;
+#endif
+}
+
+} // namespace toit::compiler
+} // namespace toit
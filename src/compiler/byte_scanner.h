@@ -0,0 +1,54 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "../top.h"
+
+namespace toit {
+namespace compiler {
+
+/// Bulk skipping of source text for the scanner.
+///
+/// Each function returns a pointer to the first byte in [from, to[ that
+///   doesn't belong to the skipped class of characters, or `to` if all of
+///   them do. The scanner still handles the byte it stops at (including
+///   '\r\n' pairs and escapes) one character at a time.
+///
+/// On x86-64 (SSE2) and arm64 (NEON) the text is classified 16 bytes at a
+///   time. Elsewhere, or with `-Xscalar_scanner`, a character-class table
+///   is used. Both paths return the same result.
+class ByteScanner {
+ public:
+  // ' ' and '\t'.
+  static const uint8* skip_blanks(const uint8* from, const uint8* to);
+  // ' ' only.
+  static const uint8* skip_spaces(const uint8* from, const uint8* to);
+  // Letters, digits and '_'. Dashes and LSP-selection markers need context
+  //   and are not part of this class.
+  static const uint8* skip_identifier_part(const uint8* from, const uint8* to);
+  // Everything but '\r' and '\n'.
+  static const uint8* skip_line_text(const uint8* from, const uint8* to);
+  // Everything but '"', '\\', '$', '\r' and '\n'.
+  static const uint8* skip_string_text(const uint8* from, const uint8* to);
+  // Everything but '*', '/' and '\\'.
+  static const uint8* skip_comment_text(const uint8* from, const uint8* to);
+
+  // Whether this build classifies bytes with vector instructions.
+  static bool has_vector_support();
+};
+
+} // namespace toit::compiler
+} // namespace toit
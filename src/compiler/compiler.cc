@@ -18,6 +18,7 @@
 #include <errno.h>
 #ifdef TOIT_POSIX
 #include <sys/param.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 #endif
 #include <string>
@@ -58,9 +59,12 @@
 #include "tree_roots.h"
 #include "type_check.h"
 #include "util.h"
+#include "zone.h"
 
 #include "../objects_inline.h"
+#include "../os.h"
 #include "../snapshot.h"
+#include "../snapshot_compression.h"
 #include "../flags.h"
 #include "../utils.h"
 
@@ -151,12 +155,19 @@ class Pipeline {
   PipelineConfiguration configuration_;
   SymbolCanonicalizer symbols_;
   ToitdocRegistry toitdoc_registry_;
+  // While non-null, `_load_import` collects the paths of the imported files
+  //   here, instead of loading them.
+  std::vector<std::string>* prefetch_paths_ = null;
 
   ast::Unit* _parse_source(Source* source);
 
   Source* _load_import(ast::Unit* unit,
                        ast::Import* import,
                        const PackageLock& package_lock);
+  void _prefetch_imports(const std::vector<ast::Unit*>& units,
+                         size_t from,
+                         size_t to,
+                         const PackageLock& package_lock);
   std::vector<ast::Unit*> _parse_units(List<const char*> source_paths,
                                        const PackageLock& package_lock);
   ir::Program* resolve(const std::vector<ast::Unit*>& units,
@@ -1439,6 +1450,10 @@ Source* Pipeline::_load_import(ast::Unit* unit,
   }
   {
     std::string import_path = import_path_builder.buffer();
+    if (prefetch_paths_ != null) {
+      if (!source_manager()->is_loaded(import_path)) prefetch_paths_->push_back(import_path);
+      return null;
+    }
     result_package = package_lock.package_for(import_path, filesystem());
     auto load_result = source_manager()->load_file(import_path, result_package);
     if (load_result.status == SourceManager::LoadResult::OK) {
@@ -1452,6 +1467,7 @@ Source* Pipeline::_load_import(ast::Unit* unit,
 
   done:
 
+  if (prefetch_paths_ != null) return null;
 
   if (lsp_path != null) {
     lsp()->selection_handler()->import_path(lsp_path,
@@ -1498,6 +1514,32 @@ Source* Pipeline::_load_file(const char* path, const PackageLock& package_lock)
   exit(1);
 }
 
+// Resolves the imports of the given units without loading them, and reads
+// the imported files in parallel. Errors are reported when the imports are
+// loaded for real.
+void Pipeline::_prefetch_imports(const std::vector<ast::Unit*>& units,
+                                 size_t from,
+                                 size_t to,
+                                 const PackageLock& package_lock) {
+  if (!filesystem()->can_prefetch()) return;
+  std::vector<std::string> paths;
+  Diagnostics* diagnostics = configuration_.diagnostics;
+  NullDiagnostics null_diagnostics(diagnostics);
+  configuration_.diagnostics = &null_diagnostics;
+  prefetch_paths_ = &paths;
+  for (size_t i = from; i < to; i++) {
+    auto unit = units[i];
+    if (unit->is_error_unit()) continue;
+    for (auto import : unit->imports()) {
+      if (import->unit() != null) continue;
+      _load_import(unit, import, package_lock);
+    }
+  }
+  prefetch_paths_ = null;
+  configuration_.diagnostics = diagnostics;
+  filesystem()->prefetch(paths);
+}
+
 std::vector<ast::Unit*> Pipeline::_parse_units(List<const char*> source_paths,
                                                const PackageLock& package_lock) {
   const char* sdk_lib_dir = source_manager()->library_root();
@@ -1551,7 +1593,14 @@ std::vector<ast::Unit*> Pipeline::_parse_units(List<const char*> source_paths,
 
   // Transitively parse the source_files.
   // Note that we modify the vector inside the loop, growing it.
+  // The files imported by the units that were added since the last prefetch
+  //   are read in parallel before we get to them.
+  size_t prefetched_until = 0;
   for (size_t i = 0; i < units.size(); i++) {
+    if (i == prefetched_until) {
+      prefetched_until = units.size();
+      _prefetch_imports(units, i, prefetched_until, package_lock);
+    }
     auto unit = units[i];
     auto imports = unit->imports();
     for (auto import : imports) {
@@ -1783,6 +1832,29 @@ static void sort_classes(List<ir::Class*> classes) {
   }
 }
 
+static void report_zone(Zone* zone) {
+  printf("Zone '%s': %zu KB allocated, %zu KB reserved\n",
+         zone->name(),
+         zone->allocated() / KB,
+         zone->reserved() / KB);
+}
+
+static void report_time_and_peak_memory(int64 start_time) {
+  int64 elapsed_us = OS::get_monotonic_time() - start_time;
+  printf("Compilation time: %lld ms\n", static_cast<long long>(elapsed_us / 1000));
+#ifdef TOIT_POSIX
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef TOIT_DARWIN
+    long peak_kb = usage.ru_maxrss / KB;  // Reported in bytes.
+#else
+    long peak_kb = usage.ru_maxrss;  // Reported in kilobytes.
+#endif
+    printf("Peak memory: %ld KB\n", peak_kb);
+  }
+#endif
+}
+
 Pipeline::Result Pipeline::run(List<const char*> source_paths, bool propagate) {
   // TODO(florian): this is hackish. We want to analyze asserts also in release mode,
   // but then remove the code when we generate code.
@@ -1804,7 +1876,29 @@ Pipeline::Result Pipeline::run(List<const char*> source_paths, bool propagate) {
     check_sdk(package_lock.sdk_constraint(), diagnostics());
   }
 
-  auto units = _parse_units(source_paths, package_lock);
+  // The AST and the IR of each resolution pass are allocated in their own
+  // zones. They are released as soon as the snapshot and its source map
+  // have been generated.
+  int64 start_time = OS::get_monotonic_time();
+  Zone ast_zone("ast");
+  Zone ir_zone("ir");
+  Zone optimized_ir_zone("optimized ir");
+
+  std::vector<ast::Unit*> units;
+  {
+    ZoneScope scope(&ast_zone);
+    auto before = filesystem()->statistics();
+    units = _parse_units(source_paths, package_lock);
+    if (Flags::report_filesystem) {
+      auto after = filesystem()->statistics();
+      printf("Filesystem: %d probes, %d stats, %d directory reads, %d file reads (%d prefetched)\n",
+             after.probes - before.probes,
+             after.stats - before.stats,
+             after.directory_reads - before.directory_reads,
+             after.file_reads - before.file_reads,
+             after.prefetched - before.prefetched);
+    }
+  }
 
   if (configuration_.dep_file != null) {
     ASSERT(configuration_.dep_format != Compiler::DepFormat::none);
@@ -1829,6 +1923,7 @@ Pipeline::Result Pipeline::run(List<const char*> source_paths, bool propagate) {
 
   if (configuration_.parse_only) return Result::invalid();
 
+  ZoneScope ir_scope(&ir_zone);
   ir::Program* ir_program = resolve(units, ENTRY_UNIT_INDEX, CORE_UNIT_INDEX);
   sort_classes(ir_program->classes());
 
@@ -1873,6 +1968,7 @@ Pipeline::Result Pipeline::run(List<const char*> source_paths, bool propagate) {
 
   SourceMapper optimized_source_mapper(source_manager());
   if (run_optimizations && configuration_.optimization_level >= 2) {
+    ZoneScope optimized_ir_scope(&optimized_ir_zone);
     bool quiet = true;
     ir_program = resolve(units, ENTRY_UNIT_INDEX, CORE_UNIT_INDEX, quiet);
     sort_classes(ir_program->classes());
@@ -1891,6 +1987,11 @@ Pipeline::Result Pipeline::run(List<const char*> source_paths, bool propagate) {
     delete types;
   }
 
+  if (Flags::report_compiler_memory) {
+    report_zone(&ast_zone);
+    report_zone(&ir_zone);
+    report_zone(&optimized_ir_zone);
+  }
   if (propagate) {
     TypeDatabase* types = TypeDatabase::compute(program);
     auto json = types->as_json();
@@ -1902,8 +2003,32 @@ Pipeline::Result Pipeline::run(List<const char*> source_paths, bool propagate) {
   generator.generate(program);
   int source_map_size;
   uint8* source_map_data = source_mapper->cook(&source_map_size);
+  // The source mappers refer to the IR classes, so the zones can only be
+  // freed once the source map has been cooked.
+  ast_zone.free_all();
+  ir_zone.free_all();
+  optimized_ir_zone.free_all();
   int snapshot_size;
   uint8* snapshot = generator.take_buffer(&snapshot_size);
+  if (Flags::report_snapshot) {
+    printf("Snapshot: %d bytes\n", snapshot_size);
+  }
+  if (Flags::compress_snapshot) {
+    int compressed_size;
+    uint8* compressed = CompressedSnapshot::compress(snapshot, snapshot_size, &compressed_size);
+    if (Flags::report_snapshot) {
+      printf("Compressed snapshot: %d bytes in %d byte blocks (%.1f%%)\n",
+             compressed_size,
+             CompressedSnapshot::BLOCK_SIZE,
+             100.0 * compressed_size / snapshot_size);
+    }
+    free(snapshot);
+    snapshot = compressed;
+    snapshot_size = compressed_size;
+  }
+  if (Flags::report_compiler_memory) {
+    report_time_and_peak_memory(start_time);
+  }
   return {
     .snapshot = snapshot,
     .snapshot_size = snapshot_size,
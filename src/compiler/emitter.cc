@@ -370,6 +370,14 @@ void Emitter::invoke_global(int index, int arity, bool is_tail_call) {
   stack_.push(ExpressionStack::OBJECT);
 }
 
+bool Emitter::can_tail_call(int arity) const {
+  if (height() > MAX_BYTECODE_VALUE || this->arity() > MAX_BYTECODE_VALUE) return false;
+  for (int i = arity; i < height(); i++) {
+    if (stack_.type(i) != ExpressionStack::OBJECT) return false;
+  }
+  return true;
+}
+
 void Emitter::invoke_block(int arity) {
   ASSERT(arity >= 1);
   ASSERT(stack_.type(arity - 1) == ExpressionStack::BLOCK);
@@ -378,10 +386,16 @@ void Emitter::invoke_block(int arity) {
   stack_.push(ExpressionStack::OBJECT);
 }
 
-void Emitter::invoke_virtual(Opcode opcode, int offset, int arity) {
+void Emitter::invoke_virtual(Opcode opcode, int offset, int arity, bool is_tail_call) {
   ASSERT(offset >= 0);
   ASSERT(arity >= 1);
-  if (opcode >= INVOKE_EQ && opcode <= INVOKE_AT_PUT) {
+  if (is_tail_call) {
+    ASSERT(opcode == INVOKE_VIRTUAL);
+    emit(INVOKE_VIRTUAL_TAIL, arity - 1);
+    emit_uint16(offset);
+    emit_uint8(height());
+    emit_uint8(this->arity());
+  } else if (opcode >= INVOKE_EQ && opcode <= INVOKE_AT_PUT) {
     emit_opcode(opcode);
   } else if (opcode == INVOKE_VIRTUAL_GET || opcode == INVOKE_VIRTUAL_SET) {
     emit_opcode(opcode);
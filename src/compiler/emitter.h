@@ -145,7 +145,12 @@ class Emitter {
   void allocate(int class_id);
 
   void invoke_global(int index, int arity, bool is_tail_call = false);
-  void invoke_virtual(Opcode opcode, int offset, int arity);
+  void invoke_virtual(Opcode opcode, int offset, int arity, bool is_tail_call = false);
+
+  // Whether a call with the given arity, whose arguments are already on the
+  // stack, can replace the current frame. Blocks that live in the frame
+  // must outlive the call, so their presence prevents tail calls.
+  bool can_tail_call(int arity) const;
 
   void invoke_block(int arity);
   void invoke_lambda_tail(int parameters, int max_capture_count);
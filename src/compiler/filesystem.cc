@@ -18,6 +18,7 @@
 #include <vector>
 #include <limits.h>
 
+#include "../os.h"
 #include "../top.h"
 #include "../utils.h"
 
@@ -29,6 +30,14 @@
 namespace toit {
 namespace compiler {
 
+Filesystem::~Filesystem() {
+  free(const_cast<char*>(cwd_));
+  // Prefetched files that were never read.
+  for (auto entry : prefetched_.underlying_map()) {
+    free(const_cast<uint8*>(entry.second.content));
+  }
+}
+
 const char* Filesystem::cwd() {
   if (cwd_ == null) {
     char buffer[PATH_MAX];
@@ -212,27 +221,187 @@ void Filesystem::dirname(const char* file_path, char* dir_path, int dir_path_siz
 
 bool Filesystem::is_regular_file(const char* path) {
   auto probe = intercepted_.find(std::string(path));
-  if (probe == intercepted_.end()) return do_is_regular_file(path);
-  return true;
+  if (probe != intercepted_.end()) return true;
+  if (cache_enabled_) return cached_path_kind(path) == PathKind::REGULAR_FILE;
+  return do_is_regular_file(path);
 }
 
 bool Filesystem::is_directory(const char* path) {
   auto probe = intercepted_.find(std::string(path));
-  if (probe == intercepted_.end()) return do_is_directory(path);
-  return false;
+  if (probe != intercepted_.end()) return false;
+  if (cache_enabled_) return cached_path_kind(path) == PathKind::DIRECTORY;
+  return do_is_directory(path);
 }
 
 bool Filesystem::exists(const char* path) {
   auto probe = intercepted_.find(std::string(path));
-  if (probe == intercepted_.end()) return do_exists(path);
-  return true;
+  if (probe != intercepted_.end()) return true;
+  if (cache_enabled_) return cached_path_kind(path) != PathKind::MISSING;
+  return do_exists(path);
 }
 
 const uint8* Filesystem::read_content(const char* path, int* size) {
   auto probe = intercepted_.find(std::string(path));
-  if (probe == intercepted_.end()) return do_read_content(path, size);
-  *size = probe->second.size;
-  return probe->second.content;
+  if (probe != intercepted_.end()) {
+    *size = probe->second.size;
+    return probe->second.content;
+  }
+  if (cache_enabled_) {
+    auto prefetched = prefetched_.find(std::string(path));
+    if (prefetched != prefetched_.end()) {
+      // The caller takes ownership of the content.
+      auto content = prefetched->second.content;
+      *size = prefetched->second.size;
+      prefetched_.remove(std::string(path));
+      return content;
+    }
+    statistics_.file_reads++;
+  }
+  return do_read_content(path, size);
+}
+
+Filesystem::PathKind Filesystem::do_path_kind(const char* path) {
+  if (do_is_regular_file(path)) return PathKind::REGULAR_FILE;
+  if (do_is_directory(path)) return PathKind::DIRECTORY;
+  if (do_exists(path)) return PathKind::OTHER;
+  return PathKind::MISSING;
+}
+
+Filesystem::PathKind Filesystem::cached_path_kind(const char* path) {
+  statistics_.probes++;
+  std::string key(path);
+  auto probe = path_kinds_.find(key);
+  if (probe != path_kinds_.end()) return probe->second;
+
+  // Listing the parent directory answers the probes for all its entries
+  // with a single request.
+  if (list_parent_directory(key) && !unresolved_entries_.contains(key)) {
+    probe = path_kinds_.find(key);
+    if (probe != path_kinds_.end()) return probe->second;
+#ifdef TOIT_LINUX
+    // The name isn't in the listing. On case-insensitive filesystems it could
+    // still exist with a different spelling, so we only trust the listing on
+    // Linux.
+    path_kinds_[key] = PathKind::MISSING;
+    return PathKind::MISSING;
+#endif
+  }
+
+  statistics_.stats++;
+  PathKind kind = do_path_kind(path);
+  path_kinds_[key] = kind;
+  return kind;
+}
+
+// Returns whether the parent directory of the path has been listed
+// successfully.
+bool Filesystem::list_parent_directory(const std::string& path) {
+  int separator = static_cast<int>(path.size()) - 1;
+  while (separator >= 0 && !is_path_separator(path[separator])) separator--;
+  // Only absolute paths that end with a name have a useful parent.
+  if (separator <= 0 || separator == static_cast<int>(path.size()) - 1) return false;
+  if (!is_absolute(path.c_str())) return false;
+
+  std::string directory = path.substr(0, separator);
+  auto probe = listed_directories_.find(directory);
+  if (probe != listed_directories_.end()) return probe->second;
+
+  char separator_char = path[separator];
+  bool succeeded = list_directory_with_kinds(directory.c_str(), [&](const char* name, const PathKind* kind) {
+    std::string entry = directory + separator_char + name;
+    if (kind == null) {
+      unresolved_entries_.insert(entry);
+    } else {
+      path_kinds_.add(entry, *kind);
+    }
+  });
+  if (succeeded) {
+    statistics_.directory_reads++;
+    path_kinds_.add(directory, PathKind::DIRECTORY);
+  }
+  listed_directories_[directory] = succeeded;
+  return succeeded;
+}
+
+class PrefetchThread : public Thread {
+ public:
+  struct PrefetchedFile {
+    const uint8* content;
+    int size;
+  };
+
+  PrefetchThread(Filesystem* filesystem,
+                 const std::vector<std::string>* paths,
+                 std::vector<PrefetchedFile>* results,
+                 int first,
+                 int stride)
+      : Thread("prefetch")
+      , filesystem_(filesystem)
+      , paths_(paths)
+      , results_(results)
+      , first_(first)
+      , stride_(stride) {}
+
+  // Reads every stride'th file, starting at first.
+  // Each thread writes to its own slots of the results, so no locking is needed.
+  void read_files() {
+    for (size_t i = first_; i < paths_->size(); i += stride_) {
+      int size = 0;
+      auto content = filesystem_->do_read_content((*paths_)[i].c_str(), &size);
+      (*results_)[i] = { content, size };
+    }
+  }
+
+ protected:
+  void entry() { read_files(); }
+
+ private:
+  Filesystem* filesystem_;
+  const std::vector<std::string>* paths_;
+  std::vector<PrefetchedFile>* results_;
+  int first_;
+  int stride_;
+};
+
+void Filesystem::prefetch(const std::vector<std::string>& paths) {
+  if (!can_prefetch()) return;
+  // Only prefetch files that are known to exist and haven't been read yet.
+  std::vector<std::string> pending;
+  UnorderedSet<std::string> seen;
+  for (auto path : paths) {
+    if (seen.contains(path)) continue;
+    seen.insert(path);
+    if (intercepted_.find(path) != intercepted_.end()) continue;
+    if (prefetched_.find(path) != prefetched_.end()) continue;
+    auto kind = path_kinds_.find(path);
+    if (kind == path_kinds_.end() || kind->second != PathKind::REGULAR_FILE) continue;
+    pending.push_back(path);
+  }
+  // A single file is read just as fast when it is needed.
+  if (pending.size() < 2) return;
+
+  const int MAX_PREFETCH_THREADS = 8;
+  int thread_count = Utils::min(MAX_PREFETCH_THREADS, static_cast<int>(pending.size()));
+  std::vector<PrefetchThread::PrefetchedFile> results(pending.size(), { null, 0 });
+  std::vector<PrefetchThread*> threads;
+  for (int i = 0; i < thread_count; i++) {
+    threads.push_back(_new PrefetchThread(this, &pending, &results, i, thread_count));
+  }
+  // The current thread does its share of the reads as well.
+  for (int i = 1; i < thread_count; i++) threads[i]->spawn();
+  threads[0]->read_files();
+  for (int i = 1; i < thread_count; i++) threads[i]->join();
+  for (auto thread : threads) delete thread;
+
+  for (size_t i = 0; i < pending.size(); i++) {
+    if (results[i].content == null) continue;
+    prefetched_[pending[i]] = {
+      .content = results[i].content,
+      .size = results[i].size,
+    };
+    statistics_.file_reads++;
+    statistics_.prefetched++;
+  }
 }
 
 void Filesystem::register_intercepted(const std::string& path, const uint8* content, int size) {
@@ -244,7 +413,7 @@ void Filesystem::register_intercepted(const std::string& path, const uint8* cont
 
 void Filesystem::list_toit_directory_entries(const char* path,
                                              const std::function<void (const char*, bool is_directory)> callback) {
-  list_directory_entries(path, [&](const char* entry) {
+  auto handle_entry = [&](const char* entry) {
     // TODO(florian): We would like to check here, whether the `full_path` is a directory
     // or not. However, we are not allowed to do another filesystem request
     // while we are still doing the `list_directory_entries` call.
@@ -274,7 +443,23 @@ void Filesystem::list_toit_directory_entries(const char* path,
       }
       if (!validator.check_next_char(c, [&]() { return entry[i + 1]; })) return;
     }
-  });
+  };
+  if (!cache_enabled_) {
+    list_directory_entries(path, handle_entry);
+    return;
+  }
+  std::string key(path);
+  auto probe = directory_entries_.find(key);
+  if (probe == directory_entries_.end()) {
+    std::vector<std::string> entries;
+    list_directory_entries(path, [&](const char* entry) {
+      entries.push_back(std::string(entry));
+    });
+    statistics_.directory_reads++;
+    directory_entries_[key] = entries;
+    probe = directory_entries_.find(key);
+  }
+  for (auto& entry : probe->second) handle_entry(entry.c_str());
 }
 
 } // namespace compiler
@@ -17,11 +17,13 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "../top.h"
 #include "../utils.h"
 
 #include "map.h"
+#include "set.h"
 
 namespace toit {
 namespace compiler {
@@ -30,7 +32,25 @@ class Diagnostics;
 
 class Filesystem {
  public:
-  virtual ~Filesystem() { free(const_cast<char*>(cwd_)); }
+  virtual ~Filesystem();
+
+  enum class PathKind {
+    MISSING,
+    REGULAR_FILE,
+    DIRECTORY,
+    OTHER,
+  };
+
+  /// Counts of the requests to the filesystem, and of the operations that
+  ///   reached the underlying implementation.
+  /// Only filesystems with a metadata cache keep statistics.
+  struct Statistics {
+    int probes;           // Calls to `is_regular_file`, `is_directory` and `exists`.
+    int stats;            // Probes that weren't answered by the cache.
+    int directory_reads;  // Directories that were listed.
+    int file_reads;       // Files that were read, including the prefetched ones.
+    int prefetched;       // Files that were read by the prefetcher.
+  };
 
   /// Can be called multiple times.
   /// Subclasses must ensure that multiple calls don't lead to problems.
@@ -71,6 +91,16 @@ class Filesystem {
   bool exists(const char* path);
   const uint8* read_content(const char* path, int* size);
 
+  /// Whether `prefetch` reads files ahead of time.
+  bool can_prefetch() { return cache_enabled_ && supports_prefetch(); }
+
+  /// Reads the given files in parallel, so that later calls to `read_content`
+  ///   for them don't have to wait for the filesystem.
+  /// Does nothing if the filesystem can't prefetch.
+  void prefetch(const std::vector<std::string>& paths);
+
+  const Statistics& statistics() const { return statistics_; }
+
   // List the directory entries that are relevant for Toit.
   // Specifically, Toit is only interested in:
   // - toit files. (`x.toit`), which are listed without the extension.
@@ -112,7 +142,32 @@ class Filesystem {
   virtual void list_directory_entries(const char* path,
                                       const std::function<void (const char*)> callback) = 0;
 
+  // Returns the kind of the path with as few requests as possible.
+  // The default implementation asks up to three questions.
+  virtual PathKind do_path_kind(const char* path);
+
+  // Lists the directory together with the kinds of its entries, if the
+  //   kinds are available without further requests. The kind of an entry is
+  //   null if it is unknown (for example for symbolic links).
+  // Returns false if the filesystem can't do this, or the directory couldn't
+  //   be read.
+  virtual bool list_directory_with_kinds(const char* path,
+                                         const std::function<void (const char*, const PathKind*)> callback) {
+    return false;
+  }
+
+  // Whether `do_read_content` may be called from multiple threads at once.
+  virtual bool supports_prefetch() { return false; }
+
+  /// Enables the metadata cache for this filesystem.
+  ///
+  /// The cache remembers the kinds of paths, directory listings and
+  ///   prefetched contents for the lifetime of the filesystem. It must thus
+  ///   only be enabled for filesystems that don't outlive a build.
+  void enable_cache() { cache_enabled_ = true; }
+
   friend class FilesystemHybrid;
+  friend class PrefetchThread;
 
  private:
   struct InterceptedFile {
@@ -122,7 +177,21 @@ class Filesystem {
 
   std::string _relative(const std::string& path, std::string to);
 
+  PathKind cached_path_kind(const char* path);
+  bool list_parent_directory(const std::string& path);
+
   UnorderedMap<std::string, InterceptedFile> intercepted_;
+
+  bool cache_enabled_ = false;
+  Statistics statistics_ = { 0, 0, 0, 0, 0 };
+  UnorderedMap<std::string, PathKind> path_kinds_;
+  // Directories that have been listed with `list_directory_with_kinds`, and
+  //   whether that succeeded. The entries of a listed directory are all in
+  //   `path_kinds_`, except for the ones in `unresolved_entries_`.
+  UnorderedMap<std::string, bool> listed_directories_;
+  UnorderedSet<std::string> unresolved_entries_;
+  UnorderedMap<std::string, std::vector<std::string>> directory_entries_;
+  UnorderedMap<std::string, InterceptedFile> prefetched_;
   const char* library_root_ = null;
   const char* vessel_root_ = null;
   const char* cwd_ = null;
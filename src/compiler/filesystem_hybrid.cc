@@ -83,6 +83,19 @@ const uint8* FilesystemHybrid::do_read_content(const char* path, int* size) {
   return do_with_active_fs<const uint8*>(path, f);
 }
 
+Filesystem::PathKind FilesystemHybrid::do_path_kind(const char* path) {
+  auto f = [&](const char* path, Filesystem* fs) { return fs->do_path_kind(path); };
+  return do_with_active_fs<PathKind>(path, f);
+}
+
+bool FilesystemHybrid::list_directory_with_kinds(const char* path,
+                                                 const std::function<void (const char*, const PathKind*)> callback) {
+  auto f = [&](const char* path, Filesystem* fs) {
+    return fs->list_directory_with_kinds(path, callback);
+  };
+  return do_with_active_fs<bool>(path, f);
+}
+
 const char* FilesystemHybrid::sdk_path() {
   auto f = [&](Filesystem* fs) { return fs->sdk_path(); };
   return do_with_active_fs<const char*>(f);
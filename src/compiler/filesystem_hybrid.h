@@ -30,7 +30,10 @@ class FilesystemHybrid : public Filesystem {
  public:
   FilesystemHybrid(const char* path)
       : use_fs_archive_(FilesystemArchive::is_probably_archive(path))
-      , fs_archive_(path) {}
+      , fs_archive_(path) {
+    // A hybrid filesystem is created for a single build.
+    enable_cache();
+  }
 
   void initialize(Diagnostics* diagnostics);
   const char* entry_path();
@@ -53,6 +56,12 @@ class FilesystemHybrid : public Filesystem {
   void list_directory_entries(const char* path,
                               const std::function<void (const char*)> callback);
 
+  PathKind do_path_kind(const char* path);
+  bool list_directory_with_kinds(const char* path,
+                                 const std::function<void (const char*, const PathKind*)> callback);
+  // Reading from archives is already fast.
+  bool supports_prefetch() { return !use_fs_archive_; }
+
  private:
   bool use_fs_archive_;
   FilesystemLocal fs_local_;
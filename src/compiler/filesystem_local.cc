@@ -13,6 +13,7 @@
 // The license can be found in the file `LICENSE` in the top level
 // directory of this repository.
 
+#include <errno.h>
 #include <libgen.h>
 #include <limits.h>
 #include <sys/stat.h>
@@ -72,6 +73,15 @@ bool FilesystemLocal::do_is_directory(const char* path) {
   }
 }
 
+Filesystem::PathKind FilesystemLocal::do_path_kind(const char* path) {
+  struct stat path_stat;
+  int stat_result = stat(path, &path_stat);
+  if (stat_result != 0) return PathKind::MISSING;
+  if (S_ISREG(path_stat.st_mode)) return PathKind::REGULAR_FILE;
+  if (S_ISDIR(path_stat.st_mode)) return PathKind::DIRECTORY;
+  return PathKind::OTHER;
+}
+
 const char* FilesystemLocal::sdk_path() {
   if (sdk_path_ == null) {
     if (Flags::lib_path != null) {
@@ -169,5 +179,43 @@ void FilesystemLocal::list_directory_entries(const char* path,
   closedir(dir);
 }
 
+bool FilesystemLocal::list_directory_with_kinds(const char* path,
+                                                const std::function<void (const char*, const PathKind*)> callback) {
+#ifdef DT_DIR
+  DIR* dir = opendir(path);
+  if (dir == null) return false;
+  bool succeeded = true;
+  while (true) {
+    errno = 0;
+    struct dirent* entry = readdir(dir);
+    if (entry == null) {
+      succeeded = errno == 0;
+      break;
+    }
+    PathKind kind = PathKind::OTHER;
+    switch (entry->d_type) {
+      case DT_REG:
+        kind = PathKind::REGULAR_FILE;
+        break;
+      case DT_DIR:
+        kind = PathKind::DIRECTORY;
+        break;
+      case DT_LNK:
+      case DT_UNKNOWN:
+        // Symbolic links must be followed, and some filesystems don't
+        // report the type at all.
+        callback(entry->d_name, null);
+        continue;
+    }
+    callback(entry->d_name, &kind);
+  }
+  closedir(dir);
+  return succeeded;
+#else
+  // The directory entries don't have a type.
+  return false;
+#endif
+}
+
 } // namespace compiler
 } // namespace toit
@@ -58,6 +58,11 @@ class FilesystemLocal : public Filesystem {
   void list_directory_entries(const char* path,
                               const std::function<void (const char*)> callback);
 
+  PathKind do_path_kind(const char* path);
+  bool list_directory_with_kinds(const char* path,
+                                 const std::function<void (const char*, const PathKind*)> callback);
+  bool supports_prefetch() { return true; }
+
  private:
   const char* sdk_path_ = null;
   List<const char*> package_cache_paths_;
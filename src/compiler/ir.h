@@ -20,6 +20,7 @@
 #include "sources.h"
 #include "selector.h"
 #include "symbol.h"
+#include "zone.h"
 #include "../bytecodes.h"
 
 namespace toit {
@@ -195,7 +196,7 @@ class Type {
   bool is_nullable_;
 };
 
-class Node {
+class Node : public ZoneAllocated {
  public:
 #define DECLARE(name)                              \
   virtual bool is_##name() const { return false; } \
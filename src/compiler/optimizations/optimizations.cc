@@ -20,6 +20,7 @@
 #include "virtual_call.h"
 #include "return_peephole.h"
 #include "simplify_sequence.h"
+#include "tail_call.h"
 #include "typecheck.h"
 
 #include "../queryable_class.h"
@@ -103,9 +104,12 @@ class OptimizationVisitor : public ReplacingVisitor {
   }
 
   /// Pushes `return`s into `if`s.
+  /// Marks returned calls as tail calls.
   Node* visit_Return(Return* node) {
     node = ReplacingVisitor::visit_Return(node)->as_Return();
-    return return_peephole(node);
+    auto result = return_peephole(node);
+    mark_tail_calls(result);
+    return result;
   }
 
   Node* visit_Sequence(Sequence* node) {
@@ -0,0 +1,45 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "tail_call.h"
+
+namespace toit {
+namespace compiler {
+
+using namespace ir;
+
+void mark_tail_calls(Expression* node) {
+  if (node->is_If()) {
+    mark_tail_calls(node->as_If()->yes());
+    mark_tail_calls(node->as_If()->no());
+    return;
+  }
+  // Only returns from the method itself. The code generator also
+  // checks that there are no blocks that need the frame.
+  if (!node->is_Return() || node->as_Return()->depth() != -1) return;
+  auto value = node->as_Return()->value();
+  if (value->is_CallConstructor() || value->is_Lambda()) return;
+  if (value->is_CallStatic()) {
+    value->as_CallStatic()->mark_tail_call();
+  } else if (value->is_CallVirtual() &&
+             value->as_CallVirtual()->opcode() == INVOKE_VIRTUAL) {
+    // Calls with specialized bytecodes, like operators and field
+    // accesses, have fast paths that are more important.
+    value->as_CallVirtual()->mark_tail_call();
+  }
+}
+
+} // namespace toit::compiler
+} // namespace toit
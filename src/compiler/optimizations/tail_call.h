@@ -0,0 +1,29 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "../ir.h"
+
+namespace toit {
+namespace compiler {
+
+/// Marks calls whose value is returned directly, so they can reuse the frame
+/// of the calling method.
+/// Handles `return`s that have been pushed into `if`s.
+void mark_tail_calls(ir::Expression* node);
+
+} // namespace toit::compiler
+} // namespace toit
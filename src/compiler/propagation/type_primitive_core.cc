@@ -74,6 +74,9 @@ TYPE_PRIMITIVE_STRING(int64_to_string)
 TYPE_PRIMITIVE_STRING(printf_style_int64_to_string)
 TYPE_PRIMITIVE_STRING(smi_to_string_base_10)
 TYPE_PRIMITIVE_STRING(concat_strings)
+TYPE_PRIMITIVE_STRING(string_replace)
+TYPE_PRIMITIVE_STRING(string_case_map)
+TYPE_PRIMITIVE_STRING(string_normalize)
 TYPE_PRIMITIVE_STRING(string_from_rune)
 TYPE_PRIMITIVE_STRING(utf_16_to_string)
 TYPE_PRIMITIVE_BYTE_ARRAY(string_to_utf_16)
@@ -97,6 +100,13 @@ TYPE_PRIMITIVE_SMI(compare_to)
 TYPE_PRIMITIVE_BOOL(min_special_compare_to)
 TYPE_PRIMITIVE_SMI(string_compare)
 TYPE_PRIMITIVE_SMI(string_rune_count)
+TYPE_PRIMITIVE_SMI(string_rune_offset)
+TYPE_PRIMITIVE_BYTE_ARRAY(string_rune_index)
+TYPE_PRIMITIVE_SMI(string_compare_folded)
+TYPE_PRIMITIVE_STRING(string_intern)
+TYPE_PRIMITIVE_NULL(process_set_string_interning)
+TYPE_PRIMITIVE_STRING(interpolate_strings)
+TYPE_PRIMITIVE_STRING(byte_array_consume_to_string)
 TYPE_PRIMITIVE_BOOL(blob_equals)
 
 TYPE_PRIMITIVE_SMI(random)
@@ -185,6 +195,8 @@ TYPE_PRIMITIVE_SMI(object_class_id)
 TYPE_PRIMITIVE_SMI(string_hash_code)
 TYPE_PRIMITIVE_SMI(blob_hash_code)
 TYPE_PRIMITIVE_SMI(blob_index_of)
+TYPE_PRIMITIVE_SMI(blob_search)
+TYPE_PRIMITIVE_SMI(blob_search_all)
 
 TYPE_PRIMITIVE_SMI(hash_simple_json_string)
 TYPE_PRIMITIVE_SMI(size_of_json_number)
@@ -256,6 +268,23 @@ TYPE_PRIMITIVE(spawn) {
 TYPE_PRIMITIVE_ANY(main_arguments)
 TYPE_PRIMITIVE_SMI(spawn_method)
 TYPE_PRIMITIVE_ANY(spawn_arguments)
+TYPE_PRIMITIVE_NULL(spawn_pool_size)
+TYPE_PRIMITIVE_INT(record_pack)
+TYPE_PRIMITIVE_ARRAY(record_unpack)
+TYPE_PRIMITIVE_NULL(process_set_deadline)
+TYPE_PRIMITIVE_NULL(process_set_quota)
+
+TYPE_PRIMITIVE(process_get_deadline) {
+  result.add_int(program);
+  result.add_null(program);
+}
+
+TYPE_PRIMITIVE_SMI(process_get_effective_priority)
+
+TYPE_PRIMITIVE(process_get_effective_deadline) {
+  result.add_int(program);
+  result.add_null(program);
+}
 
 TYPE_PRIMITIVE(program_name) {
   result.add_string(program);
@@ -24,6 +24,7 @@ TYPE_PRIMITIVE_ANY(base64_encode)
 TYPE_PRIMITIVE_ANY(base64_decode)
 TYPE_PRIMITIVE_ANY(tison_encode)
 TYPE_PRIMITIVE_ANY(tison_decode)
+TYPE_PRIMITIVE_BOOL(tison_decode_chunk)
 
 }  // namespace toit::compiler
 }  // namespace toit
@@ -25,6 +25,8 @@ TYPE_PRIMITIVE_ANY(writer_create)
 TYPE_PRIMITIVE_ANY(writer_write)
 TYPE_PRIMITIVE_ANY(writer_commit)
 TYPE_PRIMITIVE_ANY(writer_close)
+TYPE_PRIMITIVE_INT(writer_written)
+TYPE_PRIMITIVE_BYTE_ARRAY(writer_digest)
 
 }  // namespace toit::compiler
 }  // namespace toit
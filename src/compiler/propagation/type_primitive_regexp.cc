@@ -0,0 +1,34 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "type_primitive.h"
+
+namespace toit {
+namespace compiler {
+
+MODULE_TYPES(regexp, MODULE_REGEXP)
+
+TYPE_PRIMITIVE_ANY(compile)
+TYPE_PRIMITIVE_SMI(group_count)
+TYPE_PRIMITIVE(group_name) {
+  result.add_string(program);
+  result.add_null(program);
+  failure.add_string(program);
+}
+TYPE_PRIMITIVE_BOOL(search)
+TYPE_PRIMITIVE_NULL(close)
+
+}  // namespace toit::compiler
+}  // namespace toit
@@ -33,6 +33,10 @@ TYPE_PRIMITIVE_ANY(zlib_write)
 TYPE_PRIMITIVE_ANY(zlib_read)
 TYPE_PRIMITIVE_NULL(zlib_close)
 TYPE_PRIMITIVE_NULL(zlib_uninit)
+TYPE_PRIMITIVE_BYTE_ARRAY(delta_encode)
+TYPE_PRIMITIVE_ANY(delta_patch_start)
+TYPE_PRIMITIVE_SMI(delta_patch_add)
+TYPE_PRIMITIVE_BOOL(delta_patch_close)
 
 }  // namespace toit::compiler
 }  // namespace toit
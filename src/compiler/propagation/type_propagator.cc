@@ -1099,6 +1099,16 @@ static TypeScope* process(TypeScope* scope, uint8* bcp, std::vector<Worklist*>&
     if (stack->top_is_empty()) return scope;
   OPCODE_END();
 
+  OPCODE_BEGIN(INVOKE_VIRTUAL_TAIL);
+    B_ARG1(arity);
+    int offset = Utils::read_unaligned_uint16(bcp + 2);
+    propagator->call_virtual(method, scope, bcp, arity + 1, offset);
+    if (stack->top_is_empty()) return scope;
+    ASSERT(scope->level() == 0);
+    method->ret(propagator, stack);
+    return scope;
+  OPCODE_END();
+
 #define INVOKE_VIRTUAL_BINARY(opcode)                         \
   OPCODE_BEGIN(opcode);                                       \
     int offset = program->invoke_bytecode_offset(opcode);     \
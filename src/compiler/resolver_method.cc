@@ -4193,6 +4193,36 @@ static bool is_binary_comparison(ast::Node* node) {
   }
 }
 
+static bool has_formats(ast::LiteralStringInterpolation* node) {
+  for (auto format : node->formats()) {
+    if (format != null) return true;
+  }
+  return false;
+}
+
+static bool is_simple_interpolation(ast::Node* node) {
+  return node->is_LiteralStringInterpolation() &&
+      !has_formats(node->as_LiteralStringInterpolation());
+}
+
+// Whether the node is a chain of additions that starts with a string literal,
+// and that would create intermediate strings if it was evaluated one
+// addition at a time.
+static bool is_string_concatenation_chain(ast::Binary* node) {
+  int additions = 0;
+  bool has_interpolation = false;
+  ast::Node* current = node;
+  while (current->is_Binary() && current->as_Binary()->kind() == Token::ADD) {
+    auto binary = current->as_Binary();
+    additions++;
+    if (is_simple_interpolation(binary->right())) has_interpolation = true;
+    current = binary->left();
+  }
+  if (!current->is_LiteralString() && !current->is_LiteralStringInterpolation()) return false;
+  if (is_simple_interpolation(current)) has_interpolation = true;
+  return additions >= 2 || has_interpolation;
+}
+
 ir::Expression* MethodResolver::_binary_operator(ast::Binary* node,
                                                  ir::Expression* ir_left,
                                                  ir::Expression* ir_right) {
@@ -4308,9 +4338,15 @@ void MethodResolver::visit_Binary(ast::Binary* node) {
       push(_binary_comparison_operator(node));
       break;
 
+    case Token::ADD:
+      if (is_string_concatenation_chain(node)) {
+        push(_string_concatenation(node));
+        break;
+      }
+      [[fallthrough]];
+
     case Token::EQ:
     case Token::NE:
-    case Token::ADD:
     case Token::BIT_AND:
     case Token::BIT_OR:
     case Token::BIT_SHL:
@@ -4478,34 +4514,64 @@ ir::Expression* MethodResolver::_accumulate_concatenation(ir::Expression* lhs, i
   return plus;
 }
 
-void MethodResolver::visit_LiteralStringInterpolation(ast::LiteralStringInterpolation* node) {
-  ASSERT(node->parts().length() > 0);
-  ASSERT(node->expressions().length() == node->parts().length() - 1);
-  ASSERT(node->formats().length() == node->expressions().length());
-
+static int interpolation_min_indentation(ast::LiteralStringInterpolation* node) {
   auto parts = node->parts();
-  bool is_multiline = parts[0]->is_multiline();
-  int min_indentation = 0;
+  if (!parts[0]->is_multiline()) return 0;
+  int min_indentation = -1;
   bool contains_newline = false;
-  if (is_multiline) {
-    min_indentation = -1;
-    find_min_indentation(parts[0]->data().c_str(),
-                         true,
+  find_min_indentation(parts[0]->data().c_str(),
+                       true,
+                       &min_indentation,
+                       &contains_newline);
+  for (int i = 1; i < parts.length(); i++) {
+    find_min_indentation(parts[i]->data().c_str(),
+                         false,  // Not string start.
                          &min_indentation,
                          &contains_newline);
-    for (int i = 1; i < parts.length(); i++) {
-      find_min_indentation(parts[i]->data().c_str(),
-                           false,  // Not string start.
-                           &min_indentation,
-                           &contains_newline);
-    }
-    // Don't remove leading whitespace if the multiline string doesn't have any
-    //   newline.
-    if (!contains_newline) min_indentation = 0;
   }
+  // Don't remove leading whitespace if the multiline string doesn't have any
+  //   newline.
+  if (!contains_newline) min_indentation = 0;
+  return min_indentation;
+}
+
+void MethodResolver::_add_interpolation_entries(ast::LiteralStringInterpolation* node,
+                                                ListBuilder<ir::Expression*>& entries) {
+  ASSERT(!has_formats(node));
+  auto parts = node->parts();
+  int min_indentation = interpolation_min_indentation(node);
+  visit_LiteralString(parts[0], min_indentation, true);
+  auto ir_node = pop();
+  ASSERT(ir_node->is_Expression());
+  entries.add(ir_node->as_Expression());
+
+  for (int i = 1; i < parts.length(); i++) {
+    auto expression = node->expressions()[i - 1];
+    auto ir_expression = resolve_expression(expression,
+                                          "Can't have a block as interpolated entry in a string");
+    entries.add(ir_expression);
+
+    visit_LiteralString(parts[i], min_indentation, false);
+    auto ir_entry_node = pop();
+    ASSERT(ir_entry_node->is_Expression());
+    entries.add(ir_entry_node->as_Expression());
+  }
+}
+
+void MethodResolver::visit_LiteralStringInterpolation(ast::LiteralStringInterpolation* node) {
+  ASSERT(node->parts().length() > 0);
+  ASSERT(node->expressions().length() == node->parts().length() - 1);
+  ASSERT(node->formats().length() == node->expressions().length());
 
-  if (parts.length() == 2 && node->formats()[0] == null) {
-    // Super-simple case has no format string and only one interpolated value.
+  auto parts = node->parts();
+  int min_indentation = interpolation_min_indentation(node);
+
+  // Super-simple case has no format string and only one interpolated value.
+  // With at most one non-empty string part, a stringify and a single
+  //   concatenation is cheaper than building the array for the runtime.
+  if (parts.length() == 2 &&
+      node->formats()[0] == null &&
+      (parts[0]->data().c_str()[0] == '\0' || parts[1]->data().c_str()[0] == '\0')) {
     auto left_expression = node->parts()[0];
     auto right_expression = node->parts()[1];
 
@@ -4534,15 +4600,7 @@ void MethodResolver::visit_LiteralStringInterpolation(ast::LiteralStringInterpol
                                           CallShape::for_instance_call_no_named(no_args),
                                           no_args,
                                           node->range());
-    auto string_entry = core_module_->scope()->lookup_shallow(Symbols::string);
-    ASSERT(string_entry.is_class());
-    auto string_class = string_entry.klass();
-    ir::Type string_type(string_class);
-    auto stringify_as_string = _new ir::Typecheck(ir::Typecheck::AS_CHECK,
-                                                  stringify,
-                                                  string_type,
-                                                  string_type.klass()->name(),
-                                                  center->range());
+    auto stringify_as_string = _as_string(stringify, center->range());
     ir::Expression* accumulator = null;
     accumulator = _accumulate_concatenation(accumulator, left, node->range());
     accumulator = _accumulate_concatenation(accumulator, stringify_as_string, node->range());
@@ -4552,34 +4610,31 @@ void MethodResolver::visit_LiteralStringInterpolation(ast::LiteralStringInterpol
   }
 
   ListBuilder<ir::Expression*> array_entries;
+  if (!has_formats(node)) {
+    // The runtime formats the entries directly into the resulting string.
+    _add_interpolation_entries(node, array_entries);
+    auto array = _create_array(array_entries.build(), node->range());
+    push(_call_runtime(Symbols::simple_interpolate_strings_, list_of(array), node->range()));
+    return;
+  }
+
   visit_LiteralString(parts[0], min_indentation, true);
   auto ir_node = pop();
   ASSERT(ir_node->is_Expression());
   array_entries.add(ir_node->as_Expression());
 
-  bool has_formats = false;
-  for (int i = 1; i < parts.length(); i++) {
-    auto format = node->formats()[i - 1];
-    if (format != null) {
-      has_formats = true;
-      break;
-    }
-  }
-
   for (int i = 1; i < parts.length(); i++) {
     auto format = node->formats()[i - 1];
     auto expression = node->expressions()[i - 1];
     auto string_part = parts[i];
 
-    if (has_formats) {
-      if (format == null) {
-        array_entries.add(_new ir::LiteralNull(node->range()));
-      } else {
-        visit_LiteralString(format);
-        auto ir_entry_node = pop();
-        ASSERT(ir_entry_node->is_Expression());
-        array_entries.add(ir_entry_node->as_Expression());
-      }
+    if (format == null) {
+      array_entries.add(_new ir::LiteralNull(node->range()));
+    } else {
+      visit_LiteralString(format);
+      auto ir_entry_node = pop();
+      ASSERT(ir_entry_node->is_Expression());
+      array_entries.add(ir_entry_node->as_Expression());
     }
 
     auto ir_expression = resolve_expression(expression,
@@ -4593,11 +4648,50 @@ void MethodResolver::visit_LiteralStringInterpolation(ast::LiteralStringInterpol
   }
 
   auto array = _create_array(array_entries.build(), node->range());
-  if (has_formats) {
-    push(_call_runtime(Symbols::interpolate_strings_, list_of(array), node->range()));
-  } else {
-    push(_call_runtime(Symbols::simple_interpolate_strings_, list_of(array), node->range()));
+  push(_call_runtime(Symbols::interpolate_strings_, list_of(array), node->range()));
+}
+
+ir::Expression* MethodResolver::_as_string(ir::Expression* expression, Source::Range range) {
+  auto string_entry = core_module_->scope()->lookup_shallow(Symbols::string);
+  ASSERT(string_entry.is_class());
+  auto string_class = string_entry.klass();
+  ir::Type string_type(string_class);
+  return _new ir::Typecheck(ir::Typecheck::AS_CHECK,
+                            expression,
+                            string_type,
+                            string_type.klass()->name(),
+                            range);
+}
+
+ir::Expression* MethodResolver::_string_concatenation(ast::Binary* node) {
+  ASSERT(is_string_concatenation_chain(node));
+  // The operands, from right to left.
+  ListBuilder<ast::Expression*> operands;
+  ast::Expression* current = node;
+  while (current->is_Binary() && current->as_Binary()->kind() == Token::ADD) {
+    operands.add(current->as_Binary()->right());
+    current = current->as_Binary()->left();
+  }
+  operands.add(current);
+
+  // The left-most operand is a string, so every addition is a `string.+`,
+  //   which requires its argument to be a string too. All operands are
+  //   therefore checked to be strings instead of being stringified.
+  ListBuilder<ir::Expression*> entries;
+  for (int i = operands.length() - 1; i >= 0; i--) {
+    auto operand = operands[i];
+    if (is_simple_interpolation(operand)) {
+      _add_interpolation_entries(operand->as_LiteralStringInterpolation(), entries);
+      continue;
+    }
+    auto ir_operand = resolve_expression(operand, "Can't use blocks in binary expression");
+    if (!operand->is_LiteralString() && !operand->is_LiteralStringInterpolation()) {
+      ir_operand = _as_string(ir_operand, operand->range());
+    }
+    entries.add(ir_operand);
   }
+  auto array = _create_array(entries.build(), node->range());
+  return _call_runtime(Symbols::simple_interpolate_strings_, list_of(array), node->range());
 }
 
 void MethodResolver::visit_LiteralBoolean(ast::LiteralBoolean* node) {
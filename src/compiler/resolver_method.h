@@ -91,6 +91,10 @@ class MethodResolver : public ast::Visitor {
 
   int _find_super_invocation(List<ast::Expression*> expressions);
   ir::Expression* _accumulate_concatenation(ir::Expression* lhs, ir::Expression* rhs, Source::Range range);
+  ir::Expression* _as_string(ir::Expression* expression, Source::Range range);
+  void _add_interpolation_entries(ast::LiteralStringInterpolation* node,
+                                  ListBuilder<ir::Expression*>& entries);
+  ir::Expression* _string_concatenation(ast::Binary* node);
 
  private:
   typedef const std::function<ir::Local* (ir::Expression*)> CreateTemp;
@@ -22,6 +22,7 @@
 #include "map.h"
 #include "symbol.h"
 #include "set.h"
+#include "zone.h"
 
 namespace toit {
 namespace compiler {
@@ -182,7 +183,7 @@ class ResolutionEntry {
   };
 };
 
-class IterableScope {
+class IterableScope : public ZoneAllocated {
  public:
   /// Invokes the given callback for each entry.
   ///
@@ -487,6 +487,7 @@ Scanner::State Scanner::next_string_part(bool is_multiline_string) {
   begin_ = last_ = index_;
   int begin = index_;
   for (int peek = input_[index_]; true; peek = advance()) {
+    peek = skip(ByteScanner::skip_string_text);
     if (peek == '"') {
       int index = index_;
       if (is_multiline_string) {
@@ -544,8 +545,9 @@ Token::Kind Scanner::scan_newline(int peek) {
     indentation = 0;
     while (peek == ' ' || peek == '\t' || (peek == '/' && look_ahead() == '*')) {
       if (peek == ' ') {
-        indentation++;
-        peek = advance();
+        int begin = index_;
+        peek = skip(ByteScanner::skip_spaces);
+        indentation += index_ - begin;
       } else if (peek == '\t') {
         report_error(index_, index_ + 1, "Can't have tabs in leading whitespace");
         // Tabs indentation to the next TAB_WIDTH character column.
@@ -617,7 +619,8 @@ Token::Kind Scanner::scan_string(int peek) {
   }
 
   while (true) {
-    peek = advance();
+    advance();
+    peek = skip(ByteScanner::skip_string_text);
     if (peek == '"') {
       int index = index_;
       if (is_multiline_string) {
@@ -772,7 +775,10 @@ Token::Kind Scanner::scan_identifier(int peek) {
       // had never been there.
       is_lsp_selection_ = true;
     }
-    peek = advance();
+    advance();
+    // Dashes and LSP-selection markers need the validator. Everything else
+    // can be skipped in bulk.
+    peek = skip(ByteScanner::skip_identifier_part);
   }
 
   if (!is_lsp_selection_ && begin == index_) {
@@ -825,7 +831,7 @@ void Scanner::skip_skippable_whitespace(int peek) {
       if (peek == '\r') peek = advance();
       if (peek == '\n') peek = advance();
     } else {
-      peek = advance();
+      peek = skip(ByteScanner::skip_blanks);
     }
   } while (at_skippable_whitespace(peek));
 }
@@ -838,9 +844,7 @@ void Scanner::capture_single_line_comment(int peek) {
 
   bool is_toitdoc = peek == '/';
 
-  while (!at_eos() && !is_newline(peek)) {
-    peek = advance();
-  }
+  skip(ByteScanner::skip_line_text);
 
   comments_.add(Comment(false, is_toitdoc, source_->range(begin, index_)));
 }
@@ -875,7 +879,7 @@ void Scanner::capture_multi_line_comment(int peek) {
       }
     } else {
       // Just skip to the next one.
-      peek = advance();
+      peek = skip(ByteScanner::skip_comment_text);
     }
   }
 
@@ -19,6 +19,7 @@
 
 #include <utility>
 
+#include "byte_scanner.h"
 #include "list.h"
 #include "sources.h"
 #include "symbol.h"
@@ -420,6 +421,13 @@ class Scanner {
     return result;
   }
 
+  // Moves to the first character at or after the current one that isn't
+  // skipped by the given ByteScanner function. Returns that character.
+  int skip(const uint8* (*skipper)(const uint8* from, const uint8* to)) {
+    index_ = skipper(input_ + index_, input_ + source_->size()) - input_;
+    return input_[index_];
+  }
+
   Symbol preserve_syntax(int begin, int end);
 
   State create_state(Token::Kind token);
@@ -19,15 +19,24 @@
 
 #include "symbol.h"
 #include "token.h"
+#include "zone.h"
 
 #include "../utils.h"
 
 namespace toit {
 namespace compiler {
 
+// Symbols are never freed, and there are many small ones. They are allocated
+// in a zone that lives until the end of the compilation.
+static char* allocate_symbol_string(int length) {
+  static Zone* zone = null;
+  if (zone == null) zone = _new Zone("symbols");
+  return unvoid_cast<char*>(zone->allocate(length + 1));
+}
+
 Symbol Symbol::synthetic(const uint8* from, const uint8* to) {
   int n = to - from;
-  char* s = unvoid_cast<char*>(malloc(n + 1));
+  char* s = allocate_symbol_string(n);
   strncpy(s, char_cast(from), n);
   s[n] = '\0';
 
@@ -36,7 +45,7 @@ Symbol Symbol::synthetic(const uint8* from, const uint8* to) {
 
 Symbol Symbol::synthetic(const std::string& str) {
   int n = static_cast<int>(str.size());
-  char* s = unvoid_cast<char*>(malloc(n + 1));
+  char* s = allocate_symbol_string(n);
   strncpy(s, str.c_str(), n);
   s[n] = '\0';
 
@@ -20,6 +20,7 @@
 #include "sources.h"
 #include "symbol.h"
 #include "token.h"
+#include "zone.h"
 
 namespace toit {
 namespace compiler {
@@ -53,7 +54,7 @@ TOITDOC_NODES(DECLARE)
 #undef DECLARE
 };
 
-class Node {
+class Node : public ZoneAllocated {
  public:
   virtual void accept(Visitor* visitor) = 0;
 
@@ -0,0 +1,66 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "zone.h"
+
+namespace toit {
+namespace compiler {
+
+Zone* Zone::current_ = null;
+
+void Zone::free_all() {
+  Segment* segment = segments_;
+  while (segment != null) {
+    Segment* next = segment->next;
+    free(segment);
+    segment = next;
+  }
+  segments_ = null;
+  top_ = limit_ = null;
+  allocated_ = reserved_ = 0;
+}
+
+void* Zone::allocate_slow(size_t size) {
+  const size_t header_size = Utils::round_up(sizeof(Segment), ALIGNMENT);
+  // Large objects get their own segment, so we don't waste the remainder of
+  // the current one.
+  bool is_large = size > SEGMENT_SIZE / 4;
+  size_t segment_size = header_size + (is_large ? size : SEGMENT_SIZE);
+  Segment* segment = unvoid_cast<Segment*>(malloc(segment_size));
+  if (segment == null) FATAL("Out of memory in compiler zone '%s'", name_);
+  reserved_ += segment_size;
+  allocated_ += size;
+  uint8* data = reinterpret_cast<uint8*>(segment) + header_size;
+  if (is_large && segments_ != null) {
+    // Keep bumping in the current segment.
+    segment->next = segments_->next;
+    segments_->next = segment;
+    return data;
+  }
+  segment->next = segments_;
+  segments_ = segment;
+  top_ = data + size;
+  limit_ = data + segment_size - header_size;
+  return data;
+}
+
+void* ZoneAllocated::allocate(size_t size) {
+  Zone* zone = Zone::current();
+  if (zone == null) return malloc(size);
+  return zone->allocate(size);
+}
+
+} // namespace toit::compiler
+} // namespace toit
@@ -0,0 +1,116 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include <new>
+
+#include "../top.h"
+#include "../utils.h"
+
+namespace toit {
+namespace compiler {
+
+/// A region allocator for compiler data structures that share a lifetime.
+///
+/// Allocation is a pointer bump in the current segment. Individual objects
+///   are never freed; all memory is returned at once when the zone is
+///   destroyed. Destructors of objects in the zone are not run.
+class Zone {
+ public:
+  explicit Zone(const char* name) : name_(name) {}
+  ~Zone() { free_all(); }
+
+  // Returns all memory of the zone to the system. The zone can be
+  // used for new allocations afterwards.
+  void free_all();
+
+  void* allocate(size_t size) {
+    size = Utils::round_up(size, ALIGNMENT);
+    if (size > static_cast<size_t>(limit_ - top_)) return allocate_slow(size);
+    void* result = top_;
+    top_ += size;
+    allocated_ += size;
+    return result;
+  }
+
+  const char* name() const { return name_; }
+
+  // The number of bytes handed out by this zone.
+  size_t allocated() const { return allocated_; }
+  // The number of bytes this zone has requested from the system.
+  size_t reserved() const { return reserved_; }
+
+  // The zone that backs allocations of `ZoneAllocated` objects.
+  // Null if no zone is active, in which case these objects are malloced.
+  static Zone* current() { return current_; }
+
+ private:
+  static const size_t ALIGNMENT = 8;
+  static const size_t SEGMENT_SIZE = 64 * KB;
+
+  struct Segment {
+    Segment* next;
+  };
+
+  const char* name_;
+  Segment* segments_ = null;
+  uint8* top_ = null;
+  uint8* limit_ = null;
+  size_t allocated_ = 0;
+  size_t reserved_ = 0;
+
+  static Zone* current_;
+
+  void* allocate_slow(size_t size);
+
+  friend class ZoneScope;
+};
+
+/// Makes the given zone the current zone for the lifetime of the scope.
+class ZoneScope {
+ public:
+  explicit ZoneScope(Zone* zone) : previous_(Zone::current_) {
+    Zone::current_ = zone;
+  }
+  ~ZoneScope() {
+    Zone::current_ = previous_;
+  }
+
+ private:
+  Zone* previous_;
+};
+
+/// Base class for objects that are allocated in the current zone.
+///
+/// Objects of subclasses must not be deleted. Their memory is reclaimed
+///   when the zone they were allocated in is destroyed.
+class ZoneAllocated {
+ public:
+  static void* operator new(size_t size) {
+    return allocate(size);
+  }
+  static void* operator new(size_t size, const std::nothrow_t& tag) noexcept {
+    return allocate(size);
+  }
+  static void operator delete(void* ptr) { UNREACHABLE(); }
+  static void operator delete(void* ptr, const std::nothrow_t& tag) { UNREACHABLE(); }
+
+ private:
+  static void* allocate(size_t size);
+};
+
+} // namespace toit::compiler
+} // namespace toit
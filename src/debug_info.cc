@@ -0,0 +1,414 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "top.h"
+
+#ifndef TOIT_FREERTOS
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "debug_info.h"
+#include "objects.h"
+
+namespace toit {
+
+// Segment tags of the cooked source map. See `SourceMapper::cook`.
+static const uint32 STRING_SEGMENT_TAG = 70177018;
+static const uint32 METHOD_SEGMENT_TAG = 70177019;
+static const uint32 CLASS_SEGMENT_TAG = 70177020;
+
+// Must be kept in sync with `compiler::MethodType`.
+static const int INSTANCE_METHOD_TYPE = 0;
+static const int LAMBDA_METHOD_TYPE = 2;
+static const int BLOCK_METHOD_TYPE = 3;
+
+bool DebugInfo::is_valid() const {
+  if (size_ < static_cast<word>(sizeof(Header))) return false;
+  const Header* header = this->header();
+  if (header->magic != MAGIC || header->version != VERSION) return false;
+  // Check the section sizes one at a time, so the counts can't overflow.
+  uword remaining = size_ - sizeof(Header);
+  if (header->method_count > remaining / sizeof(MethodEntry)) return false;
+  remaining -= header->method_count * sizeof(MethodEntry);
+  if (header->position_count > remaining / sizeof(PositionEntry)) return false;
+  remaining -= header->position_count * sizeof(PositionEntry);
+  if (header->file_count > remaining / sizeof(uint32)) return false;
+  remaining -= header->file_count * sizeof(uint32);
+  uint32 pool_size = header->string_pool_size;
+  if (pool_size != remaining) return false;
+
+  // The strings are read up to their terminating zero, so the pool must
+  //   end with one. Then every offset into the pool is a valid string.
+  if (pool_size == 0 || strings()[pool_size - 1] != '\0') return false;
+  for (uint32 i = 0; i < header->file_count; i++) {
+    if (files()[i] >= pool_size) return false;
+  }
+  for (uint32 i = 0; i < header->method_count; i++) {
+    const MethodEntry* method = &methods()[i];
+    if (method->name >= pool_size || method->file >= header->file_count) return false;
+    if (method->first_position > header->position_count) return false;
+    if (method->position_count > header->position_count - method->first_position) return false;
+  }
+  return true;
+}
+
+bool DebugInfo::lookup(int absolute_bci, Location* result) const {
+  const MethodEntry* begin = methods();
+  const MethodEntry* end = begin + header()->method_count;
+  // Find the last method that starts at or before the bci.
+  const MethodEntry* method = std::upper_bound(begin, end, absolute_bci,
+      [](int bci, const MethodEntry& entry) { return bci < static_cast<int>(entry.id); });
+  if (method == begin) return false;
+  method--;
+  int bci = absolute_bci - method->id - Method::entry_offset();
+  if (bci < 0 || bci >= static_cast<int>(method->bytecode_size)) return false;
+
+  result->name = &strings()[method->name];
+  result->path = &strings()[files()[method->file]];
+  result->method_id = method->id;
+  result->bci = bci;
+  result->line = line_from(method->position);
+  result->column = column_from(method->position);
+
+  const PositionEntry* positions_begin = positions() + method->first_position;
+  const PositionEntry* positions_end = positions_begin + method->position_count;
+  const PositionEntry* position = std::lower_bound(positions_begin, positions_end, bci,
+      [](const PositionEntry& entry, int bci) { return static_cast<int>(entry.bci) < bci; });
+  // Only call sites have positions. Other bcis get the position of the method.
+  if (position != positions_end && static_cast<int>(position->bci) == bci) {
+    result->line = line_from(position->position);
+    result->column = column_from(position->position);
+  }
+  return true;
+}
+
+namespace {
+
+class SourceMapReader {
+ public:
+  SourceMapReader(const uint8* from, const uint8* to) : pos_(from), end_(to) {}
+
+  bool has_error() const { return has_error_; }
+  bool at_end() const { return pos_ >= end_; }
+
+  uint8 read_byte() {
+    if (pos_ >= end_) {
+      has_error_ = true;
+      return 0;
+    }
+    return *pos_++;
+  }
+
+  int read_cardinal() {
+    uint32 result = 0;
+    int shift = 0;
+    uint8 byte;
+    do {
+      byte = read_byte();
+      if (shift > 28) has_error_ = true;
+      if (has_error_) return 0;
+      result |= static_cast<uint32>(byte & 0x7f) << shift;
+      shift += 7;
+    } while (byte >= 128);
+    return static_cast<int>(result);
+  }
+
+  uint32 read_uint32() {
+    if (end_ - pos_ < 4) {
+      has_error_ = true;
+      return 0;
+    }
+    uint32 result = Utils::read_unaligned_uint32_le(pos_);
+    pos_ += 4;
+    return result;
+  }
+
+  const uint8* read_bytes(int length) {
+    if (length < 0 || end_ - pos_ < length) {
+      has_error_ = true;
+      return null;
+    }
+    const uint8* result = pos_;
+    pos_ += length;
+    return result;
+  }
+
+ private:
+  const uint8* pos_;
+  const uint8* end_;
+  bool has_error_ = false;
+};
+
+struct RawPosition {
+  int bci;
+  int line;
+  int column;
+};
+
+struct RawMethod {
+  int id;
+  int bytecode_size;
+  int type;
+  int outer;  // -1 if absent.
+  int name;
+  int holder_name;
+  int error_path;
+  int line;
+  int column;
+  std::vector<RawPosition> positions;
+};
+
+class Builder {
+ public:
+  bool read(List<const uint8> source_map);
+  uint8* emit(const uint8* uuid, int* size);
+
+ private:
+  std::vector<std::string> strings_;
+  std::vector<int> class_names_;
+  std::vector<RawMethod> methods_;
+  std::unordered_map<int, int> method_indexes_;
+
+  bool read_strings(SourceMapReader* reader);
+  bool read_methods(SourceMapReader* reader);
+  bool read_classes(SourceMapReader* reader);
+
+  int read_string_index(SourceMapReader* reader) {
+    int index = reader->read_cardinal();
+    if (index >= static_cast<int>(strings_.size())) return -1;
+    return index;
+  }
+
+  std::string stack_trace_name(const RawMethod& method, int depth);
+  std::string prefix_name(const RawMethod& method, int depth);
+};
+
+bool Builder::read(List<const uint8> source_map) {
+  SourceMapReader segments(source_map.data(), source_map.data() + source_map.length());
+  while (!segments.at_end()) {
+    uint32 tag = segments.read_uint32();
+    // The size of a segment includes its header.
+    int content_size = static_cast<int>(segments.read_uint32()) - 2 * UINT32_SIZE;
+    const uint8* content = segments.read_bytes(content_size);
+    if (segments.has_error()) return false;
+    SourceMapReader reader(content, content + content_size);
+    bool succeeded = true;
+    switch (tag) {
+      case STRING_SEGMENT_TAG: succeeded = read_strings(&reader); break;
+      case METHOD_SEGMENT_TAG: succeeded = read_methods(&reader); break;
+      case CLASS_SEGMENT_TAG: succeeded = read_classes(&reader); break;
+      default: break;  // Not needed for symbolization.
+    }
+    if (!succeeded || reader.has_error()) return false;
+  }
+  return true;
+}
+
+bool Builder::read_strings(SourceMapReader* reader) {
+  int count = reader->read_cardinal();
+  for (int i = 0; i < count && !reader->has_error(); i++) {
+    int length = reader->read_cardinal();
+    const uint8* bytes = reader->read_bytes(length);
+    if (bytes == null) return false;
+    strings_.push_back(std::string(char_cast(bytes), length));
+  }
+  return true;
+}
+
+bool Builder::read_methods(SourceMapReader* reader) {
+  int count = reader->read_cardinal();
+  for (int i = 0; i < count && !reader->has_error(); i++) {
+    RawMethod method;
+    method.id = reader->read_cardinal();
+    method.bytecode_size = reader->read_cardinal();
+    method.type = reader->read_byte();
+    method.outer = reader->read_byte() == 1 ? reader->read_cardinal() : -1;
+    method.name = read_string_index(reader);
+    method.holder_name = read_string_index(reader);
+    read_string_index(reader);  // The absolute path.
+    method.error_path = read_string_index(reader);
+    if (method.name < 0 || method.holder_name < 0 || method.error_path < 0) return false;
+    method.line = reader->read_cardinal();
+    method.column = reader->read_cardinal();
+    int position_count = reader->read_cardinal();
+    for (int j = 0; j < position_count && !reader->has_error(); j++) {
+      RawPosition position;
+      position.bci = reader->read_cardinal();
+      position.line = reader->read_cardinal();
+      position.column = reader->read_cardinal();
+      method.positions.push_back(position);
+    }
+    // Skip the names of `as` checks.
+    int as_count = reader->read_cardinal();
+    for (int j = 0; j < as_count && !reader->has_error(); j++) {
+      reader->read_cardinal();
+      reader->read_cardinal();
+    }
+    method_indexes_[method.id] = methods_.size();
+    methods_.push_back(method);
+  }
+  return true;
+}
+
+bool Builder::read_classes(SourceMapReader* reader) {
+  int count = reader->read_cardinal();
+  for (int i = 0; i < count && !reader->has_error(); i++) {
+    reader->read_cardinal();  // Encoded super id.
+    reader->read_cardinal();  // Location id.
+    int name = read_string_index(reader);
+    if (name < 0) return false;
+    class_names_.push_back(name);
+    read_string_index(reader);  // Absolute path.
+    read_string_index(reader);  // Error path.
+    reader->read_cardinal();    // Line.
+    reader->read_cardinal();    // Column.
+    int field_count = reader->read_cardinal();
+    for (int j = 0; j < field_count && !reader->has_error(); j++) read_string_index(reader);
+  }
+  return true;
+}
+
+// Mirrors `MethodInfo.prefix-string` in tools/snapshot.toit, so symbolized
+// traces look the same as the ones decoded from the full source map.
+std::string Builder::prefix_name(const RawMethod& method, int depth) {
+  const std::string& name = strings_[method.name];
+  auto outer = method_indexes_.find(method.outer);
+  bool is_code = method.type == BLOCK_METHOD_TYPE || method.type == LAMBDA_METHOD_TYPE;
+  if (is_code) {
+    // Guard against malformed cycles of outer methods.
+    if (outer == method_indexes_.end() || depth > 100) return name;
+    std::string outer_prefix = prefix_name(methods_[outer->second], depth + 1);
+    return (method.type == BLOCK_METHOD_TYPE ? "[block] in " : "[lambda] in ") + outer_prefix;
+  }
+  if (method.type == INSTANCE_METHOD_TYPE) {
+    if (method.outer < 0 || method.outer >= static_cast<int>(class_names_.size())) return name;
+    return strings_[class_names_[method.outer]] + "." + name;
+  }
+  const std::string& holder = strings_[method.holder_name];
+  if (holder.empty()) return name;
+  if (name == "constructor") return holder;
+  return holder + "." + name;
+}
+
+// Mirrors `MethodInfo.stacktrace-string` in tools/snapshot.toit.
+std::string Builder::stack_trace_name(const RawMethod& method, int depth) {
+  bool is_code = method.type == BLOCK_METHOD_TYPE || method.type == LAMBDA_METHOD_TYPE;
+  if (!is_code) return prefix_name(method, depth);
+  auto outer = method_indexes_.find(method.outer);
+  if (outer == method_indexes_.end() || depth > 100) return strings_[method.name];
+  return stack_trace_name(methods_[outer->second], depth + 1) + "." + strings_[method.name];
+}
+
+uint8* Builder::emit(const uint8* uuid, int* size) {
+  std::sort(methods_.begin(), methods_.end(), [](const RawMethod& a, const RawMethod& b) {
+    return a.id < b.id;
+  });
+  for (int i = 0; i < static_cast<int>(methods_.size()); i++) method_indexes_[methods_[i].id] = i;
+
+  std::string pool;
+  std::unordered_map<std::string, uint32> interned;
+  auto intern = [&](const std::string& string) -> uint32 {
+    auto probe = interned.find(string);
+    if (probe != interned.end()) return probe->second;
+    uint32 offset = pool.size();
+    pool.append(string);
+    pool.push_back('\0');
+    interned[string] = offset;
+    return offset;
+  };
+  std::vector<uint32> files;
+  std::unordered_map<int, uint32> file_indexes;
+
+  std::vector<DebugInfo::MethodEntry> method_entries;
+  std::vector<DebugInfo::PositionEntry> position_entries;
+  for (auto& method : methods_) {
+    auto probe = file_indexes.find(method.error_path);
+    uint32 file;
+    if (probe == file_indexes.end()) {
+      file = files.size();
+      files.push_back(intern(strings_[method.error_path]));
+      file_indexes[method.error_path] = file;
+    } else {
+      file = probe->second;
+    }
+    std::sort(method.positions.begin(), method.positions.end(),
+              [](const RawPosition& a, const RawPosition& b) { return a.bci < b.bci; });
+    DebugInfo::MethodEntry entry = {
+      .id = static_cast<uint32>(method.id),
+      .bytecode_size = static_cast<uint32>(method.bytecode_size),
+      .name = intern(stack_trace_name(method, 0)),
+      .file = file,
+      .position = DebugInfo::encode_position(method.line, method.column),
+      .first_position = static_cast<uint32>(position_entries.size()),
+      .position_count = static_cast<uint32>(method.positions.size()),
+    };
+    method_entries.push_back(entry);
+    for (auto position : method.positions) {
+      position_entries.push_back({
+        .bci = static_cast<uint32>(position.bci),
+        .position = DebugInfo::encode_position(position.line, position.column),
+      });
+    }
+  }
+  // Keep the total size word aligned.
+  while (pool.size() % UINT32_SIZE != 0) pool.push_back('\0');
+
+  DebugInfo::Header header;
+  header.magic = DebugInfo::MAGIC;
+  header.version = DebugInfo::VERSION;
+  if (uuid == null) {
+    memset(header.uuid, 0, UUID_SIZE);
+  } else {
+    memcpy(header.uuid, uuid, UUID_SIZE);
+  }
+  header.method_count = method_entries.size();
+  header.position_count = position_entries.size();
+  header.file_count = files.size();
+  header.string_pool_size = pool.size();
+
+  size_t methods_size = method_entries.size() * sizeof(DebugInfo::MethodEntry);
+  size_t positions_size = position_entries.size() * sizeof(DebugInfo::PositionEntry);
+  size_t files_size = files.size() * sizeof(uint32);
+  *size = sizeof(header) + methods_size + positions_size + files_size + pool.size();
+  uint8* result = unvoid_cast<uint8*>(malloc(*size));
+  if (result == null) return null;
+  uint8* pos = result;
+  memcpy(pos, &header, sizeof(header));
+  pos += sizeof(header);
+  memcpy(pos, method_entries.data(), methods_size);
+  pos += methods_size;
+  memcpy(pos, position_entries.data(), positions_size);
+  pos += positions_size;
+  memcpy(pos, files.data(), files_size);
+  pos += files_size;
+  memcpy(pos, pool.data(), pool.size());
+  return result;
+}
+
+}  // namespace anonymous
+
+uint8* DebugInfo::build(List<const uint8> source_map, const uint8* uuid, int* size) {
+  AllowThrowingNew host_only;
+  Builder builder;
+  if (!builder.read(source_map)) return null;
+  return builder.emit(uuid, size);
+}
+
+} // namespace toit
+
+#endif  // TOIT_FREERTOS
@@ -0,0 +1,133 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+#include "utils.h"
+#include "uuid.h"
+
+namespace toit {
+
+#ifndef TOIT_FREERTOS
+
+/// An indexed form of the source map that is used to symbolize stack traces.
+///
+/// Contrary to the source map, which must be decoded completely before it can
+///   be used, the debug info is laid out so it can be mapped into memory and
+///   queried directly. A lookup is a binary search over the methods followed
+///   by a binary search over the positions of the method.
+///
+/// The compiler doesn't emit the debug info. It is built from the source map
+///   of a snapshot bundle as a separate step, with `toit.symbolize --build`.
+///
+/// All fields are uint32s in the byte order of the host that built the debug
+///   info, so it can be read in place on the same kind of host:
+///   header:    see `Header`.
+///   methods:   one `MethodEntry` per method, sorted by id.
+///   positions: one `PositionEntry` per call site, grouped by method and
+///              sorted by bci within each method.
+///   files:     offsets into the string pool, one per source file.
+///   strings:   the interned, zero-terminated names and paths.
+class DebugInfo {
+ public:
+  static const uint32 MAGIC = 70177031;
+  static const uint32 VERSION = 1;
+
+  struct Header {
+    uint32 magic;
+    uint32 version;
+    uint8 uuid[UUID_SIZE];
+    uint32 method_count;
+    uint32 position_count;
+    uint32 file_count;
+    uint32 string_pool_size;
+  };
+
+  struct MethodEntry {
+    uint32 id;             // The absolute bci of the method header.
+    uint32 bytecode_size;
+    uint32 name;           // Offset in the string pool of the stack-trace name.
+    uint32 file;           // Index in the file table.
+    uint32 position;       // The line and column, see `encode_position`.
+    uint32 first_position;
+    uint32 position_count;
+  };
+
+  struct PositionEntry {
+    uint32 bci;            // Relative to the first bytecode of the method.
+    uint32 position;
+  };
+
+  // Lines and columns share a word. Columns beyond the maximum are clamped.
+  static const int COLUMN_BITS = 12;
+  static const int MAX_COLUMN = (1 << COLUMN_BITS) - 1;
+
+  static uint32 encode_position(int line, int column) {
+    return (static_cast<uint32>(line) << COLUMN_BITS) | Utils::min(column, MAX_COLUMN);
+  }
+  static int line_from(uint32 position) { return position >> COLUMN_BITS; }
+  static int column_from(uint32 position) { return position & MAX_COLUMN; }
+
+  struct Location {
+    const char* name;
+    const char* path;
+    int line;
+    int column;
+    int method_id;
+    int bci;
+  };
+
+  DebugInfo(const uint8* data, word size) : data_(data), size_(size) {}
+
+  // Whether the data has the expected magic, version and section sizes, and
+  //   all offsets and indexes of the entries are within their sections.
+  bool is_valid() const;
+
+  const uint8* uuid() const { return header()->uuid; }
+  int method_count() const { return header()->method_count; }
+
+  // Finds the method containing the given absolute bci, as reported in
+  //   stack traces, and the source position of the bci.
+  // Returns false if no method contains the bci.
+  bool lookup(int absolute_bci, Location* result) const;
+
+  // Builds the debug info from a cooked source map.
+  // The uuid is the one of the program the source map belongs to.
+  // Returns a malloced buffer, or null if the source map is malformed.
+  static uint8* build(List<const uint8> source_map, const uint8* uuid, int* size);
+
+ private:
+  const uint8* data_;
+  word size_;
+
+  const Header* header() const { return reinterpret_cast<const Header*>(data_); }
+  const MethodEntry* methods() const {
+    return reinterpret_cast<const MethodEntry*>(data_ + sizeof(Header));
+  }
+  const PositionEntry* positions() const {
+    return reinterpret_cast<const PositionEntry*>(methods() + header()->method_count);
+  }
+  const uint32* files() const {
+    return reinterpret_cast<const uint32*>(positions() + header()->position_count);
+  }
+  const char* strings() const {
+    return reinterpret_cast<const char*>(files() + header()->file_count);
+  }
+};
+
+#endif  // TOIT_FREERTOS
+
+} // namespace toit
@@ -0,0 +1,325 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "delta.h"
+
+namespace toit {
+
+const uint8 Delta::MAGIC[4] = { 'T', 'D', 'L', '1' };
+
+static inline uword zigzag_encode(word value) {
+  return (static_cast<uword>(value) << 1) ^ static_cast<uword>(value >> (WORD_BIT_SIZE - 1));
+}
+
+static inline word zigzag_decode(uword value) {
+  return static_cast<word>(value >> 1) ^ -static_cast<word>(value & 1);
+}
+
+static inline uword hash_key(uint32 key) {
+  return key * 0x9e3779b1u;
+}
+
+DeltaEncoder::~DeltaEncoder() {
+  free(keys_);
+  free(table_);
+  free(buffer_);
+}
+
+bool DeltaEncoder::build_index() {
+  word blocks = source_length_ / block_size_;
+  if (blocks == 0) return true;
+  word table_size = Utils::round_up_to_power_of_two(blocks * 2);
+  keys_ = unvoid_cast<uint32*>(malloc(blocks * sizeof(uint32)));
+  table_ = unvoid_cast<uint32*>(calloc(table_size, sizeof(uint32)));
+  if (keys_ == null || table_ == null) return false;
+  table_mask_ = table_size - 1;
+  for (word i = 0; i < blocks; i++) {
+    Adler32 checksum(null);
+    checksum.add(source_ + i * block_size_, block_size_);
+    uint32 key = checksum_key(&checksum);
+    keys_[i] = key;
+    word slot = hash_key(key) & table_mask_;
+    while (table_[slot] != 0) slot = (slot + 1) & table_mask_;
+    table_[slot] = i + 1;
+  }
+  return true;
+}
+
+word DeltaEncoder::find_match(uint32 key, word position, word* match) {
+  word best_length = 0;
+  word slot = hash_key(key) & table_mask_;
+  // Bound the number of candidates, so runs of identical blocks don't make
+  // the search quadratic.
+  for (int probes = 0; table_[slot] != 0 && probes < 16; probes++) {
+    word block = table_[slot] - 1;
+    slot = (slot + 1) & table_mask_;
+    if (keys_[block] != key) continue;
+    word start = block * block_size_;
+    if (memcmp(source_ + start, target_ + position, block_size_) != 0) continue;
+    word length = block_size_;
+    while (start + length < source_length_ &&
+           position + length < target_length_ &&
+           source_[start + length] == target_[position + length]) {
+      length++;
+    }
+    // Prefer continuing where the last copy ended, since that encodes
+    // the shortest.
+    if (length > best_length || (length == best_length && start == last_copy_end_)) {
+      best_length = length;
+      *match = start;
+    }
+  }
+  return best_length;
+}
+
+bool DeltaEncoder::encode() {
+  if (!build_index()) return false;
+  for (int i = 0; i < 4; i++) {
+    if (!emit_byte(Delta::MAGIC[i])) return false;
+  }
+  if (!emit_uvarint(source_length_) || !emit_uvarint(target_length_)) return false;
+
+  word literal_start = 0;
+  word position = 0;
+  Adler32 rolling(null);
+  bool rolling_valid = false;
+  while (table_ != null && position + block_size_ <= target_length_) {
+    if (!rolling_valid) {
+      Adler32 window(null);
+      window.add(target_ + position, block_size_);
+      window.clone(&rolling);
+      rolling_valid = true;
+    }
+    word match = 0;
+    word length = find_match(checksum_key(&rolling), position, &match);
+    if (length == 0) {
+      if (position + block_size_ < target_length_) {
+        rolling.add(target_ + position + block_size_, 1);
+        rolling.unadd(target_ + position, 1);
+      }
+      position++;
+      continue;
+    }
+    // Extend the match backwards into the pending literal.
+    while (position > literal_start && match > 0 && source_[match - 1] == target_[position - 1]) {
+      position--;
+      match--;
+      length++;
+    }
+    if (!emit_literal(literal_start, position)) return false;
+    if (!emit_copy(match, length)) return false;
+    position += length;
+    literal_start = position;
+    rolling_valid = false;
+  }
+  if (!emit_literal(literal_start, target_length_)) return false;
+
+  Adler32 checksum(null);
+  checksum.add(target_, target_length_);
+  if (!emit_byte(Delta::END) || !ensure(Delta::CHECKSUM_SIZE)) return false;
+  checksum.get(buffer_ + length_);
+  length_ += Delta::CHECKSUM_SIZE;
+  return true;
+}
+
+bool DeltaEncoder::ensure(word extra) {
+  if (length_ + extra <= capacity_) return true;
+  word capacity = Utils::max<word>(Utils::max<word>(capacity_ * 2, 256), length_ + extra);
+  uint8* buffer = unvoid_cast<uint8*>(realloc(buffer_, capacity));
+  if (buffer == null) return false;
+  buffer_ = buffer;
+  capacity_ = capacity;
+  return true;
+}
+
+bool DeltaEncoder::emit_byte(uint8 value) {
+  if (!ensure(1)) return false;
+  buffer_[length_++] = value;
+  return true;
+}
+
+bool DeltaEncoder::emit_uvarint(uword value) {
+  while (value >= 0x80) {
+    if (!emit_byte(static_cast<uint8>(value | 0x80))) return false;
+    value >>= 7;
+  }
+  return emit_byte(static_cast<uint8>(value));
+}
+
+bool DeltaEncoder::emit_literal(word from, word to) {
+  if (from == to) return true;
+  word length = to - from;
+  if (!emit_byte(Delta::LITERAL) || !emit_uvarint(length) || !ensure(length)) return false;
+  memcpy(buffer_ + length_, target_ + from, length);
+  length_ += length;
+  return true;
+}
+
+bool DeltaEncoder::emit_copy(word offset, word length) {
+  if (!emit_byte(Delta::COPY)) return false;
+  if (!emit_uvarint(zigzag_encode(offset - last_copy_end_))) return false;
+  if (!emit_uvarint(length)) return false;
+  last_copy_end_ = offset + length;
+  return true;
+}
+
+bool DeltaPatcher::read_uvarint(const uint8** input, const uint8* end, bool* error) {
+  while (*input < end) {
+    uint8 byte = *(*input)++;
+    if (varint_shift_ >= WORD_BIT_SIZE) {
+      *error = true;
+      return false;
+    }
+    varint_ |= static_cast<uword>(byte & 0x7f) << varint_shift_;
+    varint_shift_ += 7;
+    if ((byte & 0x80) == 0) {
+      varint_shift_ = 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DeltaPatcher::patch(const uint8* source, word source_length,
+                         const uint8* input, word input_length, word* read,
+                         uint8* output, word output_length, word* written) {
+  const uint8* in = input;
+  const uint8* in_end = input + input_length;
+  uint8* out = output;
+  uint8* out_end = output + output_length;
+  bool error = false;
+  // The copies are bounded by the source size in the header, so every part
+  // of the delta must be applied to a source of that size.
+  if (state_ > SOURCE_SIZE && source_length != source_size_) return false;
+
+  while (true) {
+    switch (state_) {
+      case MAGIC:
+        if (in == in_end) goto done;
+        if (*in++ != Delta::MAGIC[position_++]) return false;
+        if (position_ == 4) state_ = SOURCE_SIZE;
+        break;
+
+      case SOURCE_SIZE:
+        if (!read_uvarint(&in, in_end, &error)) goto done;
+        source_size_ = varint_;
+        varint_ = 0;
+        // The delta must be applied to the source it was made for.
+        if (source_size_ != source_length) return false;
+        state_ = TARGET_SIZE;
+        break;
+
+      case TARGET_SIZE:
+        if (!read_uvarint(&in, in_end, &error)) goto done;
+        target_remaining_ = varint_;
+        varint_ = 0;
+        if (target_remaining_ < 0) return false;
+        state_ = COMMAND;
+        break;
+
+      case COMMAND: {
+        if (in == in_end) goto done;
+        uint8 command = *in++;
+        if (command == Delta::LITERAL) {
+          state_ = LITERAL_LENGTH;
+        } else if (command == Delta::COPY) {
+          state_ = COPY_OFFSET;
+        } else if (command == Delta::END && target_remaining_ == 0) {
+          position_ = 0;
+          state_ = TRAILER;
+        } else {
+          return false;
+        }
+        break;
+      }
+
+      case LITERAL_LENGTH:
+        if (!read_uvarint(&in, in_end, &error)) goto done;
+        remaining_ = varint_;
+        varint_ = 0;
+        if (remaining_ <= 0 || remaining_ > target_remaining_) return false;
+        state_ = LITERAL;
+        break;
+
+      case LITERAL: {
+        word length = Utils::min(remaining_, Utils::min(in_end - in, out_end - out));
+        if (length == 0) goto done;
+        memcpy(out, in, length);
+        checksum_.add(out, length);
+        in += length;
+        out += length;
+        remaining_ -= length;
+        target_remaining_ -= length;
+        if (remaining_ == 0) state_ = COMMAND;
+        break;
+      }
+
+      case COPY_OFFSET:
+        if (!read_uvarint(&in, in_end, &error)) goto done;
+        copy_position_ = last_copy_end_ + zigzag_decode(varint_);
+        varint_ = 0;
+        state_ = COPY_LENGTH;
+        break;
+
+      case COPY_LENGTH:
+        if (!read_uvarint(&in, in_end, &error)) goto done;
+        remaining_ = varint_;
+        varint_ = 0;
+        if (remaining_ <= 0 || remaining_ > target_remaining_) return false;
+        if (copy_position_ < 0 || copy_position_ > source_size_ - remaining_) return false;
+        last_copy_end_ = copy_position_ + remaining_;
+        state_ = COPY;
+        break;
+
+      case COPY: {
+        word length = Utils::min(remaining_, out_end - out);
+        if (length == 0) goto done;
+        memcpy(out, source + copy_position_, length);
+        checksum_.add(out, length);
+        copy_position_ += length;
+        out += length;
+        remaining_ -= length;
+        target_remaining_ -= length;
+        if (remaining_ == 0) state_ = COMMAND;
+        break;
+      }
+
+      case TRAILER:
+        if (in == in_end) goto done;
+        trailer_[position_++] = *in++;
+        if (position_ == Delta::CHECKSUM_SIZE) {
+          uint8 hash[Delta::CHECKSUM_SIZE];
+          checksum_.get(hash);
+          if (memcmp(hash, trailer_, Delta::CHECKSUM_SIZE) != 0) return false;
+          state_ = DONE;
+        }
+        break;
+
+      case DONE:
+        // Trailing bytes after the delta are an error.
+        if (in != in_end) return false;
+        goto done;
+    }
+  }
+
+done:
+  // A varint was too long.
+  if (error) return false;
+  *read = in - input;
+  *written = out - output;
+  return true;
+}
+
+} // namespace toit
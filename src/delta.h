@@ -0,0 +1,159 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+#include "nano_zlib.h"
+#include "resource.h"
+#include "tags.h"
+
+namespace toit {
+
+// Binary deltas between two versions of an image.
+//
+// A delta is a sequence of commands that produce the target from the source:
+//
+//   header:   'T' 'D' 'L' '1', uvarint source size, uvarint target size.
+//   literal:  0x00, uvarint length, followed by the bytes.
+//   copy:     0x01, zigzag varint offset relative to the end of the previous
+//             copy, uvarint length.
+//   trailer:  0xff, followed by the Adler-32 checksum of the target.
+//
+// Unchanged parts of an image are mostly copied in order, so most copies
+// have a relative offset of zero and the delta compresses well.
+class Delta {
+ public:
+  static const uint8 MAGIC[4];
+  static const uint8 LITERAL = 0x00;
+  static const uint8 COPY = 0x01;
+  static const uint8 END = 0xff;
+  static const int CHECKSUM_SIZE = 4;
+};
+
+// Computes a delta rsync-style: the source is split into blocks that are
+// indexed by their Adler-32 checksum, and a window of the same size is
+// rolled over the target to find them. Matches are extended in both
+// directions.
+class DeltaEncoder {
+ public:
+  DeltaEncoder(const uint8* source, word source_length,
+               const uint8* target, word target_length,
+               int block_size)
+      : source_(source)
+      , source_length_(source_length)
+      , target_(target)
+      , target_length_(target_length)
+      , block_size_(block_size) {}
+  ~DeltaEncoder();
+
+  // Returns false if memory couldn't be allocated.
+  bool encode();
+
+  const uint8* delta() const { return buffer_; }
+  word delta_length() const { return length_; }
+
+ private:
+  bool build_index();
+  // Returns the length of the longest match at the target position, and
+  // the source position of it in *match.
+  word find_match(uint32 key, word position, word* match);
+
+  bool ensure(word extra);
+  bool emit_byte(uint8 value);
+  bool emit_uvarint(uword value);
+  bool emit_literal(word from, word to);
+  bool emit_copy(word offset, word length);
+
+  static uint32 checksum_key(Adler32* checksum) {
+    uint8 hash[Delta::CHECKSUM_SIZE];
+    checksum->get(hash);
+    return Utils::read_unaligned_uint32_be(hash);
+  }
+
+  const uint8* const source_;
+  const word source_length_;
+  const uint8* const target_;
+  const word target_length_;
+  const int block_size_;
+
+  // The checksums of the source blocks and a hash table of the block
+  // indexes, plus one, so zero marks an empty slot.
+  uint32* keys_ = null;
+  uint32* table_ = null;
+  word table_mask_ = 0;
+
+  word last_copy_end_ = 0;
+
+  uint8* buffer_ = null;
+  word length_ = 0;
+  word capacity_ = 0;
+};
+
+// Applies a delta to a source, while the delta is streamed in.
+class DeltaPatcher : public SimpleResource {
+ public:
+  TAG(DeltaPatcher);
+  explicit DeltaPatcher(SimpleResourceGroup* group)
+      : SimpleResource(group)
+      , checksum_(null) {}
+
+  // Consumes delta bytes from the input and produces target bytes in the
+  // output, until either runs out. Returns false if the delta is malformed
+  // or doesn't fit the source.
+  bool patch(const uint8* source, word source_length,
+             const uint8* input, word input_length, word* read,
+             uint8* output, word output_length, word* written);
+
+  // Whether the full delta has been applied and the checksum of the target
+  // matched.
+  bool is_done() const { return state_ == DONE; }
+
+ private:
+  enum State {
+    MAGIC,
+    SOURCE_SIZE,
+    TARGET_SIZE,
+    COMMAND,
+    LITERAL_LENGTH,
+    LITERAL,
+    COPY_OFFSET,
+    COPY_LENGTH,
+    COPY,
+    TRAILER,
+    DONE,
+  };
+
+  // Reads a varint that may be split over several inputs. Returns true
+  // when it is complete.
+  bool read_uvarint(const uint8** input, const uint8* end, bool* error);
+
+  State state_ = MAGIC;
+  int position_ = 0;  // Position in the magic or the trailer.
+  uint8 trailer_[Delta::CHECKSUM_SIZE];
+
+  uword varint_ = 0;
+  int varint_shift_ = 0;
+
+  word source_size_ = 0;
+  word target_remaining_ = 0;
+  word remaining_ = 0;  // Remaining bytes of the current literal or copy.
+  word copy_position_ = 0;
+  word last_copy_end_ = 0;
+
+  Adler32 checksum_;
+};
+
+} // namespace toit
@@ -50,6 +50,8 @@ namespace toit {
   FLAG_BOOL(deploy,  dhcp,                  false, "Use DHCP (only LWIP-on-Linux")  \
   FLAG_BOOL(deploy,  no_fork,               _NO_FORK, "Don't fork the compiler")    \
   FLAG_BOOL(deploy,  propagate,             false, "Propagate types")               \
+  FLAG_BOOL(deploy,  cpu_affinity,          false, "Pin scheduler threads to cores") \
+  FLAG_BOOL(deploy,  numa,                  false, "Keep processes on the NUMA node of their heap") \
   FLAG_BOOL(debug,   trace,                 false, "Trace interpreter")             \
   FLAG_BOOL(debug,   primitives,            false, "Trace primitives")              \
   FLAG_BOOL(deploy,  tracegc,               TRACE_GC, "Trace garbage collector")    \
@@ -68,6 +70,11 @@ namespace toit {
   FLAG_BOOL(debug,   print_bytecodes,       false, "Print the bytecodes for each method") \
   FLAG_BOOL(debug,   disable_tree_shaking,  false, "Disables tree-shaking")         \
   FLAG_BOOL(debug,   report_tree_shaking,   false, "Report stats on tree shaking")  \
+  FLAG_BOOL(deploy,  report_compiler_memory, false, "Report memory and time used by the compiler phases") \
+  FLAG_BOOL(deploy,  compress_snapshot,     false, "Compress generated program snapshots") \
+  FLAG_BOOL(deploy,  report_snapshot,       false, "Report snapshot sizes and load times") \
+  FLAG_BOOL(deploy,  scalar_scanner,        false, "Scan sources one byte at a time, without vector instructions") \
+  FLAG_BOOL(deploy,  report_filesystem,     false, "Report the filesystem operations of the compiler") \
   FLAG_BOOL(debug,   print_dependency_tree, false, "Prints the dependency tree used in the source-shaking") \
   FLAG_BOOL(deploy,  enable_asserts,        _ASSERT_DEFAULT, "Enables asserts")     \
   FLAG_BOOL(deploy,  migrate_dash_ids,      false, "Prints migration information for dash identifiers")  \
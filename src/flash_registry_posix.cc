@@ -48,9 +48,114 @@ static bool is_dirty() {
   return dirty_start < dirty_end;
 }
 
+static void sync_range(int start, int end) {
+  int offset = Utils::round_down(start, pagesize);
+  int size = Utils::round_up(end - offset, pagesize);
+  if (msync(void_cast(FlashRegistry::region(offset, size)), size, MS_SYNC) != 0) {
+    perror("FlashRegistry::flush/msync");
+  }
+}
+
+// Syncs the file-backed registry to disk in the background, so writing
+// large images doesn't block the interpreter on msync. The memory mapping
+// is shared, so reads see the written content before it has been synced.
+class FlushThread : public Thread {
+ public:
+  FlushThread()
+      : Thread("FlashRegistry flush")
+      , mutex_(OS::allocate_mutex(98, "FlashRegistry flush"))
+      , changed_(OS::allocate_condition_variable(mutex_))
+      , synced_(OS::allocate_condition_variable(mutex_)) {}
+
+  ~FlushThread() {
+    OS::dispose(synced_);
+    OS::dispose(changed_);
+    OS::dispose(mutex_);
+  }
+
+  // Adds the range to the pending range and wakes up the thread.
+  void request(int start, int end) {
+    Locker locker(mutex_);
+    pending_start_ = Utils::min(pending_start_, start);
+    pending_end_ = Utils::max(pending_end_, end);
+    OS::signal(changed_);
+  }
+
+  // Waits until all requested ranges have been synced.
+  void wait_until_synced() {
+    Locker locker(mutex_);
+    while (syncing_ || pending_start_ < pending_end_) OS::wait(synced_);
+  }
+
+  // Syncs the remaining range and stops the thread.
+  void stop() {
+    { Locker locker(mutex_);
+      stopped_ = true;
+      OS::signal(changed_);
+    }
+    join();
+  }
+
+ protected:
+  void entry() override {
+    Locker locker(mutex_);
+    while (true) {
+      if (pending_start_ < pending_end_) {
+        int start = pending_start_;
+        int end = pending_end_;
+        pending_start_ = INT32_MAX;
+        pending_end_ = 0;
+        syncing_ = true;
+        { Unlocker unlocker(locker);
+          sync_range(start, end);
+        }
+        syncing_ = false;
+        OS::signal_all(synced_);
+      } else if (stopped_) {
+        return;
+      } else {
+        OS::wait(changed_);
+      }
+    }
+  }
+
+ private:
+  Mutex* mutex_;
+  ConditionVariable* changed_;
+  ConditionVariable* synced_;
+  int pending_start_ = INT32_MAX;
+  int pending_end_ = 0;
+  bool syncing_ = false;
+  bool stopped_ = false;
+};
+
+static FlushThread* flush_thread = null;
+
+// Dirty ranges of this size are synced in the background while they are
+// written, so the flush that commits an image has little left to do.
+static const int BACKGROUND_SYNC_SIZE = 256 * KB;
+
+static void sync_dirty_in_background() {
+  if (flush_thread == null) {
+    FlushThread* thread = _new FlushThread();
+    if (thread == null || !thread->spawn()) {
+      // The range stays dirty and is synced by the next flush.
+      delete thread;
+      return;
+    }
+    flush_thread = thread;
+  }
+  flush_thread->request(dirty_start, dirty_end);
+  dirty_start = INT32_MAX;
+  dirty_end = 0;
+}
+
 static void mark_dirty(int offset, int size) {
   dirty_start = Utils::min(dirty_start, offset);
   dirty_end = Utils::max(dirty_end, offset + size);
+  if (is_file_backed && dirty_end - dirty_start >= BACKGROUND_SYNC_SIZE) {
+    sync_dirty_in_background();
+  }
 }
 
 void FlashRegistry::set_up() {
@@ -106,6 +211,12 @@ void FlashRegistry::set_up() {
 }
 
 void FlashRegistry::tear_down() {
+  if (flush_thread != null) {
+    flush_thread->stop();
+    delete flush_thread;
+    flush_thread = null;
+  }
+  if (is_file_backed && is_dirty()) sync_range(dirty_start, dirty_end);
   allocations_memory_ = null;
   if (munmap(allocations_mmap, allocations_mmap_size) != 0) {
     perror("FlashRegistry::tear_down/munmap");
@@ -114,14 +225,14 @@ void FlashRegistry::tear_down() {
 }
 
 void FlashRegistry::flush() {
-  if (!is_file_backed || !is_dirty()) return;
-  int offset = Utils::round_down(dirty_start, pagesize);
-  int size = Utils::round_up(dirty_end - offset, pagesize);
-  if (msync(void_cast(allocations_memory_ + offset), size, MS_SYNC) != 0) {
-    perror("FlashRegistry::flush/msync");
-  }
+  if (!is_file_backed) return;
+  // Committing an image relies on its content being on disk when this
+  // returns, so the ranges that are synced in the background are waited
+  // for too.
+  if (is_dirty()) sync_range(dirty_start, dirty_end);
   dirty_start = INT32_MAX;
   dirty_end = 0;
+  if (flush_thread != null) flush_thread->wait_until_synced();
   ASSERT(!is_dirty());
 }
 
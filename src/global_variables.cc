@@ -0,0 +1,76 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "global_variables.h"
+
+#include "objects.h"
+#include "program.h"
+
+namespace toit {
+
+GlobalVariables* GlobalVariables::create(Program* program) {
+  Object** initial = program->global_variables.array();
+  int length = program->global_variables.length();
+  void* memory = malloc(sizeof(GlobalVariables) + page_count(length) * sizeof(Object**));
+  if (memory == null) return null;
+  GlobalVariables* result = new (memory) GlobalVariables(initial, length);
+  result->reset();
+  return result;
+}
+
+void GlobalVariables::destroy(GlobalVariables* globals) {
+  if (globals == null) return;
+  globals->reset();
+  globals->~GlobalVariables();
+  free(globals);
+}
+
+void GlobalVariables::reset() {
+  Object*** table = pages();
+  int count = page_count();
+  for (int i = 0; i < count; i++) {
+    // Pages that were never copied point into the table of the program.
+    if (copied_pages_ > 0 && !is_shared(table[i], i)) free(table[i]);
+    table[i] = initial_ + (i << PAGE_BITS);
+  }
+  copied_pages_ = 0;
+}
+
+Object** GlobalVariables::copy_page(int index) {
+  int length = page_length(length_, index);
+  Object** page = unvoid_cast<Object**>(malloc(length * sizeof(Object*)));
+  if (page == null) return null;
+  memcpy(page, initial_ + (index << PAGE_BITS), length * sizeof(Object*));
+  pages()[index] = page;
+  copied_pages_++;
+  return page;
+}
+
+void GlobalVariables::do_roots(RootCallback* callback) {
+  if (copied_pages_ == 0) return;
+  Object*** table = pages();
+  int count = page_count();
+  for (int i = 0; i < count; i++) {
+    if (is_shared(table[i], i)) continue;
+    callback->do_roots(table[i], page_length(length_, i));
+  }
+}
+
+uword GlobalVariables::memory_usage() const {
+  uword table_size = sizeof(GlobalVariables) + page_count() * sizeof(Object**);
+  return table_size + static_cast<uword>(copied_pages_) * PAGE_SIZE * sizeof(Object*);
+}
+
+} // namespace toit
@@ -0,0 +1,106 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+
+namespace toit {
+
+class RootCallback;
+
+/// The global variables of a process.
+///
+/// The table is split into pages. Until a process writes to a page, the page
+///   is shared with the program, whose table holds the initial values (the
+///   constant values and the lazy initializers). The first store into a page,
+///   including the one that finishes a lazy initialization, copies it to the
+///   process.
+///
+/// A process that never writes to most of its globals thus doesn't pay for
+///   them, neither at spawn time nor in memory.
+class GlobalVariables {
+ public:
+  static const int PAGE_BITS = 5;
+  static const int PAGE_SIZE = 1 << PAGE_BITS;
+  static const int PAGE_MASK = PAGE_SIZE - 1;
+
+  // Creates the globals for a process of the program. All pages are shared.
+  // Returns null if the allocation failed.
+  static GlobalVariables* create(Program* program);
+  static void destroy(GlobalVariables* globals);
+
+  int length() const { return length_; }
+
+  Object* at(int index) const {
+    ASSERT(0 <= index && index < length_);
+    return pages()[index >> PAGE_BITS][index & PAGE_MASK];
+  }
+
+  // Returns false if the page couldn't be copied to the process. The value
+  //   is not stored in that case.
+  bool at_put(int index, Object* value) {
+    ASSERT(0 <= index && index < length_);
+    Object** page = pages()[index >> PAGE_BITS];
+    if (is_shared(page, index >> PAGE_BITS)) {
+      page = copy_page(index >> PAGE_BITS);
+      if (page == null) return false;
+    }
+    page[index & PAGE_MASK] = value;
+    return true;
+  }
+
+  // Shares all pages with the program again, so the globals have their
+  //   initial values.
+  void reset();
+
+  // Visits the pages that have been copied. The shared pages only refer to
+  //   objects in the program.
+  void do_roots(RootCallback* callback);
+
+  int copied_pages() const { return copied_pages_; }
+  int page_count() const { return page_count(length_); }
+
+  // The memory used by the process for its globals.
+  uword memory_usage() const;
+
+ private:
+  explicit GlobalVariables(Object** initial, int length)
+      : initial_(initial)
+      , length_(length) {}
+
+  static int page_count(int length) { return (length + PAGE_SIZE - 1) >> PAGE_BITS; }
+  static int page_length(int length, int page) {
+    int remaining = length - (page << PAGE_BITS);
+    return remaining < PAGE_SIZE ? remaining : PAGE_SIZE;
+  }
+
+  // The page table follows the object in memory.
+  Object*** pages() const {
+    return reinterpret_cast<Object***>(const_cast<GlobalVariables*>(this) + 1);
+  }
+
+  bool is_shared(Object** page, int index) const {
+    return page == initial_ + (index << PAGE_BITS);
+  }
+
+  Object** copy_page(int index);
+
+  Object** const initial_;
+  const int length_;
+  int copied_pages_ = 0;
+};
+
+} // namespace toit
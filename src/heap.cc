@@ -25,6 +25,7 @@
 #include "printing.h"
 #include "process.h"
 #include "scheduler.h"
+#include "string_intern.h"
 #include "utils.h"
 #include "vm.h"
 
@@ -109,9 +110,13 @@ String* ObjectHeap::allocate_internal_string(int length) {
 }
 
 bool InitialMemoryManager::allocate() {
-  initial_chunk = ObjectMemory::allocate_chunk(null, TOIT_PAGE_SIZE);
-  if (!initial_chunk) return false;
-  heap_mutex = OS::allocate_mutex(6, "ObjectHeapMutex");
+  if (!initial_chunk) {
+    initial_chunk = ObjectMemory::allocate_chunk(null, TOIT_PAGE_SIZE);
+    if (!initial_chunk) return false;
+  }
+  if (!heap_mutex) {
+    heap_mutex = OS::allocate_mutex(6, "ObjectHeapMutex");
+  }
   return heap_mutex != null;
 }
 
@@ -122,9 +127,10 @@ InitialMemoryManager::~InitialMemoryManager() {
   if (heap_mutex) {
     OS::dispose(heap_mutex);
   }
+  GlobalVariables::destroy(global_variables);
 }
 
-ObjectHeap::ObjectHeap(Program* program, Process* owner, Chunk* initial_chunk, Object** global_variables, Mutex* mutex)
+ObjectHeap::ObjectHeap(Program* program, Process* owner, Chunk* initial_chunk, GlobalVariables* global_variables, Mutex* mutex)
     : program_(program)
     , owner_(owner)
     , two_space_heap_(program, this, initial_chunk)
@@ -154,17 +160,28 @@ ObjectHeap::~ObjectHeap() {
   // unlinked, this may be called without the scheduler lock.  We don't
   // use the lock of the ObjectHeap itself for this.  Implicitly called
   // from the destructor of the Process.
-  free(global_variables_);
+  GlobalVariables::destroy(global_variables_);
 
   clean_up_finalizers(&registered_callback_finalizers_);
   clean_up_finalizers(&runnable_finalizers_);
   clean_up_finalizers(&registered_vm_finalizers_);
 
+  delete string_table_;
+
   OS::dispose(mutex_);
 
   ASSERT(object_notifiers_.is_empty());
 }
 
+void ObjectHeap::recycle_initial_memory(InitialMemoryManager* manager) {
+  ASSERT(manager->global_variables == null && manager->heap_mutex == null);
+  global_variables_->reset();
+  manager->global_variables = global_variables_;
+  manager->heap_mutex = mutex_;
+  global_variables_ = null;
+  mutex_ = null;
+}
+
 word ObjectHeap::update_pending_limit() {
   word length = two_space_heap_.size() + external_memory_;
   // We call a new GC when the heap size has doubled, in an attempt to do
@@ -283,7 +300,7 @@ Stack* ObjectHeap::allocate_stack(int length) {
 void ObjectHeap::iterate_roots(RootCallback* callback) {
   // Process the roots in the object heap.
   callback->do_root(reinterpret_cast<Object**>(&task_));
-  callback->do_roots(global_variables_, program()->global_variables.length());
+  if (global_variables_ != null) global_variables_->do_roots(callback);
   for (auto root : external_roots_) callback->do_roots(root->slot(), 1);
 
   // Process roots in the object_notifiers_ list.
@@ -349,6 +366,40 @@ void ObjectHeap::iterate_finalization_roots(RootCallback* cb) {
   for (auto finalizer : registered_callback_finalizers_) finalizer->roots_do(cb);
   for (auto finalizer : registered_vm_finalizers_) finalizer->roots_do(cb);
   for (auto finalizer : runnable_finalizers_) finalizer->roots_do(cb);
+  if (string_table_ != null) string_table_->roots_do(cb);
+}
+
+bool ObjectHeap::enable_string_interning() {
+  if (string_table_ == null) string_table_ = _new StringInternTable();
+  interning_strings_ = string_table_ != null;
+  return interning_strings_;
+}
+
+void ObjectHeap::disable_string_interning() {
+  interning_strings_ = false;
+  if (string_table_ != null) string_table_->clear();
+}
+
+word ObjectHeap::interned_strings() const {
+  return string_table_ == null ? 0 : string_table_->size();
+}
+
+void ObjectHeap::process_string_table(RootCallback* cb, LivenessOracle* oracle) {
+  if (string_table_ != null) string_table_->weak_processing(cb, oracle);
+}
+
+void ObjectHeap::deduplicate_strings(OldSpace* old_space, SemiSpace* semi_space) {
+  if (!interning_strings_) return;
+  StringDeduplicator deduplicator(program_, old_space, semi_space);
+  if (!deduplicator.run(this, string_table_)) return;
+  deduplicated_strings_ += deduplicator.deduplicated();
+  deduplicated_bytes_ += deduplicator.bytes_saved();
+  if (Flags::tracegc && deduplicator.deduplicated() != 0) {
+    printf("%p Deduplicated %d strings, %dk\n",
+        owner_,
+        static_cast<int>(deduplicator.deduplicated()),
+        static_cast<int>(deduplicator.bytes_saved() >> 10));
+  }
 }
 
 bool ObjectHeap::add_callable_finalizer(Instance* key, Object* lambda, bool weak_map) {
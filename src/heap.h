@@ -17,6 +17,7 @@
 
 #include <atomic>
 
+#include "global_variables.h"
 #include "heap_roots.h"
 #include "linked.h"
 #include "objects.h"
@@ -27,13 +28,14 @@
 namespace toit {
 
 class ObjectNotifier;
+class StringInternTable;
 
 // A class that uses a RAII destructor to free memory already
 // allocated if a later allocation fails.
 class InitialMemoryManager {
  public:
   Chunk* initial_chunk = null;
-  Object** global_variables = null;
+  GlobalVariables* global_variables = null;
   Mutex* heap_mutex = null;
 
   void dont_auto_free() {
@@ -43,6 +45,8 @@ class InitialMemoryManager {
   }
 
   // Allocates initial pages for heap.  Returns success.
+  // Fields that are already set, for example because they have been
+  // recycled from a terminated process, are kept.
   bool allocate();
 
   // Frees any of the fields that are not null.
@@ -51,7 +55,7 @@ class InitialMemoryManager {
 
 class ObjectHeap {
  public:
-  ObjectHeap(Program* program, Process* owner, Chunk* initial_chunk, Object** global_variables, Mutex* mutex);
+  ObjectHeap(Program* program, Process* owner, Chunk* initial_chunk, GlobalVariables* global_variables, Mutex* mutex);
   ~ObjectHeap();
 
   // TODO: In the new heap there need not be a max allocation size.
@@ -83,6 +87,21 @@ class ObjectHeap {
 
   void iterate_finalization_roots(RootCallback* cb);
 
+  // The strings interned by the process, or null if the process doesn't
+  // intern strings.  The message decoders only intern strings when the table
+  // exists, and full GCs merge equal short strings in the old-space.
+  StringInternTable* string_table() const { return interning_strings_ ? string_table_ : null; }
+  // Returns false on allocation failure.
+  bool enable_string_interning();
+  // Empties the table.  The table itself is kept, so other processes can
+  // safely read its size for the process stats.
+  void disable_string_interning();
+  word interned_strings() const;
+  void process_string_table(RootCallback* cb, LivenessOracle* oracle);
+  void deduplicate_strings(OldSpace* old_space, SemiSpace* semi_space);
+  word deduplicated_strings() const { return deduplicated_strings_; }
+  word deduplicated_bytes() const { return deduplicated_bytes_; }
+
   Program* program() const { return program_; }
 
   int64 total_bytes_allocated() const { return total_external_memory_ + two_space_heap_.total_bytes_allocated(); }
@@ -125,7 +144,12 @@ class ObjectHeap {
 
   void print(Printer* printer);
 
-  Object** global_variables() const { return global_variables_; }
+  GlobalVariables* global_variables() const { return global_variables_; }
+  // Hands the heap mutex and the global variables over to the manager, so
+  // they can be used for a new process. The global variables are reset to
+  // their initial values. Must only be called once the owning process has
+  // terminated and is no longer reachable from its process group.
+  void recycle_initial_memory(InitialMemoryManager* manager);
   Task* task() { return task_; }
   void set_task(Task* task) { task_ = task; }
 
@@ -213,10 +237,15 @@ class ObjectHeap {
   // A VM finalizer is on this list.
   FinalizerNodeFifo registered_vm_finalizers_;
 
+  StringInternTable* string_table_ = null;
+  bool interning_strings_ = false;
+  word deduplicated_strings_ = 0;
+  word deduplicated_bytes_ = 0;
+
   int gc_count_ = 0;
   int full_gc_count_ = 0;
   int full_compacting_gc_count_ = 0;
-  Object** global_variables_ = null;
+  GlobalVariables* global_variables_ = null;
 
   HeapRootList external_roots_;
 
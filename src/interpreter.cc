@@ -145,6 +145,21 @@ void Interpreter::prepare_process() {
 #define STACK_AT(n)        ({ int _n_ = n; (*(sp + _n_)); })
 #define STACK_AT_PUT(n, o) ({ int _n_ = n; Object* _o_ = o; *(sp + _n_) = _o_; })
 
+Object** Interpreter::store_global_slow(Object** sp, int global_index, bool* stored) {
+  Process* process = process_;
+  bool success = false;
+  for (int attempts = 1; !success && attempts < 4; attempts++) {
+    sp = gc(sp, true, attempts, false);
+    GlobalVariables* global_variables = process->object_heap()->global_variables();
+    success = global_variables->at_put(global_index, STACK_AT(0));
+  }
+  process->object_heap()->leave_primitive();
+
+  *stored = success;
+  if (success) return sp;
+  return push_error(sp, process->program()->malloc_failed(), "");
+}
+
 Object** Interpreter::push_error(Object** sp, Object* type, const char* message) {
   Process* process = process_;
   PUSH(type);
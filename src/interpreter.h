@@ -168,6 +168,10 @@ class Interpreter {
   Object** push_error(Object** sp, Object* type, const char* message);
   Object** push_out_of_memory_error(Object** sp);
 
+  // Stores the value on top of the stack in a global whose page couldn't be
+  // copied to the process. Pushes an error if it still fails after GCs.
+  Object** store_global_slow(Object** sp, int global_index, bool* stored);
+
   Object* hash_do(Program* program, Object* current, Object* backing, int step, Object* block, Object** entry_return) INTERPRETER_HELPER;
   Object** hash_find(Object** sp, Program* program, HashFindAction* action_return, Method* block_return, Object** result_return) INTERPRETER_HELPER;
 
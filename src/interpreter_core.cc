@@ -122,10 +122,9 @@ bool Interpreter::fast_at(Process* process, Object* receiver, Object* arg, bool
        (!byte_array->has_external_address() ||
         byte_array->external_tag() == RawByteTag ||
         (!is_put && byte_array->external_tag() == MappedFileTag))) {
-    ByteArray::Bytes bytes(byte_array);
-    if (!bytes.is_valid_index(n)) return false;
-
     if (is_put) {
+      ByteArray::Bytes bytes(byte_array);
+      if (!bytes.is_valid_index(n)) return false;
       if (!is_smi(*value)) return false;
 
       uint8 byte_value = (uint8) Smi::value(*value);
@@ -133,6 +132,9 @@ bool Interpreter::fast_at(Process* process, Object* receiver, Object* arg, bool
       (*value) = Smi::from(byte_value);
       return true;
     } else {
+      // Reading doesn't forget what is known about the content.
+      ByteArray::ConstBytes bytes(byte_array);
+      if (!bytes.is_valid_index(n)) return false;
       (*value) = Smi::from(bytes.at(n));
       return true;
     }
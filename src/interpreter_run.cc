@@ -450,8 +450,8 @@ Interpreter::Result Interpreter::run() {
   OPCODE_END();
 
   OPCODE_BEGIN_WITH_WIDE(LOAD_GLOBAL_VAR, global_index);
-    Object** global_variables = process_->object_heap()->global_variables();
-    PUSH(global_variables[global_index]);
+    GlobalVariables* global_variables = process_->object_heap()->global_variables();
+    PUSH(global_variables->at(global_index));
     CHECK_PROPAGATED_TYPES_TOP();
   OPCODE_END();
 
@@ -462,13 +462,13 @@ Interpreter::Result Interpreter::run() {
       Method target = program->program_failure();
       CALL_METHOD(target, LOAD_GLOBAL_VAR_DYNAMIC_LENGTH);
     }
-    Object** global_variables = process_->object_heap()->global_variables();
-    PUSH(global_variables[global_index]);
+    GlobalVariables* global_variables = process_->object_heap()->global_variables();
+    PUSH(global_variables->at(global_index));
   OPCODE_END();
 
   OPCODE_BEGIN_WITH_WIDE(LOAD_GLOBAL_VAR_LAZY, global_index);
-    Object** global_variables = process_->object_heap()->global_variables();
-    Object* value = global_variables[global_index];
+    GlobalVariables* global_variables = process_->object_heap()->global_variables();
+    Object* value = global_variables->at(global_index);
     if (is_instance(value)) {
       Instance* instance = Instance::cast(value);
       if (instance->class_id() == program->lazy_initializer_class_id()) {
@@ -486,20 +486,31 @@ Interpreter::Result Interpreter::run() {
   OPCODE_END();
 
   OPCODE_BEGIN_WITH_WIDE(STORE_GLOBAL_VAR, global_index);
-    Object** global_variables = process_->object_heap()->global_variables();
-    global_variables[global_index] = STACK_AT(0);
+    GlobalVariables* global_variables = process_->object_heap()->global_variables();
+    if (!global_variables->at_put(global_index, STACK_AT(0))) {
+      bool stored;
+      sp = store_global_slow(sp, global_index, &stored);
+      if (!stored) goto THROW_IMPLEMENTATION;
+    }
   OPCODE_END();
 
   OPCODE_BEGIN(STORE_GLOBAL_VAR_DYNAMIC);
-    Object* value = POP();
-    int global_index = Smi::value(POP());
+    int global_index = Smi::value(STACK_AT(1));
     if (!(0 <= global_index && global_index < program->global_variables.length())) {
+      DROP(2);
       PUSH(Smi::from(program->absolute_bci_from_bcp(bcp)));
       Method target = program->program_failure();
       CALL_METHOD(target, STORE_GLOBAL_VAR_DYNAMIC_LENGTH);
     }
-    Object** global_variables = process_->object_heap()->global_variables();
-    global_variables[global_index] = value;
+    GlobalVariables* global_variables = process_->object_heap()->global_variables();
+    if (!global_variables->at_put(global_index, STACK_AT(0))) {
+      // The value stays on the stack while the page of the global is
+      // copied, so it survives a GC.
+      bool stored;
+      sp = store_global_slow(sp, global_index, &stored);
+      if (!stored) goto THROW_IMPLEMENTATION;
+    }
+    DROP(2);
   OPCODE_END();
 
   OPCODE_BEGIN(LOAD_BLOCK);
@@ -759,6 +770,35 @@ Interpreter::Result Interpreter::run() {
     CALL_METHOD(target, INVOKE_VIRTUAL_SET_LENGTH);
   OPCODE_END();
 
+  OPCODE_BEGIN(INVOKE_VIRTUAL_TAIL);
+    B_ARG1(stack_offset);
+    Object* receiver = STACK_AT(stack_offset);
+    int selector_offset = Utils::read_unaligned_uint16(bcp + 2);
+    Method target = program->find_method(receiver, selector_offset);
+    if (!target.is_valid()) {
+      // The lookup failure throws, so it doesn't matter that the frame
+      // isn't reused.
+      PUSH(receiver);
+      PUSH(Smi::from(selector_offset));
+      target = program->lookup_failure();
+      CALL_METHOD(target, INVOKE_VIRTUAL_TAIL_LENGTH);
+    }
+    unsigned height = bcp[4];
+    unsigned outer_arity = bcp[5];
+    unsigned call_arity = stack_offset + 1;
+    // Find bcp.
+    static_assert(FRAME_SIZE == 2, "Unexpected frame size");
+    ASSERT(STACK_AT(height) == program->frame_marker());
+    uint8* return_address = reinterpret_cast<uint8*>(STACK_AT(height + 1));
+
+    int parameter_start = height + FRAME_SIZE + outer_arity;
+    // Move the receiver and the arguments, overwriting the parameters to
+    // the function.
+    STACK_MOVE(parameter_start, call_arity, call_arity);
+    DROP(height + FRAME_SIZE + outer_arity - call_arity);
+    CALL_METHOD_WITH_RETURN_ADDRESS(target, return_address);
+  OPCODE_END();
+
   INVOKE_VIRTUAL_FALLBACK: {
     Object* receiver = POP();
     Method target = program->find_method(receiver, index__);
@@ -1040,6 +1080,28 @@ Interpreter::Result Interpreter::run() {
       PUSH(Smi::from(primitive_index));
       Method target = program->primitive_lookup_failure();
       CALL_METHOD(target, PRIMITIVE_LENGTH);
+    } else if (primitive->is_leaf) {
+      // Leaf primitives never allocate, so there is no need to prepare for
+      // a GC or to retry them.
+      int arity = primitive->arity;
+      Primitive::Entry* entry = reinterpret_cast<Primitive::Entry*>(primitive->function);
+      Object* result = entry(process_, sp + parameter_offset + arity - 1); // Skip the frame.
+      if (Primitive::is_error(result)) {
+        result = Primitive::unmark_from_error(program, result);
+        ASSERT(result != program->malloc_failed() && result != program->allocation_failed());
+        PUSH(result);
+        DISPATCH(PRIMITIVE_LENGTH);
+      }
+      static_assert(FRAME_SIZE == 2, "Unexpected frame size");
+      Object* frame_marker = POP();
+      ASSERT(frame_marker == program->frame_marker());
+      bcp = reinterpret_cast<uint8*>(POP());
+      // Discard arguments in callers frame.
+      DROP(arity);
+      ASSERT(!is_stack_empty());
+      PUSH(result);
+      CHECK_PROPAGATED_TYPES_RETURN();
+      DISPATCH(0);
     } else {
       process_->set_current_bcp(bcp);
       int arity = primitive->arity;
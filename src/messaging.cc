@@ -18,6 +18,7 @@
 #include "objects.h"
 #include "process.h"
 #include "scheduler.h"
+#include "string_intern.h"
 #include "vm.h"
 
 #include "objects_inline.h"
@@ -466,7 +467,7 @@ void MessageDecoder::register_external(HeapObject* object, int length) {
   externals_count_++;
 }
 
-Object* TisonDecoder::decode() {
+bool TisonDecoder::decode_header() {
   ASSERT(decoding_tison());
   uint32 expected = TISON_MARKER | (TISON_VERSION << TISON_VERSION_SHIFT);
   uint32 marker = read_uint32();
@@ -479,16 +480,104 @@ Object* TisonDecoder::decode() {
       printf("[message decoder: wrong tison marker 0x%" PRIx32 " - expected 0x%" PRIx32 "]\n",
           marker, expected);
     }
-    return mark_malformed();
+    mark_malformed();
+    return false;
   }
   int payload_size = read_cardinal();
-  if (payload_size != remaining()) return mark_malformed();
+  if (payload_size != remaining()) {
+    mark_malformed();
+    return false;
+  }
+  return true;
+}
+
+Object* TisonDecoder::decode() {
+  if (!decode_header()) return null;
   Object* result = decode_any();
   if (!success()) return result;
   if (remaining() != 0) return mark_malformed();
   return result;
 }
 
+bool TisonDecoder::decode_chunk(Array* state) {
+  Object* cursor = state->at(STATE_CURSOR_INDEX);
+  Object* depth = state->at(STATE_DEPTH_INDEX);
+  if (!is_smi(cursor) || !is_smi(depth)) {
+    mark_malformed();
+    return false;
+  }
+  int depth_value = Smi::value(depth);
+  if (Smi::value(cursor) == 0) {
+    // Nothing has been decoded yet. Decode the header together with the
+    // outermost object, so a failed allocation makes us start over.
+    if (!decode_header()) return false;
+    Array* elements;
+    Object* result = decode_shallow(&elements);
+    if (!success()) return false;
+    state->at_put(STATE_RESULT_INDEX, result);
+    depth_value = 0;
+    if (elements != null && elements->length() > 0) {
+      state->at_put(STATE_FRAMES_INDEX, elements);
+      state->at_put(STATE_FRAMES_INDEX + 1, Smi::zero());
+      depth_value = 1;
+    }
+    state->at_put(STATE_DEPTH_INDEX, Smi::from(depth_value));
+    state->at_put(STATE_CURSOR_INDEX, Smi::from(this->cursor()));
+  } else {
+    if (depth_value < 0 || depth_value > STATE_MAX_DEPTH) {
+      mark_malformed();
+      return false;
+    }
+    set_cursor(Smi::value(cursor));
+    if (overflown()) {
+      mark_malformed();
+      return false;
+    }
+  }
+
+  int start = this->cursor();
+  int objects = 0;
+  while (depth_value > 0) {
+    if (objects >= CHUNK_MAX_OBJECTS || this->cursor() - start >= CHUNK_MAX_BYTES) {
+      return false;
+    }
+    int frame = STATE_FRAMES_INDEX + (depth_value - 1) * STATE_FRAME_SIZE;
+    if (!is_array(state->at(frame)) || !is_smi(state->at(frame + 1))) {
+      mark_malformed();
+      return false;
+    }
+    Array* array = Array::cast(state->at(frame));
+    int index = Smi::value(state->at(frame + 1));
+    if (index >= array->length()) {
+      state->at_put(frame, Smi::zero());
+      state->at_put(STATE_DEPTH_INDEX, Smi::from(--depth_value));
+      continue;
+    }
+    Array* elements;
+    Object* inner = decode_shallow(&elements);
+    if (!success()) return false;
+    array->at_put(index, inner);
+    state->at_put(frame + 1, Smi::from(index + 1));
+    state->at_put(STATE_CURSOR_INDEX, Smi::from(this->cursor()));
+    objects++;
+    if (elements != null && elements->length() > 0) {
+      if (depth_value == STATE_MAX_DEPTH) {
+        mark_malformed();
+        return false;
+      }
+      frame += STATE_FRAME_SIZE;
+      state->at_put(frame, elements);
+      state->at_put(frame + 1, Smi::zero());
+      state->at_put(STATE_DEPTH_INDEX, Smi::from(++depth_value));
+    }
+  }
+  if (remaining() != 0) {
+    mark_malformed();
+    return false;
+  }
+  return true;
+}
+
 Object* MessageDecoder::decode_any() {
   int tag = read_uint8();
   switch (tag) {
@@ -578,7 +667,13 @@ Object* MessageDecoder::decode_string(bool inlined) {
   if (length == 0 && overflown()) return mark_malformed();
   String* result = null;
   if (inlined) {
-    result = process_->allocate_string(reinterpret_cast<const char*>(&buffer_[cursor_]), length);
+    auto content = reinterpret_cast<const char*>(&buffer_[cursor_]);
+    // Repeated keys like "id" are shared when the process interns strings.
+    if (process_->object_heap()->string_table() != null) {
+      result = process_->allocate_interned_string(content, length);
+    } else {
+      result = process_->allocate_string(content, length);
+    }
     cursor_ += length;
   } else if (decoding_tison()) {
     return mark_malformed();
@@ -591,20 +686,40 @@ Object* MessageDecoder::decode_string(bool inlined) {
   return result;
 }
 
+Object* MessageDecoder::decode_shallow(Array** elements) {
+  *elements = null;
+  int cursor = cursor_;
+  int tag = read_uint8();
+  if (tag == TAG_ARRAY) return allocate_array(elements);
+  if (tag == TAG_MAP) return allocate_map(elements);
+  cursor_ = cursor;
+  return decode_any();
+}
+
 Object* MessageDecoder::decode_array() {
+  Array* elements = null;
+  Object* result = allocate_array(&elements);
+  if (!success()) return result;
+  return decode_elements(result, elements);
+}
+
+Object* MessageDecoder::decode_map() {
+  Array* elements = null;
+  Object* result = allocate_map(&elements);
+  if (!success()) return result;
+  return decode_elements(result, elements);
+}
+
+Object* MessageDecoder::allocate_array(Array** elements) {
   int length = read_cardinal();
   if (length == 0 && overflown()) return mark_malformed();
   Array* result = process_->object_heap()->allocate_array(length, Smi::zero());
   if (result == null) return mark_allocation_failed();
-  for (int i = 0; i < length; i++) {
-    Object* inner = decode_any();
-    if (!success()) return inner;
-    result->at_put(i, inner);
-  }
+  *elements = result;
   return result;
 }
 
-Object* MessageDecoder::decode_map() {
+Object* MessageDecoder::allocate_map(Array** elements) {
   int size = read_cardinal();
   if (size == 0 && overflown()) return mark_malformed();
   Instance* result = process_->object_heap()->allocate_instance(program_->map_class_id());
@@ -618,15 +733,24 @@ Object* MessageDecoder::decode_map() {
   }
   Array* array = process_->object_heap()->allocate_array(size * 2, Smi::zero());
   if (array == null) return mark_allocation_failed();
-  for (int i = 0; i < size * 2; i++) {
-    Object* inner = decode_any();
-    if (!success()) return inner;
-    array->at_put(i, inner);
-  }
+  // The keys and values are filled in afterwards, but the map isn't
+  // reachable from Toit code until all of them have been decoded.
   result->at_put(Instance::MAP_SIZE_INDEX, Smi::from(size));
   result->at_put(Instance::MAP_SPACES_LEFT_INDEX, Smi::from(0));
   result->at_put(Instance::MAP_INDEX_INDEX, program_->null_object());
   result->at_put(Instance::MAP_BACKING_INDEX, array);
+  *elements = array;
+  return result;
+}
+
+Object* MessageDecoder::decode_elements(Object* result, Array* elements) {
+  if (elements == null) return result;
+  int length = elements->length();
+  for (int i = 0; i < length; i++) {
+    Object* inner = decode_any();
+    if (!success()) return inner;
+    elements->at_put(i, inner);
+  }
   return result;
 }
 
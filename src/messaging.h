@@ -62,10 +62,16 @@ class Message : public MessageFIFO::Element {
 
 class SystemMessage : public Message {
  public:
-  // Some system messages that are created from within the VM.
+  // Some system messages that are created from within the VM, or that
+  // the VM keeps track of. Should match the constants in
+  // lib/core/message_.toit.
   enum Type {
     TERMINATED = 0,
     SPAWNED = 1,
+    RPC_REQUEST = 3,
+    RPC_REPLY = 4,
+    RPC_CANCEL = 5,
+    QUOTA_EXCEEDED = 8,
   };
 
   SystemMessage(int type, int gid, int pid, uint8* data);
@@ -284,8 +290,16 @@ class MessageDecoder {
   int remaining() const { return size_ - cursor_; }
   unsigned externals_count() const { return externals_count_; }
 
+  int cursor() const { return cursor_; }
+  void set_cursor(int cursor) { cursor_ = cursor; }
+
   Object* decode_any();
 
+  // Decodes the next object, but leaves the elements of lists and maps
+  // undecoded. For those, the array the elements must be decoded into is
+  // returned in 'elements'. For all other objects 'elements' is set to null.
+  Object* decode_shallow(Array** elements);
+
   Object* mark_malformed() { status_ = DECODE_MALFORMED_INPUT; return null; }
   Object* mark_allocation_failed() { status_ = DECODE_ALLOCATION_FAILED; return null; }
 
@@ -317,6 +331,9 @@ class MessageDecoder {
   Object* decode_string(bool inlined);
   Object* decode_array();
   Object* decode_map();
+  Object* allocate_array(Array** elements);
+  Object* allocate_map(Array** elements);
+  Object* decode_elements(Object* result, Array* elements);
   Object* decode_byte_array(bool inlined);
   Object* decode_double();
   Object* decode_large_integer();
@@ -342,6 +359,32 @@ class TisonDecoder : public MessageDecoder {
   }
 
   Object* decode();
+
+  // Layout of the state array used by $decode_chunk. The frames keep the
+  // arrays that are being filled in and the index of the next element.
+  static const int STATE_CURSOR_INDEX = 0;
+  static const int STATE_DEPTH_INDEX = 1;
+  static const int STATE_RESULT_INDEX = 2;
+  static const int STATE_FRAMES_INDEX = 3;
+  static const int STATE_FRAME_SIZE = 2;
+  static const int STATE_MAX_DEPTH = MESSAGING_ENCODING_MAX_NESTING;
+  static const int STATE_SIZE = STATE_FRAMES_INDEX + STATE_MAX_DEPTH * STATE_FRAME_SIZE;
+
+  // Limits on the work done by a single call to $decode_chunk.
+  static const int CHUNK_MAX_OBJECTS = 1024;
+  static const int CHUNK_MAX_BYTES = 16 * KB;
+
+  // Decodes a chunk of the input and records the progress in the given
+  // state array, so the next call continues where this one stopped. All
+  // partially decoded objects are reachable from the state, so garbage
+  // collections can happen between the calls. If an allocation fails, the
+  // state is left at the last fully decoded object and the call can be
+  // retried. Returns true when all of the input has been decoded and the
+  // result is stored in the state.
+  bool decode_chunk(Array* state);
+
+ private:
+  bool decode_header();
 };
 
 class ExternalSystemMessageHandler : private ProcessRunner {
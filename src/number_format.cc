@@ -0,0 +1,459 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "number_format.h"
+#include "utils.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace toit {
+
+// The shortest digits are computed with Grisu2, as described in "Printing
+// Floating-Point Numbers Quickly and Accurately with Integers" by Florian
+// Loitsch. The digits always read back as the same double, and they are
+// the shortest possible for almost all doubles.
+
+// A floating point number f * 2^e with a 64-bit significand.
+struct DiyFp {
+  uint64 f;
+  int e;
+};
+
+static inline DiyFp diy_sub(DiyFp x, DiyFp y) {
+  ASSERT(x.e == y.e && x.f >= y.f);
+  return { x.f - y.f, x.e };
+}
+
+// The product of two numbers, rounded to 64 bits.
+static inline DiyFp diy_mul(DiyFp x, DiyFp y) {
+  const uint64 mask = 0xffffffffULL;
+  uint64 a = x.f >> 32;
+  uint64 b = x.f & mask;
+  uint64 c = y.f >> 32;
+  uint64 d = y.f & mask;
+  uint64 ac = a * c;
+  uint64 bc = b * c;
+  uint64 ad = a * d;
+  uint64 bd = b * d;
+  uint64 middle = (bd >> 32) + (ad & mask) + (bc & mask);
+  middle += 1ULL << 31;  // Round.
+  return { ac + (ad >> 32) + (bc >> 32) + (middle >> 32), x.e + y.e + 64 };
+}
+
+static inline DiyFp diy_normalize(DiyFp x) {
+  ASSERT(x.f != 0);
+  int shift = Utils::clz(x.f);
+  return { x.f << shift, x.e - shift };
+}
+
+// The cached powers c = 10^k, normalized to a 64-bit significand and
+// rounded. There is one for every 8th decimal exponent.
+struct CachedPower {
+  uint64 f;
+  int e;
+  int k;
+};
+
+static const int CACHED_POWERS_MIN_EXPONENT = -300;
+static const int CACHED_POWERS_STEP = 8;
+
+static const CachedPower CACHED_POWERS[] = {
+  { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+  { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+  { 0xBE5691EF416BD60CULL, -1007, -284 },
+  { 0x8DD01FAD907FFC3CULL,  -980, -276 },
+  { 0xD3515C2831559A83ULL,  -954, -268 },
+  { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+  { 0xEA9C227723EE8BCBULL,  -901, -252 },
+  { 0xAECC49914078536DULL,  -874, -244 },
+  { 0x823C12795DB6CE57ULL,  -847, -236 },
+  { 0xC21094364DFB5637ULL,  -821, -228 },
+  { 0x9096EA6F3848984FULL,  -794, -220 },
+  { 0xD77485CB25823AC7ULL,  -768, -212 },
+  { 0xA086CFCD97BF97F4ULL,  -741, -204 },
+  { 0xEF340A98172AACE5ULL,  -715, -196 },
+  { 0xB23867FB2A35B28EULL,  -688, -188 },
+  { 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+  { 0xC5DD44271AD3CDBAULL,  -635, -172 },
+  { 0x936B9FCEBB25C996ULL,  -608, -164 },
+  { 0xDBAC6C247D62A584ULL,  -582, -156 },
+  { 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+  { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+  { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+  { 0x87625F056C7C4A8BULL,  -475, -124 },
+  { 0xC9BCFF6034C13053ULL,  -449, -116 },
+  { 0x964E858C91BA2655ULL,  -422, -108 },
+  { 0xDFF9772470297EBDULL,  -396, -100 },
+  { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+  { 0xF8A95FCF88747D94ULL,  -343,  -84 },
+  { 0xB94470938FA89BCFULL,  -316,  -76 },
+  { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+  { 0xCDB02555653131B6ULL,  -263,  -60 },
+  { 0x993FE2C6D07B7FACULL,  -236,  -52 },
+  { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+  { 0xAA242499697392D3ULL,  -183,  -36 },
+  { 0xFD87B5F28300CA0EULL,  -157,  -28 },
+  { 0xBCE5086492111AEBULL,  -130,  -20 },
+  { 0x8CBCCC096F5088CCULL,  -103,  -12 },
+  { 0xD1B71758E219652CULL,   -77,   -4 },
+  { 0x9C40000000000000ULL,   -50,    4 },
+  { 0xE8D4A51000000000ULL,   -24,   12 },
+  { 0xAD78EBC5AC620000ULL,     3,   20 },
+  { 0x813F3978F8940984ULL,    30,   28 },
+  { 0xC097CE7BC90715B3ULL,    56,   36 },
+  { 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+  { 0xD5D238A4ABE98068ULL,   109,   52 },
+  { 0x9F4F2726179A2245ULL,   136,   60 },
+  { 0xED63A231D4C4FB27ULL,   162,   68 },
+  { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+  { 0x83C7088E1AAB65DBULL,   216,   84 },
+  { 0xC45D1DF942711D9AULL,   242,   92 },
+  { 0x924D692CA61BE758ULL,   269,  100 },
+  { 0xDA01EE641A708DEAULL,   295,  108 },
+  { 0xA26DA3999AEF774AULL,   322,  116 },
+  { 0xF209787BB47D6B85ULL,   348,  124 },
+  { 0xB454E4A179DD1877ULL,   375,  132 },
+  { 0x865B86925B9BC5C2ULL,   402,  140 },
+  { 0xC83553C5C8965D3DULL,   428,  148 },
+  { 0x952AB45CFA97A0B3ULL,   455,  156 },
+  { 0xDE469FBD99A05FE3ULL,   481,  164 },
+  { 0xA59BC234DB398C25ULL,   508,  172 },
+  { 0xF6C69A72A3989F5CULL,   534,  180 },
+  { 0xB7DCBF5354E9BECEULL,   561,  188 },
+  { 0x88FCF317F22241E2ULL,   588,  196 },
+  { 0xCC20CE9BD35C78A5ULL,   614,  204 },
+  { 0x98165AF37B2153DFULL,   641,  212 },
+  { 0xE2A0B5DC971F303AULL,   667,  220 },
+  { 0xA8D9D1535CE3B396ULL,   694,  228 },
+  { 0xFB9B7CD9A4A7443CULL,   720,  236 },
+  { 0xBB764C4CA7A44410ULL,   747,  244 },
+  { 0x8BAB8EEFB6409C1AULL,   774,  252 },
+  { 0xD01FEF10A657842CULL,   800,  260 },
+  { 0x9B10A4E5E9913129ULL,   827,  268 },
+  { 0xE7109BFBA19C0C9DULL,   853,  276 },
+  { 0xAC2820D9623BF429ULL,   880,  284 },
+  { 0x80444B5E7AA7CF85ULL,   907,  292 },
+  { 0xBF21E44003ACDD2DULL,   933,  300 },
+  { 0x8E679C2F5E44FF8FULL,   960,  308 },
+  { 0xD433179D9C8CB841ULL,   986,  316 },
+  { 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+  { 0xEB96BF6EBADF77D9ULL,  1039,  332 },
+  { 0xAF87023B9BF0EE6BULL,  1066,  340 },
+};
+
+// The range of binary exponents the scaled numbers are brought into, so
+// the integral part of the upper boundary fits in 32 bits.
+static const int ALPHA = -60;
+static const int GAMMA = -32;
+
+// Finds a cached power c, such that ALPHA <= c.e + e + 64 <= GAMMA.
+static const CachedPower& cached_power_for(int e) {
+  int f = ALPHA - e - 1;
+  // Computes ceil(f * log10(2)).
+  int k = (f * 78913) / (1 << 18) + (f > 0);
+  int index = (-CACHED_POWERS_MIN_EXPONENT + k + (CACHED_POWERS_STEP - 1)) / CACHED_POWERS_STEP;
+  ASSERT(0 <= index && index < static_cast<int>(ARRAY_SIZE(CACHED_POWERS)));
+  const CachedPower& cached = CACHED_POWERS[index];
+  ASSERT(ALPHA <= cached.e + e + 64 && cached.e + e + 64 <= GAMMA);
+  return cached;
+}
+
+// Moves the last digit closer to the exact value, as long as it stays
+// within the boundaries.
+static void round_weed(char* digits, int length, uint64 distance, uint64 delta, uint64 rest, uint64 ten_k) {
+  while (rest < distance &&
+         delta - rest >= ten_k &&
+         (rest + ten_k < distance || distance - rest > rest + ten_k - distance)) {
+    digits[length - 1]--;
+    rest += ten_k;
+  }
+}
+
+// Returns the number of decimal digits of the value, and the largest power
+// of ten that isn't larger than the value in *power.
+static int decimal_length(uint32 value, uint32* power) {
+  int length = 1;
+  uint32 p = 1;
+  while (length < 10 && value >= p * 10) {
+    p *= 10;
+    length++;
+  }
+  *power = p;
+  return length;
+}
+
+int NumberFormat::shortest_digits(double value, char* digits, int* exponent) {
+  ASSERT(value > 0 && value <= 1.7976931348623157e+308);
+  const int SIGNIFICAND_SIZE = 52;
+  const uint64 HIDDEN_BIT = 1ULL << SIGNIFICAND_SIZE;
+  const int EXPONENT_BIAS = 1023 + SIGNIFICAND_SIZE;
+
+  uint64 bits = bit_cast<uint64>(value);
+  int biased_exponent = static_cast<int>(bits >> SIGNIFICAND_SIZE);
+  uint64 significand = bits & (HIDDEN_BIT - 1);
+
+  DiyFp v = biased_exponent == 0
+      ? DiyFp { significand, 1 - EXPONENT_BIAS }
+      : DiyFp { significand + HIDDEN_BIT, biased_exponent - EXPONENT_BIAS };
+
+  // The boundaries m- and m+ are halfway to the neighboring doubles. The
+  // lower neighbor is closer when the value is a power of two.
+  bool lower_is_closer = significand == 0 && biased_exponent > 1;
+  DiyFp m_plus = diy_normalize({ 2 * v.f + 1, v.e - 1 });
+  DiyFp m_minus = lower_is_closer
+      ? DiyFp { 4 * v.f - 1, v.e - 2 }
+      : DiyFp { 2 * v.f - 1, v.e - 1 };
+  m_minus = { m_minus.f << (m_minus.e - m_plus.e), m_plus.e };
+  DiyFp w = diy_normalize(v);
+
+  // Scale everything into the range [ALPHA..GAMMA].
+  const CachedPower& cached = cached_power_for(m_plus.e);
+  DiyFp c = { cached.f, cached.e };
+  w = diy_mul(w, c);
+  DiyFp w_minus = diy_mul(m_minus, c);
+  DiyFp w_plus = diy_mul(m_plus, c);
+  // The multiplications are off by at most one unit, so shrink the
+  // boundaries to be on the safe side.
+  w_minus.f++;
+  w_plus.f--;
+  int decimal_exponent = -cached.k;
+
+  uint64 delta = diy_sub(w_plus, w_minus).f;
+  uint64 distance = diy_sub(w_plus, w).f;
+
+  // Split the upper boundary into its integral and fractional parts.
+  DiyFp one = { 1ULL << -w_plus.e, w_plus.e };
+  uint32 integral = static_cast<uint32>(w_plus.f >> -one.e);
+  uint64 fractional = w_plus.f & (one.f - 1);
+  ASSERT(integral > 0);
+
+  int length = 0;
+  uint32 power;
+  int n = decimal_length(integral, &power);
+  while (n > 0) {
+    digits[length++] = static_cast<char>('0' + integral / power);
+    integral %= power;
+    n--;
+    uint64 rest = (static_cast<uint64>(integral) << -one.e) + fractional;
+    if (rest <= delta) {
+      // The digits so far are within the boundaries.
+      *exponent = decimal_exponent + n;
+      round_weed(digits, length, distance, delta, rest, static_cast<uint64>(power) << -one.e);
+      return length;
+    }
+    power /= 10;
+  }
+
+  int m = 0;
+  while (true) {
+    fractional *= 10;
+    delta *= 10;
+    distance *= 10;
+    digits[length++] = static_cast<char>('0' + (fractional >> -one.e));
+    fractional &= one.f - 1;
+    m++;
+    if (fractional <= delta) break;
+  }
+  *exponent = decimal_exponent - m;
+  round_weed(digits, length, distance, delta, fractional, one.f);
+  return length;
+}
+
+int NumberFormat::format_double(double value, char* buffer) {
+  if (isnan(value)) {
+    strcpy(buffer, "nan");
+    return 3;
+  }
+  char* p = buffer;
+  if (signbit(value)) {
+    *p++ = '-';
+    value = -value;
+  }
+  if (isinf(value)) {
+    strcpy(p, "inf");
+    return p - buffer + 3;
+  }
+  if (value == 0) {
+    strcpy(p, "0.0");
+    return p - buffer + 3;
+  }
+
+  char digits[20];
+  int exponent;
+  int length = shortest_digits(value, digits, &exponent);
+  // The position of the decimal point relative to the first digit.
+  int point = length + exponent;
+
+  if (point - 1 < -4 || point - 1 >= 20) {
+    // Scientific notation, like printf, with at least two exponent digits.
+    *p++ = digits[0];
+    if (length > 1) {
+      *p++ = '.';
+      memcpy(p, digits + 1, length - 1);
+      p += length - 1;
+    }
+    int e = point - 1;
+    *p++ = 'e';
+    *p++ = e < 0 ? '-' : '+';
+    if (e < 0) e = -e;
+    if (e >= 100) *p++ = static_cast<char>('0' + e / 100);
+    *p++ = static_cast<char>('0' + (e / 10) % 10);
+    *p++ = static_cast<char>('0' + e % 10);
+  } else if (point <= 0) {
+    *p++ = '0';
+    *p++ = '.';
+    for (int i = point; i < 0; i++) *p++ = '0';
+    memcpy(p, digits, length);
+    p += length;
+  } else if (point < length) {
+    memcpy(p, digits, point);
+    p += point;
+    *p++ = '.';
+    memcpy(p, digits + point, length - point);
+    p += length - point;
+  } else {
+    memcpy(p, digits, length);
+    p += length;
+    for (int i = length; i < point; i++) *p++ = '0';
+    *p++ = '.';
+    *p++ = '0';
+  }
+  *p = '\0';
+  return p - buffer;
+}
+
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+char* NumberFormat::format_decimal_backwards(uint64 value, char* end) {
+  char* p = end;
+  // Work on 32-bit chunks of eight digits, which is faster on 32-bit
+  // platforms.
+  while (value >= 100000000) {
+    uint32 chunk = static_cast<uint32>(value % 100000000);
+    value /= 100000000;
+    for (int i = 0; i < 4; i++) {
+      int pair = (chunk % 100) * 2;
+      chunk /= 100;
+      *--p = DIGIT_PAIRS[pair + 1];
+      *--p = DIGIT_PAIRS[pair];
+    }
+  }
+  uint32 rest = static_cast<uint32>(value);
+  while (rest >= 100) {
+    int pair = (rest % 100) * 2;
+    rest /= 100;
+    *--p = DIGIT_PAIRS[pair + 1];
+    *--p = DIGIT_PAIRS[pair];
+  }
+  if (rest >= 10) {
+    *--p = DIGIT_PAIRS[rest * 2 + 1];
+    *--p = DIGIT_PAIRS[rest * 2];
+  } else {
+    *--p = static_cast<char>('0' + rest);
+  }
+  return p;
+}
+
+// The powers of ten that are exactly representable as doubles.
+static const double EXACT_POWERS_OF_TEN[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static inline bool is_digit(uint8 c) {
+  return '0' <= c && c <= '9';
+}
+
+// Clinger's fast path: when the significand and the power of ten are both
+// exact doubles, a single multiplication or division rounds correctly.
+// This covers most numbers in practice, like the ones found in JSON.
+bool NumberFormat::parse_double_fast(const uint8* from, const uint8* to, double* result) {
+  const uint8* p = from;
+  bool negative = false;
+  if (p < to && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  uint64 significand = 0;
+  int significant_digits = 0;
+  int exponent = 0;
+  bool has_digits = false;
+  for (; p < to && is_digit(*p); p++) {
+    has_digits = true;
+    if (significand == 0 && *p == '0') continue;  // Leading zero.
+    if (significant_digits == 19) return false;
+    significand = significand * 10 + (*p - '0');
+    significant_digits++;
+  }
+  if (p < to && *p == '.') {
+    for (p++; p < to && is_digit(*p); p++) {
+      has_digits = true;
+      exponent--;
+      if (significand == 0 && *p == '0') continue;
+      if (significant_digits == 19) return false;
+      significand = significand * 10 + (*p - '0');
+      significant_digits++;
+    }
+  }
+  if (!has_digits) return false;
+  if (p < to && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool negative_exponent = false;
+    if (p < to && (*p == '-' || *p == '+')) {
+      negative_exponent = *p == '-';
+      p++;
+    }
+    if (p == to) return false;
+    int explicit_exponent = 0;
+    for (; p < to && is_digit(*p); p++) {
+      // Large exponents are left to the slow path.
+      if (explicit_exponent >= 1000) return false;
+      explicit_exponent = explicit_exponent * 10 + (*p - '0');
+    }
+    exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+  }
+  // Anything else, like hex floats, 'inf' or garbage, is for strtod.
+  if (p != to) return false;
+
+  const uint64 MAX_EXACT_INTEGER = 1ULL << 53;
+  const int MAX_EXACT_EXPONENT = ARRAY_SIZE(EXACT_POWERS_OF_TEN) - 1;
+  double value;
+  if (significand == 0) {
+    value = 0.0;
+  } else if (significand > MAX_EXACT_INTEGER) {
+    return false;
+  } else if (0 <= exponent && exponent <= MAX_EXACT_EXPONENT) {
+    value = static_cast<double>(significand) * EXACT_POWERS_OF_TEN[exponent];
+  } else if (-MAX_EXACT_EXPONENT <= exponent && exponent < 0) {
+    value = static_cast<double>(significand) / EXACT_POWERS_OF_TEN[-exponent];
+  } else {
+    return false;
+  }
+  *result = negative ? -value : value;
+  return true;
+}
+
+} // namespace toit
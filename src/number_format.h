@@ -0,0 +1,52 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+
+namespace toit {
+
+class NumberFormat {
+ public:
+  // Large enough for any double formatted by $format_double, including the
+  // terminating '\0'.
+  static const int DOUBLE_BUFFER_SIZE = 32;
+
+  // Formats a double with the fewest digits that read back as the same
+  // value. Uses the layout of printf's "%.20g", so numbers with a decimal
+  // exponent in the range [-5..19] are written without exponent, but
+  // always includes a '.' or an 'e', so the result looks like a double.
+  // Returns the length of the string written to the buffer.
+  static int format_double(double value, char* buffer);
+
+  // Writes the decimal digits of the value backwards, so the last digit
+  // ends up just before $end. Returns a pointer to the first digit.
+  static char* format_decimal_backwards(uint64 value, char* end);
+
+  // Parses the common forms of decimal floating point numbers in the
+  // range [from..to[ without copying them. Returns false if the number
+  // can't be parsed exactly this way, in which case the caller must fall
+  // back to strtod.
+  static bool parse_double_fast(const uint8* from, const uint8* to, double* result);
+
+ private:
+  // Computes the shortest digits of a finite positive double, such that
+  // value == digits * 10^exponent after reading it back. Returns the
+  // number of digits.
+  static int shortest_digits(double value, char* digits, int* exponent);
+};
+
+} // namespace toit
@@ -501,7 +501,10 @@ class ByteArray : public HeapObject {
   // Note that a ByteArray can have two representations.
   class Bytes {
    public:
+    // Creating a mutable view of the content forgets what is known about it,
+    // as the content might change.
     explicit Bytes(ByteArray* array) {
+      array->_clear_content_flags();
       int l = array->raw_length();
       if (l >= 0) {
         address_ = array->content();
@@ -554,6 +557,15 @@ class ByteArray : public HeapObject {
     const uint8* address() { return address_; }
     int length() { return length_; }
 
+    uint8 at(int index) {
+      ASSERT(index >= 0 && index < length());
+      return *(address() + index);
+    }
+
+    bool is_valid_index(int index) {
+      return index >= 0 && index < length();
+    }
+
    private:
     const uint8* address_;
     int length_;
@@ -649,6 +661,20 @@ class ByteArray : public HeapObject {
 
   uint8* neuter(Process* process);
 
+  // Whether the whole content is known to be valid UTF-8.  The flags are
+  // cleared when the content might change.
+  bool is_known_valid_utf_8() const { return (content_flags() & KNOWN_VALID_UTF_8) != 0; }
+  // Whether the whole content is known to be ASCII, which implies that
+  // every range of it is valid UTF-8.
+  bool is_known_ascii() const { return (content_flags() & KNOWN_ASCII) != 0; }
+
+  // Records that the whole content is valid UTF-8.  Must not be called for
+  // byte arrays on the program heap, which may be read-only.
+  void set_known_valid_utf_8(bool is_ascii) {
+    word flags = KNOWN_VALID_UTF_8 | (is_ascii ? KNOWN_ASCII : 0);
+    _word_at_put(LENGTH_OFFSET, _word_at(LENGTH_OFFSET) | flags);
+  }
+
   word external_tag() const {
     ASSERT(has_external_address());
     return _word_at(EXTERNAL_TAG_OFFSET);
@@ -657,7 +683,26 @@ class ByteArray : public HeapObject {
   void do_pointers(PointerCallback* cb);
 
  private:
-  word raw_length() const { return _word_at(LENGTH_OFFSET); }
+  // The length word holds the raw length, shifted left to make room for the
+  // content flags.
+  static const int CONTENT_FLAGS_BITS = 2;
+  static const word CONTENT_FLAGS_MASK = (1 << CONTENT_FLAGS_BITS) - 1;
+  static const word KNOWN_VALID_UTF_8 = 1 << 0;
+  static const word KNOWN_ASCII = 1 << 1;
+
+  // The shift must be arithmetic to keep the sign of external lengths.
+  word raw_length() const { return static_cast<word>(_word_at(LENGTH_OFFSET)) >> CONTENT_FLAGS_BITS; }
+  word content_flags() const { return _word_at(LENGTH_OFFSET) & CONTENT_FLAGS_MASK; }
+
+  void _clear_content_flags() {
+    // Only write if needed, as byte arrays on the program heap may be
+    // read-only, and never have flags.
+    word length_word = _word_at(LENGTH_OFFSET);
+    if ((length_word & CONTENT_FLAGS_MASK) != 0) {
+      _word_at_put(LENGTH_OFFSET, length_word & ~CONTENT_FLAGS_MASK);
+    }
+  }
+
   uint8* content() { return reinterpret_cast<uint8*>(_raw() + _offset_from(0)); }
   const uint8* content() const { return reinterpret_cast<const uint8*>(_raw() + _offset_from(0)); }
 
@@ -688,7 +733,10 @@ class ByteArray : public HeapObject {
     _word_at_put(EXTERNAL_TAG_OFFSET, value);
   }
 
-  void _set_length(int value) { _word_at_put(LENGTH_OFFSET, value); }
+  // Also clears the content flags.
+  void _set_length(int value) {
+    _word_at_put(LENGTH_OFFSET, static_cast<word>(static_cast<uword>(value) << CONTENT_FLAGS_BITS));
+  }
 
   void _set_external_length(int length) { _set_length(-1 - length); }
 
@@ -44,6 +44,12 @@ word ByteArray::max_internal_size_in_program() {
   return ProgramHeap::max_allocation_size() - HEADER_SIZE;
 }
 
+int String::max_length_in_process() {
+  // Strings that do not fit on the heap are allocated externally, so the
+  // only limit is the length field. Leave room for the terminating null.
+  return INT_MAX - 1;
+}
+
 word String::max_internal_size_in_process() {
   word result = ObjectHeap::max_allocation_size() - OVERHEAD;
   return result;
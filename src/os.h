@@ -181,6 +181,18 @@ class OS {
   // Return the number of cores available on the system.
   static int num_cores();
 
+  // Returns the NUMA node of the core the calling thread currently runs
+  // on. Platforms without NUMA support report a single node.
+  static int current_numa_node();
+
+  // Restricts the calling thread to a single core. The cores the process
+  // may use are numbered from zero, and the number wraps around if there
+  // are fewer of them. Returns false if the platform doesn't support it.
+  static bool set_thread_affinity(int core);
+  // Makes the calling thread prefer memory from the given NUMA node for
+  // the pages it touches first. Passing -1 restores the default policy.
+  static void set_thread_numa_node(int node);
+
   static void out_of_memory(const char* reason);
 
   static Mutex* global_mutex() { return global_mutex_; }
@@ -50,6 +50,17 @@ int OS::num_cores() {
   return count;
 }
 
+int OS::current_numa_node() {
+  return 0;
+}
+
+bool OS::set_thread_affinity(int core) {
+  // Darwin only supports affinity hints between threads, not binding a
+  // thread to a core.
+  return false;
+}
+
+void OS::set_thread_numa_node(int node) {}
 
 void OS::free_block(ProgramBlock* block) {
   free_pages(void_cast(block), TOIT_PAGE_SIZE);
@@ -113,6 +113,17 @@ int OS::num_cores() {
   return info.cores;
 }
 
+int OS::current_numa_node() {
+  return 0;
+}
+
+bool OS::set_thread_affinity(int core) {
+  // Threads are pinned to their core when they are spawned.
+  return true;
+}
+
+void OS::set_thread_numa_node(int node) {}
+
 void OS::close(int fd) {
   // Do nothing.
 }
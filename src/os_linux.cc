@@ -23,7 +23,10 @@
 #include "program_memory.h"
 #include <errno.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
 #include <sys/time.h>
 #include <limits.h>
@@ -46,6 +49,45 @@ int OS::num_cores() {
   return get_nprocs();
 }
 
+int OS::current_numa_node() {
+  // There is no glibc wrapper for getcpu in older versions, and we don't
+  // want to depend on libnuma.
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, null) != 0) return 0;
+  return node;
+}
+
+bool OS::set_thread_affinity(int core) {
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return false;
+  int count = CPU_COUNT(&allowed);
+  if (count == 0) return false;
+  int index = core % count;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &allowed)) continue;
+    if (index-- != 0) continue;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+  }
+  return false;
+}
+
+void OS::set_thread_numa_node(int node) {
+  // Values from <linux/mempolicy.h>.
+  static const int MPOL_DEFAULT = 0;
+  static const int MPOL_PREFERRED = 1;
+  static const int MAX_NODES = sizeof(unsigned long) * BYTE_BIT_SIZE;
+  if (node < 0 || node >= MAX_NODES) {
+    syscall(SYS_set_mempolicy, MPOL_DEFAULT, null, 0);
+  } else {
+    unsigned long mask = 1UL << node;
+    syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, MAX_NODES);
+  }
+}
+
 void OS::free_block(ProgramBlock* block) {
   free_pages(void_cast(block), TOIT_PAGE_SIZE);
 }
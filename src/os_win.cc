@@ -383,6 +383,28 @@ int OS::num_cores() {
   return 1;
 }
 
+int OS::current_numa_node() {
+  return 0;
+}
+
+bool OS::set_thread_affinity(int core) {
+  DWORD_PTR process_mask;
+  DWORD_PTR system_mask;
+  if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) return false;
+  int count = Utils::popcount(process_mask);
+  if (count == 0) return false;
+  int index = core % count;
+  for (int cpu = 0; cpu < static_cast<int>(sizeof(DWORD_PTR) * BYTE_BIT_SIZE); cpu++) {
+    DWORD_PTR mask = static_cast<DWORD_PTR>(1) << cpu;
+    if ((process_mask & mask) == 0) continue;
+    if (index-- != 0) continue;
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+  }
+  return false;
+}
+
+void OS::set_thread_numa_node(int node) {}
+
 void* OS::grab_virtual_memory(void* address, uword size) {
   size = Utils::round_up(size, 4096);
   void* result = VirtualAlloc(address, size, MEM_RESERVE, PAGE_NOACCESS);
@@ -72,6 +72,7 @@ namespace toit {
   M(debug,   MODULE_DEBUG)                   \
   M(espnow,  MODULE_ESPNOW)                  \
   M(bignum,  MODULE_BIGNUM)                  \
+  M(regexp,  MODULE_REGEXP)                  \
 
 #define MODULE_CORE(PRIMITIVE)               \
   PRIMITIVE(write_string_on_stdout, 2)       \
@@ -254,6 +255,26 @@ namespace toit {
   PRIMITIVE(firmware_mapping_at, 2)          \
   PRIMITIVE(firmware_mapping_copy, 5)        \
   PRIMITIVE(rtc_user_bytes, 0)               \
+  PRIMITIVE(spawn_pool_size, 1)              \
+  PRIMITIVE(record_pack, 4)                  \
+  PRIMITIVE(record_unpack, 4)                \
+  PRIMITIVE(process_get_deadline, 1)         \
+  PRIMITIVE(process_set_deadline, 2)         \
+  PRIMITIVE(process_set_quota, 3)            \
+  PRIMITIVE(blob_search, 5)                  \
+  PRIMITIVE(blob_search_all, 5)              \
+  PRIMITIVE(string_replace, 6)               \
+  PRIMITIVE(string_rune_offset, 3)           \
+  PRIMITIVE(string_rune_index, 2)            \
+  PRIMITIVE(string_case_map, 2)              \
+  PRIMITIVE(string_normalize, 2)             \
+  PRIMITIVE(string_compare_folded, 2)        \
+  PRIMITIVE(string_intern, 2)                \
+  PRIMITIVE(process_set_string_interning, 1) \
+  PRIMITIVE(interpolate_strings, 1)          \
+  PRIMITIVE(byte_array_consume_to_string, 3) \
+  PRIMITIVE(process_get_effective_priority, 1) \
+  PRIMITIVE(process_get_effective_deadline, 1) \
 
 #define MODULE_TIMER(PRIMITIVE)              \
   PRIMITIVE(init, 0)                         \
@@ -502,6 +523,7 @@ namespace toit {
   PRIMITIVE(base64_decode, 2)                \
   PRIMITIVE(tison_encode, 1)                 \
   PRIMITIVE(tison_decode, 1)                 \
+  PRIMITIVE(tison_decode_chunk, 2)           \
 
 #define MODULE_FONT(PRIMITIVE)               \
   PRIMITIVE(get_font, 2)                     \
@@ -536,6 +558,8 @@ namespace toit {
   PRIMITIVE(writer_write, 4)                 \
   PRIMITIVE(writer_commit, 2)                \
   PRIMITIVE(writer_close, 1)                 \
+  PRIMITIVE(writer_written, 1)               \
+  PRIMITIVE(writer_digest, 1)                \
 
 #define MODULE_GPIO(PRIMITIVE)               \
   PRIMITIVE(init, 0)                         \
@@ -665,6 +689,10 @@ namespace toit {
   PRIMITIVE(zlib_read, 1)                    \
   PRIMITIVE(zlib_close, 1)                   \
   PRIMITIVE(zlib_uninit, 1)                  \
+  PRIMITIVE(delta_encode, 3)                 \
+  PRIMITIVE(delta_patch_start, 1)            \
+  PRIMITIVE(delta_patch_add, 7)              \
+  PRIMITIVE(delta_patch_close, 1)            \
 
 #define MODULE_SUBPROCESS(PRIMITIVE)         \
   PRIMITIVE(init, 0)                         \
@@ -718,18 +746,77 @@ namespace toit {
   PRIMITIVE(binary_operator, 5)              \
   PRIMITIVE(exp_mod, 6)                      \
 
+#define MODULE_REGEXP(PRIMITIVE)             \
+  PRIMITIVE(compile, 3)                      \
+  PRIMITIVE(group_count, 1)                  \
+  PRIMITIVE(group_name, 2)                   \
+  PRIMITIVE(search, 6)                       \
+  PRIMITIVE(close, 1)                        \
+
+// ----------------------------------------------------------------------------
+
+// Leaf primitives never allocate, never fail with an allocation error, never
+// call back into the VM, and don't look at the stack or the current bytecode
+// of the process. They may fail with other errors. The interpreter calls them
+// without the bookkeeping needed for a GC and the allocation retries.
+#define MODULE_CORE_LEAVES(LEAF)             \
+  LEAF(string_length)                        \
+  LEAF(string_raw_at)                        \
+  LEAF(string_hash_code)                     \
+  LEAF(array_length)                         \
+  LEAF(array_at)                             \
+  LEAF(array_at_put)                         \
+  LEAF(compare_to)                           \
+  LEAF(blob_equals)                          \
+  LEAF(blob_search)                          \
+  LEAF(blob_search_all)                      \
+  LEAF(count_leading_zeros)                  \
+  LEAF(popcount)                             \
+  LEAF(smi_less_than)                        \
+  LEAF(smi_less_than_or_equal)               \
+  LEAF(smi_greater_than)                     \
+  LEAF(smi_greater_than_or_equal)            \
+  LEAF(smi_equals)                           \
+  LEAF(float_less_than)                      \
+  LEAF(float_less_than_or_equal)             \
+  LEAF(float_greater_than)                   \
+  LEAF(float_greater_than_or_equal)          \
+  LEAF(float_equals)                         \
+  LEAF(float_sign)                           \
+  LEAF(float_is_nan)                         \
+  LEAF(float_is_finite)                      \
+  LEAF(object_class_id)                      \
+  LEAF(byte_array_is_raw_bytes)              \
+  LEAF(byte_array_length)                    \
+  LEAF(byte_array_at)                        \
+  LEAF(byte_array_at_put)                    \
+  LEAF(word_size)                            \
+
+#define MODULE_NO_LEAVES(LEAF)
+
 // ----------------------------------------------------------------------------
 
 #define MODULE_IMPLEMENTATION_PRIMITIVE(name, arity)                \
   static Object* primitive_##name(Process*, Object**);
+// Refers to the primitive function so misspelled leaves don't compile.
+#define MODULE_IMPLEMENTATION_LEAF(name)                            \
+  (static_cast<void>(primitive_##name), #name),
 #define MODULE_IMPLEMENTATION_ENTRY(name, arity)                    \
-  { (void*) primitive_##name, arity },
-#define MODULE_IMPLEMENTATION(name, entries)                        \
+  { (void*) primitive_##name, arity, Primitive::is_leaf(leaves, #name) },
+#define MODULE_IMPLEMENTATION_WITH_LEAVES(name, entries, leaf_entries) \
   entries(MODULE_IMPLEMENTATION_PRIMITIVE)                          \
-  static const PrimitiveEntry name##_primitive_table[] = {          \
-    entries(MODULE_IMPLEMENTATION_ENTRY)                            \
-  };                                                                \
-  const PrimitiveEntry* name##_primitives_ = name##_primitive_table;
+  namespace name##_primitive_module {                               \
+    static constexpr const char* leaves[] = {                       \
+      leaf_entries(MODULE_IMPLEMENTATION_LEAF)                      \
+      null                                                          \
+    };                                                              \
+    static const PrimitiveEntry table[] = {                         \
+      entries(MODULE_IMPLEMENTATION_ENTRY)                          \
+    };                                                              \
+  }                                                                 \
+  const PrimitiveEntry* name##_primitives_ = name##_primitive_module::table;
+#define MODULE_IMPLEMENTATION(name, entries)                        \
+  MODULE_IMPLEMENTATION_WITH_LEAVES(name, entries, MODULE_NO_LEAVES)
 
 // ----------------------------------------------------------------------------
 
@@ -1008,6 +1095,7 @@ Object* get_absolute_path(Process* process, const wchar_t* pathname, wchar_t* ou
 #define _A_T_Directory(N, name)           MAKE_UNPACKING_MACRO(Directory, N, name)
 #define _A_T_Font(N, name)                MAKE_UNPACKING_MACRO(Font, N, name)
 #define _A_T_ImageOutputStream(N, name)   MAKE_UNPACKING_MACRO(ImageOutputStream, N, name)
+#define _A_T_ImageWriter(N, name)         MAKE_UNPACKING_MACRO(ImageWriter, N, name)
 #define _A_T_I2cCommand(N, name)          MAKE_UNPACKING_MACRO(I2cCommand, N, name)
 #define _A_T_IntResource(N, name)         MAKE_UNPACKING_MACRO(IntResource, N, name)
 #define _A_T_LookupResult(N, name)        MAKE_UNPACKING_MACRO(LookupResult, N, name)
@@ -1029,6 +1117,8 @@ Object* get_absolute_path(Process* process, const wchar_t* pathname, wchar_t* ou
 #define _A_T_Sha(N, name)                 MAKE_UNPACKING_MACRO(Sha, N, name)
 #define _A_T_Adler32(N, name)             MAKE_UNPACKING_MACRO(Adler32, N, name)
 #define _A_T_ZlibRle(N, name)             MAKE_UNPACKING_MACRO(ZlibRle, N, name)
+#define _A_T_DeltaPatcher(N, name)        MAKE_UNPACKING_MACRO(DeltaPatcher, N, name)
+#define _A_T_Regexp(N, name)              MAKE_UNPACKING_MACRO(Regexp, N, name)
 #define _A_T_Zlib(N, name)                MAKE_UNPACKING_MACRO(Zlib, N, name)
 #define _A_T_GpioResource(N, name)        MAKE_UNPACKING_MACRO(GpioResource, N, name)
 #define _A_T_UartResource(N, name)        MAKE_UNPACKING_MACRO(UartResource, N, name)
@@ -1193,6 +1283,7 @@ Object* get_absolute_path(Process* process, const wchar_t* pathname, wchar_t* ou
 struct PrimitiveEntry {
   void* function;
   int arity;
+  bool is_leaf;
 };
 
 class Primitive {
@@ -1208,6 +1299,12 @@ class Primitive {
   static Object* os_error(int error, Process* process);
   static Object* return_not_a_smi(Process* process, Object* value);
 
+  // Whether the primitive with the given name is in the null-terminated list
+  // of leaves. Evaluated at compile time when building the primitive tables.
+  static constexpr bool is_leaf(const char* const* leaves, const char* name) {
+    return *leaves != null && (names_equal(*leaves, name) || is_leaf(leaves + 1, name));
+  }
+
   // Module-specific primitive lookup. May return null if the primitive isn't linked in.
   static const PrimitiveEntry* at(unsigned module, unsigned index) {
     const PrimitiveEntry* table = primitives_[module];
@@ -1226,6 +1323,10 @@ class Primitive {
 
  private:
   static const PrimitiveEntry* primitives_[];
+
+  static constexpr bool names_equal(const char* a, const char* b) {
+    return *a == *b && (*a == '\0' || names_equal(a + 1, b + 1));
+  }
 };
 
 } // namespace toit
@@ -18,13 +18,17 @@
 #include "flags.h"
 #include "heap.h"
 #include "heap_report.h"
+#include "number_format.h"
 #include "objects_inline.h"
 #include "os.h"
 #include "primitive.h"
 #include "process_group.h"
 #include "process.h"
 #include "scheduler.h"
+#include "string_intern.h"
+#include "string_search.h"
 #include "top.h"
+#include "unicode.h"
 #include "vm.h"
 
 #ifdef TOIT_FREERTOS
@@ -66,7 +70,7 @@ typedef __m128i uint128_t;
 
 namespace toit {
 
-MODULE_IMPLEMENTATION(core, MODULE_CORE)
+MODULE_IMPLEMENTATION_WITH_LEAVES(core, MODULE_CORE, MODULE_CORE_LEAVES)
 
 PRIMITIVE(write_string_on_stdout) {
   ARGS(cstring, message, bool, add_newline);
@@ -133,9 +137,6 @@ PRIMITIVE(spawn) {
   ASSERT(method_id != -1);
   Method method(process->program()->bytecodes, method_id);
 
-  InitialMemoryManager initial_memory_manager;
-  if (!initial_memory_manager.allocate()) FAIL(ALLOCATION_FAILED);
-
   unsigned size = 0;
   { MessageEncoder size_encoder(process, null);
     if (!size_encoder.encode(arguments)) {
@@ -154,10 +155,17 @@ PRIMITIVE(spawn) {
     return encoder.create_error_object(process);
   }
 
-  initial_memory_manager.global_variables = process->program()->global_variables.copy();
+  Scheduler* scheduler = VM::current()->scheduler();
+  int parked_pid = scheduler->spawn_parked(process->group(), priority, method, &encoder);
+  if (parked_pid != Scheduler::INVALID_PROCESS_ID) return Smi::from(parked_pid);
+
+  InitialMemoryManager initial_memory_manager;
+  if (!initial_memory_manager.allocate()) FAIL(ALLOCATION_FAILED);
+
+  initial_memory_manager.global_variables = GlobalVariables::create(process->program());
   if (!initial_memory_manager.global_variables) FAIL(MALLOC_FAILED);
 
-  int pid = VM::current()->scheduler()->spawn(
+  int pid = scheduler->spawn(
       process->program(),
       process->group(),
       priority,
@@ -171,6 +179,13 @@ PRIMITIVE(spawn) {
   return Smi::from(pid);
 }
 
+PRIMITIVE(spawn_pool_size) {
+  ARGS(int, size);
+  if (size < 0 || size > ProcessGroup::MAX_SPAWN_POOL_SIZE) FAIL(OUT_OF_RANGE);
+  if (!VM::current()->scheduler()->set_spawn_pool_size(process, size)) FAIL(MALLOC_FAILED);
+  return process->null_object();
+}
+
 PRIMITIVE(get_generic_resource_group) {
   ByteArray* proxy = process->object_heap()->allocate_proxy();
   if (proxy == null) FAIL(ALLOCATION_FAILED);
@@ -207,6 +222,52 @@ PRIMITIVE(process_set_priority) {
   return process->null_object();
 }
 
+PRIMITIVE(process_get_deadline) {
+  ARGS(int, pid);
+  int64 deadline;
+  if (!VM::current()->scheduler()->get_deadline(pid, &deadline)) FAIL(INVALID_ARGUMENT);
+  if (deadline == Process::NO_DEADLINE) return process->null_object();
+  return Primitive::integer(deadline, process);
+}
+
+PRIMITIVE(process_get_effective_priority) {
+  ARGS(int, pid);
+  uint8 priority;
+  int64 deadline;
+  if (!VM::current()->scheduler()->get_effective_priority(pid, &priority, &deadline)) FAIL(INVALID_ARGUMENT);
+  return Smi::from(priority);
+}
+
+PRIMITIVE(process_get_effective_deadline) {
+  ARGS(int, pid);
+  uint8 priority;
+  int64 deadline;
+  if (!VM::current()->scheduler()->get_effective_priority(pid, &priority, &deadline)) FAIL(INVALID_ARGUMENT);
+  if (deadline == Process::NO_DEADLINE) return process->null_object();
+  return Primitive::integer(deadline, process);
+}
+
+PRIMITIVE(process_set_deadline) {
+  ARGS(int, pid, Object, deadline_object);
+  int64 deadline = Process::NO_DEADLINE;
+  if (deadline_object != process->null_object()) {
+    INT64_VALUE_OR_WRONG_TYPE(value, deadline_object);
+    if (value == Process::NO_DEADLINE) FAIL(OUT_OF_RANGE);
+    deadline = value;
+  }
+  bool success = VM::current()->scheduler()->set_deadline(pid, deadline);
+  if (!success) FAIL(INVALID_ARGUMENT);
+  return process->null_object();
+}
+
+PRIMITIVE(process_set_quota) {
+  PRIVILEGED;
+  ARGS(int, gid, int64, cpu_time_us, int64, allocation);
+  bool success = VM::current()->scheduler()->set_quota(gid, cpu_time_us, allocation);
+  if (!success) FAIL(INVALID_ARGUMENT);
+  return process->null_object();
+}
+
 PRIMITIVE(object_class_id) {
   ARGS(Object, arg);
   return is_smi(arg)
@@ -271,19 +332,118 @@ PRIMITIVE(large_integer_greater_than)          LARGE_INTEGER_COMPARE(>)
 PRIMITIVE(large_integer_greater_than_or_equal) LARGE_INTEGER_COMPARE(>=)
 PRIMITIVE(large_integer_equals)                LARGE_INTEGER_COMPARE(==)
 
+static inline bool utf_8_continuation_byte(int c) {
+  return (c & 0xc0) == 0x80;
+}
+
+// Finds the byte array that holds the content of a byte array, a slice, or a
+// copy-on-write byte array.  The content of the object starts at $offset in
+// the returned byte array.  Returns null for all other objects.
+static ByteArray* backing_byte_array(Program* program, Object* object, word* offset) {
+  *offset = 0;
+  while (true) {
+    if (is_byte_array(object)) return ByteArray::cast(object);
+    if (!is_instance(object)) return null;
+    auto instance = Instance::cast(object);
+    if (instance->class_id() == program->byte_array_slice_class_id()) {
+      Object* from = instance->at(Instance::BYTE_ARRAY_SLICE_FROM_INDEX);
+      if (!is_smi(from)) return null;
+      *offset += Smi::value(from);
+      object = instance->at(Instance::BYTE_ARRAY_SLICE_BYTE_ARRAY_INDEX);
+    } else if (instance->class_id() == program->byte_array_cow_class_id()) {
+      object = instance->at(Instance::BYTE_ARRAY_COW_BACKING_INDEX);
+    } else {
+      return null;
+    }
+  }
+}
+
+// Checks whether the range [start..end[ of the given blob is valid UTF-8.
+// Byte arrays remember when their whole content has been validated, so
+// ranges of them can be checked without looking at every byte again.
+static bool is_valid_string_content(Process* process, Object* object, const Blob& bytes, word start, word end) {
+  // An empty range is valid, even where it would cut a character in two.
+  if (start == end) return true;
+  word offset;
+  ByteArray* backing = backing_byte_array(process->program(), object, &offset);
+  if (backing != null &&
+      backing->is_known_valid_utf_8() &&
+      (!backing->has_external_address() || backing->external_tag() == RawByteTag)) {
+    if (backing->is_known_ascii()) return true;
+    // The range is valid if it doesn't cut a character in two.
+    ByteArray::ConstBytes backing_bytes(backing);
+    word from = offset + start;
+    word to = offset + end;
+    ASSERT(to <= backing_bytes.length());
+    if (from < backing_bytes.length() && utf_8_continuation_byte(backing_bytes.address()[from])) return false;
+    if (to < backing_bytes.length() && utf_8_continuation_byte(backing_bytes.address()[to])) return false;
+    return true;
+  }
+  bool is_ascii;
+  if (!Utils::is_valid_utf_8(bytes.address() + start, end - start, &is_ascii)) return false;
+  if (backing != null &&
+      offset + start == 0 &&
+      offset + end == ByteArray::ConstBytes(backing).length() &&
+      !backing->on_program_heap(process)) {
+    backing->set_known_valid_utf_8(is_ascii);
+  }
+  return true;
+}
+
 PRIMITIVE(byte_array_is_valid_string_content) {
   ARGS(Blob, bytes, int, start, int, end);
   if (!(0 <= start && start <= end && end <= bytes.length())) FAIL(OUT_OF_BOUNDS);
-  return BOOL(Utils::is_valid_utf_8(bytes.address() + start, end - start));
+  return BOOL(is_valid_string_content(process, _raw_bytes, bytes, start, end));
 }
 
 PRIMITIVE(byte_array_convert_to_string) {
   ARGS(Blob, bytes, int, start, int, end);
   if (!(0 <= start && start <= end && end <= bytes.length())) FAIL(OUT_OF_BOUNDS);
-  if (!Utils::is_valid_utf_8(bytes.address() + start, end - start)) FAIL(ILLEGAL_UTF_8);
+  if (!is_valid_string_content(process, _raw_bytes, bytes, start, end)) FAIL(ILLEGAL_UTF_8);
   return process->allocate_string_or_error(char_cast(bytes.address()) + start, end - start);
 }
 
+// Like byte_array_convert_to_string, but the caller promises not to use the
+// byte array afterwards.  If the whole content of an external byte array that
+// owns its memory is converted, the string takes over the memory, and the
+// byte array is left empty.  Otherwise the content is copied.
+PRIMITIVE(byte_array_consume_to_string) {
+  ARGS(Blob, bytes, int, start, int, end);
+  if (!(0 <= start && start <= end && end <= bytes.length())) FAIL(OUT_OF_BOUNDS);
+  if (!is_valid_string_content(process, _raw_bytes, bytes, start, end)) FAIL(ILLEGAL_UTF_8);
+  int length = end - start;
+  if (!is_byte_array(_raw_bytes) ||
+      start != 0 ||
+      end != bytes.length() ||
+      length <= String::max_internal_size_in_process()) {
+    return process->allocate_string_or_error(char_cast(bytes.address()) + start, length);
+  }
+  ByteArray* byte_array = ByteArray::cast(_raw_bytes);
+  // Only memory that is freed by the VM finalizer of the byte array is
+  // malloced and registered with the process.  External byte arrays without
+  // one point into program memory, flash or static buffers.
+  if (!byte_array->has_external_address() ||
+      byte_array->external_tag() != RawByteTag ||
+      !byte_array->has_active_finalizer()) {
+    return process->allocate_string_or_error(char_cast(bytes.address()), length);
+  }
+  // External strings are '\0'-terminated, so the memory needs one more byte.
+  uint8* memory = AllocationManager::reallocate(const_cast<uint8*>(bytes.address()), length + 1);
+  if (memory == null) {
+    return process->allocate_string_or_error(char_cast(bytes.address()), length);
+  }
+  byte_array->set_external_address(length, memory);
+  memory[length] = '\0';
+  String* result = process->object_heap()->allocate_external_string(length, memory, true);
+  // If the allocation fails, the byte array still owns the memory, and the
+  // primitive is retried after a GC.
+  if (result == null) FAIL(ALLOCATION_FAILED);
+  byte_array->neuter(process);
+  // The string accounts for the terminating '\0' when it is freed.
+  process->register_external_allocation(length + 1);
+  return result;
+}
+
 PRIMITIVE(blob_index_of) {
   ARGS(Blob, bytes, int, byte, int, from, int, to);
   if (!(0 <= from && from <= to && to <= bytes.length())) FAIL(OUT_OF_BOUNDS);
@@ -329,6 +489,34 @@ PRIMITIVE(blob_index_of) {
 #endif
 }
 
+PRIMITIVE(blob_search) {
+  ARGS(Blob, haystack, Blob, needle, int, from, int, to, bool, last);
+  if (!(0 <= from && from <= to && to <= haystack.length())) FAIL(OUT_OF_BOUNDS);
+  SubstringSearcher searcher(needle.address(), needle.length());
+  word index = last
+      ? searcher.find_last(haystack.address(), from, to)
+      : searcher.find(haystack.address(), from, to);
+  return Smi::from(index);
+}
+
+// Stores the positions of the non-overlapping occurrences of the needle in
+// the given array, and returns the number of positions stored. If the array
+// is full, the search must be continued after the last occurrence.
+PRIMITIVE(blob_search_all) {
+  ARGS(Blob, haystack, Blob, needle, int, from, int, to, Array, positions);
+  if (!(0 <= from && from <= to && to <= haystack.length())) FAIL(OUT_OF_BOUNDS);
+  if (needle.length() == 0) FAIL(INVALID_ARGUMENT);
+  SubstringSearcher searcher(needle.address(), needle.length());
+  int count = 0;
+  while (count < positions->length()) {
+    word index = searcher.find(haystack.address(), from, to);
+    if (index < 0) break;
+    positions->at_put(count++, Smi::from(index));
+    from = index + needle.length();
+  }
+  return Smi::from(count);
+}
+
 static Array* get_array_from_list(Object* object, Process* process) {
   Array* result = null;
   if (is_instance(object)) {
@@ -583,6 +771,242 @@ PRIMITIVE(read_int_little_endian) {
   return Primitive::integer(value, process);
 }
 
+// Record formats are compiled to descriptors by the RecordFormat class in
+// lib/binary.toit. The first byte is the byte order (0 for little-endian, 1 for
+// big-endian), followed by three bytes per field: the format character and the
+// little-endian 16-bit repeat count.
+static const int RECORD_FIELD_SIZE = 3;
+
+static bool record_descriptor_is_valid(Blob descriptor) {
+  return descriptor.length() >= 1 &&
+      descriptor.address()[0] <= 1 &&
+      (descriptor.length() - 1) % RECORD_FIELD_SIZE == 0;
+}
+
+static int record_field_width(uint8 code) {
+  switch (code) {
+    case 'x':
+    case 'b':
+    case 'B':
+    case '?':
+    case 's':
+      return 1;
+    case 'h':
+    case 'H':
+      return 2;
+    case 'i':
+    case 'I':
+    case 'f':
+      return 4;
+    case 'q':
+    case 'Q':
+    case 'd':
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+static void record_put(uint8* dest, int width, bool big_endian, uint64 value) {
+  for (int i = 0; i < width; i++) {
+    dest[big_endian ? width - 1 - i : i] = value;
+    value >>= 8;
+  }
+}
+
+static uint64 record_get(const uint8* source, int width, bool big_endian) {
+  uint64 value = 0;
+  for (int i = 0; i < width; i++) {
+    value = (value << 8) | source[big_endian ? i : width - 1 - i];
+  }
+  return value;
+}
+
+// Returns the array holding the elements of an array or a list.
+static Array* get_record_values(Object* object, Process* process, word* length) {
+  if (is_array(object)) {
+    Array* array = Array::cast(object);
+    *length = array->length();
+    return array;
+  }
+  Array* array = get_array_from_list(object, process);
+  if (array == null) return null;
+  Object* size = Instance::cast(object)->at(1);
+  if (!is_smi(size)) return null;
+  *length = Smi::value(size);
+  return array;
+}
+
+PRIMITIVE(record_pack) {
+  ARGS(Blob, descriptor, MutableBlob, dest, int, offset, Object, values_object);
+  if (!record_descriptor_is_valid(descriptor)) FAIL(INVALID_ARGUMENT);
+  word values_length;
+  Array* values = get_record_values(values_object, process, &values_length);
+  if (values == null) FAIL(WRONG_OBJECT_TYPE);
+  bool big_endian = descriptor.address()[0] == 1;
+  Program* program = process->program();
+  // First pass: validate the values and compute the size, so nothing is
+  // written if the values don't match the format.
+  word size = 0;
+  word value_index = 0;
+  for (int i = 1; i < descriptor.length(); i += RECORD_FIELD_SIZE) {
+    uint8 code = descriptor.address()[i];
+    int count = Utils::read_unaligned_uint16(descriptor.address() + i + 1);
+    int width = record_field_width(code);
+    if (width == 0) FAIL(INVALID_ARGUMENT);
+    size += width * count;
+    if (code == 'x') continue;
+    int value_count = (code == 's') ? 1 : count;
+    if (value_index + value_count > values_length) FAIL(INVALID_ARGUMENT);
+    for (int j = 0; j < value_count; j++) {
+      Object* value = values->at(value_index++);
+      bool ok;
+      switch (code) {
+        case 'f':
+        case 'd':
+          ok = is_double(value) || is_smi(value) || is_large_integer(value);
+          break;
+        case '?':
+          ok = value == process->true_object() || value == process->false_object();
+          break;
+        case 's': {
+          Blob blob;
+          ok = value->byte_content(program, &blob, STRINGS_OR_BYTE_ARRAYS);
+          break;
+        }
+        default:
+          ok = is_smi(value) || is_large_integer(value);
+          break;
+      }
+      if (!ok) FAIL(WRONG_OBJECT_TYPE);
+    }
+  }
+  if (value_index != values_length) FAIL(INVALID_ARGUMENT);
+  if (offset < 0 || offset > dest.length() || size > dest.length() - offset) FAIL(OUT_OF_BOUNDS);
+
+  uint8* cursor = dest.address() + offset;
+  value_index = 0;
+  for (int i = 1; i < descriptor.length(); i += RECORD_FIELD_SIZE) {
+    uint8 code = descriptor.address()[i];
+    int count = Utils::read_unaligned_uint16(descriptor.address() + i + 1);
+    int width = record_field_width(code);
+    if (code == 'x') {
+      memset(cursor, 0, count);
+      cursor += count;
+      continue;
+    }
+    if (code == 's') {
+      Blob blob;
+      values->at(value_index++)->byte_content(program, &blob, STRINGS_OR_BYTE_ARRAYS);
+      int copied = Utils::min(count, blob.length());
+      memcpy(cursor, blob.address(), copied);
+      memset(cursor + copied, 0, count - copied);
+      cursor += count;
+      continue;
+    }
+    for (int j = 0; j < count; j++) {
+      Object* value = values->at(value_index++);
+      uint64 bits;
+      if (code == 'f' || code == 'd') {
+        double d = is_double(value)
+            ? Double::cast(value)->value()
+            : static_cast<double>(is_smi(value) ? Smi::value(value) : LargeInteger::cast(value)->value());
+        if (code == 'f') {
+          float f = d;
+          uint32 raw;
+          memcpy(&raw, &f, sizeof(raw));
+          bits = raw;
+        } else {
+          memcpy(&bits, &d, sizeof(bits));
+        }
+      } else if (code == '?') {
+        bits = (value == process->true_object()) ? 1 : 0;
+      } else {
+        // Integers are truncated to the width of the field, like the
+        // put-uint methods of the byte orders do.
+        bits = is_smi(value) ? Smi::value(value) : LargeInteger::cast(value)->value();
+      }
+      record_put(cursor, width, big_endian, bits);
+      cursor += width;
+    }
+  }
+  return Smi::from(offset + size);
+}
+
+PRIMITIVE(record_unpack) {
+  ARGS(Blob, descriptor, Blob, source, int, offset, Array, result);
+  if (!record_descriptor_is_valid(descriptor)) FAIL(INVALID_ARGUMENT);
+  bool big_endian = descriptor.address()[0] == 1;
+  word size = 0;
+  word value_count = 0;
+  for (int i = 1; i < descriptor.length(); i += RECORD_FIELD_SIZE) {
+    uint8 code = descriptor.address()[i];
+    int count = Utils::read_unaligned_uint16(descriptor.address() + i + 1);
+    int width = record_field_width(code);
+    if (width == 0) FAIL(INVALID_ARGUMENT);
+    size += width * count;
+    if (code != 'x') value_count += (code == 's') ? 1 : count;
+  }
+  if (value_count != result->length()) FAIL(INVALID_ARGUMENT);
+  if (offset < 0 || offset > source.length() || size > source.length() - offset) FAIL(OUT_OF_BOUNDS);
+
+  // If an allocation fails the primitive is retried after a GC. It is safe
+  // to fill in the result again.
+  const uint8* cursor = source.address() + offset;
+  word value_index = 0;
+  for (int i = 1; i < descriptor.length(); i += RECORD_FIELD_SIZE) {
+    uint8 code = descriptor.address()[i];
+    int count = Utils::read_unaligned_uint16(descriptor.address() + i + 1);
+    int width = record_field_width(code);
+    if (code == 'x') {
+      cursor += count;
+      continue;
+    }
+    if (code == 's') {
+      ByteArray* bytes = process->allocate_byte_array(count);
+      if (bytes == null) FAIL(ALLOCATION_FAILED);
+      memcpy(ByteArray::Bytes(bytes).address(), cursor, count);
+      result->at_put(value_index++, bytes);
+      cursor += count;
+      continue;
+    }
+    for (int j = 0; j < count; j++) {
+      uint64 bits = record_get(cursor, width, big_endian);
+      cursor += width;
+      Object* value;
+      switch (code) {
+        case 'b': value = Smi::from(static_cast<int8>(bits)); break;
+        case 'B': value = Smi::from(static_cast<uint8>(bits)); break;
+        case 'h': value = Smi::from(static_cast<int16>(bits)); break;
+        case 'H': value = Smi::from(static_cast<uint16>(bits)); break;
+        case '?': value = BOOL(bits != 0); break;
+        case 'i': value = Primitive::integer(static_cast<int32>(bits), process); break;
+        case 'I': value = Primitive::integer(static_cast<uint32>(bits), process); break;
+        // There are no unsigned 64-bit integers, so 'Q' reads the same bits as 'q'.
+        case 'q':
+        case 'Q': value = Primitive::integer(static_cast<int64>(bits), process); break;
+        case 'f': {
+          uint32 raw = bits;
+          float f;
+          memcpy(&f, &raw, sizeof(f));
+          value = Primitive::allocate_double(f, process);
+          break;
+        }
+        default: {
+          ASSERT(code == 'd');
+          double d;
+          memcpy(&d, &bits, sizeof(d));
+          value = Primitive::allocate_double(d, process);
+          break;
+        }
+      }
+      if (Primitive::is_error(value)) return value;
+      result->at_put(value_index++, value);
+    }
+  }
+  return result;
+}
+
 PRIMITIVE(program_name) {
   if (Flags::program_name == null) return process->null_object();
   return process->allocate_string_or_error(Flags::program_name);
@@ -666,29 +1090,24 @@ PRIMITIVE(smi_mod) {
 static Object* printf_style_integer_to_string(Process* process, int64 value, int base) {
   ASSERT(base == 2 || base == 8 || base == 10 || base == 16);
   char buffer[70];
-  switch (base) {
-    case 2: {
-      char* p = buffer;
-      int first_bit = value == 0 ? 0 : 63 - Utils::clz(value);
-      for (int i = first_bit; i >= 0; i--) {
-        *p++ = '0' + ((value >> i) & 1);
-      }
-      *p++ = '\0';
-      break;
-    }
-    case 8:
-      snprintf(buffer, sizeof(buffer), "%" PRIo64, value);
-      break;
-    case 10:
-      snprintf(buffer, sizeof(buffer), "%" PRId64, value);
-      break;
-    case 16:
-      snprintf(buffer, sizeof(buffer), "%" PRIx64, value);
-      break;
-    default:
-      buffer[0] = '\0';
+  char* p = &buffer[sizeof(buffer)];
+  *--p = '\0';
+  if (base == 10) {
+    // This also works fine for min-int.  The negation has no effect, but the
+    // correct value ends up in the unsigned variable.
+    uint64 magnitude = value < 0 ? -static_cast<uint64>(value) : value;
+    p = NumberFormat::format_decimal_backwards(magnitude, p);
+    if (value < 0) *--p = '-';
+  } else {
+    int shift = Utils::ctz(base);
+    uint64 mask = base - 1;
+    uint64 unsigned_value = value;
+    do {
+      *--p = "0123456789abcdef"[unsigned_value & mask];
+      unsigned_value >>= shift;
+    } while (unsigned_value != 0);
   }
-  return process->allocate_string_or_error(buffer);
+  return process->allocate_string_or_error(p);
 }
 
 PRIMITIVE(int64_to_string) {
@@ -921,26 +1340,29 @@ PRIMITIVE(int_parse) {
 PRIMITIVE(float_parse) {
   ARGS(Blob, input, int, from, int, to);
   if (!(0 <= from && from < to && to <= input.length())) FAIL(OUT_OF_RANGE);
-  const char* from_ptr = char_cast(input.address() + from);
+  const uint8* from_ptr = input.address() + from;
   // strtod removes leading whitespace, but float.parse doesn't accept it.
   if (isspace(*from_ptr)) FAIL(ERROR);
-  bool needs_free = false;
-  char* copied;
-  if (!is_string(_raw_input) || to != input.length()) {  // Strings are null-terminated.
-    // There is no way to tell strtod to stop early.
-    // We have to copy the area we are interested in.
-    copied = reinterpret_cast<char*>(malloc(to - from + 1));
+  double result;
+  if (NumberFormat::parse_double_fast(from_ptr, input.address() + to, &result)) {
+    return Primitive::allocate_double(result, process);
+  }
+  // There is no way to tell strtod to stop early, so we have to copy the
+  // area we are interested in to terminate it.
+  const int STACK_BUFFER_SIZE = 64;
+  char stack_buffer[STACK_BUFFER_SIZE];
+  char* copied = stack_buffer;
+  if (to - from >= STACK_BUFFER_SIZE) {
+    copied = unvoid_cast<char*>(malloc(to - from + 1));
     if (copied == null) FAIL(ALLOCATION_FAILED);
-    memcpy(copied, from_ptr, to - from);
-    copied[to - from] = 0;
-    from_ptr = copied;
-    needs_free = true;
   }
+  memcpy(copied, from_ptr, to - from);
+  copied[to - from] = '\0';
   char* ptr = null;
-  double result = strtod(from_ptr, &ptr);
+  result = strtod(copied, &ptr);
   // Throw exception if conversion failed or strtod did not process the entire string.
   bool succeeded = *ptr == '\0';
-  if (needs_free) free(copied);
+  if (copied != stack_buffer) free(copied);
   if (!succeeded) FAIL(ERROR);
   return Primitive::allocate_double(result, process);
 }
@@ -1288,79 +1710,18 @@ PRIMITIVE(string_compare) {
 
 PRIMITIVE(string_rune_count) {
   ARGS(Blob, bytes)
-  word count = 0;
-  const uword WORD_MASK = WORD_SIZE - 1;
-  const uint8* address = bytes.address();
-  int len = bytes.length();
-  // This algorithm counts the runes in word-sized chunks of UTF-8.
-  // We have to ensure that the memory reads are word aligned to avoid memory
-  // faults.
-  // The first mask will make sure we skip over the bytes we don't need.
-  int skipped_start_bytes = reinterpret_cast<uword>(address) & WORD_MASK;
-  address -= skipped_start_bytes;  // Align the address
-  len += skipped_start_bytes;
-
-#ifdef BUILD_64
-  const uword HIGH_BITS_IN_BYTES = 0x8080808080808080LL;
-#else
-  const uword HIGH_BITS_IN_BYTES = 0x80808080;
-#endif
-
-  // Create a mask that skips the first bytes we shouldn't count.
-  // This code assumes a little-endian architecture.
-  uword mask = HIGH_BITS_IN_BYTES << (skipped_start_bytes * BYTE_BIT_SIZE);
-
-  // Iterate over all word-sized chunks. The mask is updated at the end of the
-  // loop to count the full word-sized chunks of the next iteration.
-  for (word i = 0; i < len; i += WORD_SIZE) {
-    uword w = *reinterpret_cast<const uword*>(address + i);
-    // The high bit in each byte of w should reflect whether we have an ASCII
-    // character or the first byte of a multi-byte sequence.
-    // w & (w << 1) captures the 11 prefix in the high bits of the first
-    // byte of a multibyte sequence.
-    // ~w captures the 0 in the high bit of an ASCII (single-byte) character.
-    w = (w & (w << 1)) | ~w;
-    // The mask removes the other bits, leaving the high bit in each byte.  It
-    // also trims data from before the start of the string in the initial
-    // position, which is handled first.
-    w &= mask;
-#ifdef BUILD_64
-    count += Utils::popcount(w);
-#else
-    // Count the 1's in w, which can only be at the bit positions 7, 15, 23,
-    // and 31.  We could use popcount, but ESP32 does not have an instruction
-    // for that so we can do better, knowing that there are only 4 positions
-    // that can be 1.
-    w += w >> 16;
-    // Now we have a 2-bit count at bit positions 7-8 and 15-16.
-    count += ((w >> 7) + (w >> 15)) & 7;
-#endif
-    // After the first position we look at all bytes in the other positions.
-    mask = HIGH_BITS_IN_BYTES;
-  }
-
-  if ((len & WORD_MASK) != 0) {
-    // We counted too many bytes in the last chunk. Count the extra runes we
-    // caught this way and remove it from the total.
-    uword last_chunk = *reinterpret_cast<const uword*>(address + (len & ~WORD_MASK));
-    int last_chunk_bytes = len & WORD_MASK;
-    // Skip the the 'last_chunk_bytes' as they should be counted, but keep the
-    // mask for the remaining ones.
-    uword end_mask = HIGH_BITS_IN_BYTES << (last_chunk_bytes * BYTE_BIT_SIZE);
-    uword w = last_chunk;
-    w = (w & (w << 1)) | ~w;
-    // Remove them from the total count.
-    count -= Utils::popcount(w & end_mask);
-  }
-
-  return Smi::from(count);
+  return Smi::from(Utils::utf_8_rune_count(bytes.address(), bytes.length()));
 }
 
 PRIMITIVE(smi_to_string_base_10) {
   ARGS(word, receiver);
   char buffer[32];
-  snprintf(buffer, sizeof(buffer), "%zd", receiver);
-  return process->allocate_string_or_error(buffer);
+  char* p = &buffer[sizeof(buffer)];
+  *--p = '\0';
+  uword magnitude = receiver < 0 ? -static_cast<uword>(receiver) : receiver;
+  p = NumberFormat::format_decimal_backwards(magnitude, p);
+  if (receiver < 0) *--p = '-';
+  return process->allocate_string_or_error(p);
 }
 
 // Used for %-based interpolation.  Only understands bases 8 and 16.
@@ -1372,61 +1733,26 @@ PRIMITIVE(printf_style_int64_to_string) {
   return printf_style_integer_to_string(process, receiver, base);
 }
 
-// Safe way to ensure a double print without chopping off characters.
-static char* safe_double_print(const char* format, int precision, double value) {
-  int size = 16;
-  char* buffer = unvoid_cast<char*>(malloc(size));
-  if (buffer == null) return null;
-  while (true) {
-    int required = snprintf(buffer, size, format, precision, value);
-    // snprintf returns either -1 if the output was truncated or the number of chars
-    // needed to store the result.
-    if (required > -1 && required < size) {
-      if (!isfinite(value)) return buffer;
-
-      // Make sure the output looks like a double. It must have `e` or `.` in it.
-      for (int i = 0; i < required; i++) {
-        char c = buffer[i];
-        if (c == 'e' || c == 'E' || c == '.') return buffer;
-      }
-      // Add the `.0`.
-      if (size < required + 3) {
-        buffer = unvoid_cast<char*>(realloc(buffer, required + 3));
-        if (buffer == null) return null;
-      }
-      buffer[required] = '.';
-      buffer[required + 1] = '0';
-      buffer[required + 2] = '\0';
-      return buffer;
-    }
-    free(buffer);
-    // +3 for the potential ".0" and '\0'.
-    size = required < 0 ? size * 2 : required + 1 + 2;
-    buffer = unvoid_cast<char*>(malloc(size));
-    if (buffer == null) return null;
-  }
-}
-
 PRIMITIVE(float_to_string) {
   ARGS(double, receiver, Object, precision);
-  if (isnan(receiver)) return process->allocate_string_or_error("nan");
-  const char* format;
-  word prec = 20;
   if (precision == process->null_object()) {
-    format = "%.*lg";
-  } else {
-    format = "%.*lf";
-    if (is_large_integer(precision)) FAIL(OUT_OF_BOUNDS);
-    if (!is_smi(precision)) FAIL(WRONG_OBJECT_TYPE);
-    prec = Smi::value(precision);
-    if (prec < 0 || prec > 64) FAIL(OUT_OF_BOUNDS);
+    char buffer[NumberFormat::DOUBLE_BUFFER_SIZE];
+    int length = NumberFormat::format_double(receiver, buffer);
+    return process->allocate_string_or_error(buffer, length);
   }
-  char* buffer = safe_double_print(format, prec, receiver);
-  if (buffer == null) FAIL(MALLOC_FAILED);
-  Object* result = process->allocate_string(buffer);
-  free(buffer);
-  if (result == null) FAIL(ALLOCATION_FAILED);
-  return result;
+  if (isnan(receiver)) return process->allocate_string_or_error("nan");
+  if (is_large_integer(precision)) FAIL(OUT_OF_BOUNDS);
+  if (!is_smi(precision)) FAIL(WRONG_OBJECT_TYPE);
+  word prec = Smi::value(precision);
+  if (prec < 0 || prec > 64) FAIL(OUT_OF_BOUNDS);
+  // Large enough for the sign, the 309 integral digits of the largest
+  // double, the point, 64 fractional digits, and the ".0" added below.
+  char buffer[384];
+  int length = snprintf(buffer, sizeof(buffer) - 2, "%.*lf", static_cast<int>(prec), receiver);
+  ASSERT(0 < length && length < static_cast<int>(sizeof(buffer)) - 2);
+  // Make sure the output looks like a double.
+  if (isfinite(receiver) && prec == 0) strcpy(buffer + length, ".0");
+  return process->allocate_string_or_error(buffer);
 }
 
 PRIMITIVE(float_sign) {
@@ -1527,10 +1853,6 @@ PRIMITIVE(string_add) {
   return result;
 }
 
-static inline bool utf_8_continuation_byte(int c) {
-  return (c & 0xc0) == 0x80;
-}
-
 PRIMITIVE(string_slice) {
   ARGS(String, receiver, int, from, int, to);
   String::Bytes bytes(receiver);
@@ -1565,6 +1887,146 @@ PRIMITIVE(string_slice) {
   return result;
 }
 
+// Replaces the first, or all, occurrences of the needle that are fully
+// contained in the range, building the result in a single allocation.
+PRIMITIVE(string_replace) {
+  ARGS(StringOrSlice, receiver, StringOrSlice, needle, StringOrSlice, replacement, int, from, int, to, bool, all);
+  if (!(0 <= from && from <= to && to <= receiver.length())) FAIL(OUT_OF_BOUNDS);
+  if (all && needle.length() == 0) FAIL(INVALID_ARGUMENT);
+  SubstringSearcher searcher(needle.address(), needle.length());
+  // Remember the first occurrences, so only strings with many of them need
+  // to be searched twice.
+  const int CACHED_POSITIONS = 64;
+  word positions[CACHED_POSITIONS];
+  word count = 0;
+  word position = from;
+  while (true) {
+    word index = searcher.find(receiver.address(), position, to);
+    if (index < 0) break;
+    if (count < CACHED_POSITIONS) positions[count] = index;
+    count++;
+    if (!all) break;
+    position = index + needle.length();
+  }
+  if (count == 0) return _raw_receiver;
+
+  int64 result_length = receiver.length() + count * static_cast<int64>(replacement.length() - needle.length());
+  if (result_length > INT_MAX) FAIL(OUT_OF_RANGE);
+  String* result = process->allocate_string(static_cast<int>(result_length));
+  if (result == null) FAIL(ALLOCATION_FAILED);
+  String::MutableBytes bytes(result);
+  uint8* destination = bytes.address();
+  word source = 0;
+  for (word i = 0; i < count; i++) {
+    word index = i < CACHED_POSITIONS
+        ? positions[i]
+        : searcher.find(receiver.address(), source, to);
+    ASSERT(index >= source);
+    memcpy(destination, receiver.address() + source, index - source);
+    destination += index - source;
+    memcpy(destination, replacement.address(), replacement.length());
+    destination += replacement.length();
+    source = index + needle.length();
+  }
+  memcpy(destination, receiver.address() + source, receiver.length() - source);
+  return result;
+}
+
+// Returns the byte offset of the rune that is $runes runes after the one
+// that starts at byte offset $from.
+PRIMITIVE(string_rune_offset) {
+  ARGS(StringOrSlice, receiver, int, from, int, runes);
+  if (from < 0 || from > receiver.length() || runes < 0) FAIL(OUT_OF_BOUNDS);
+  word offset = Utils::utf_8_skip_runes(receiver.address(), receiver.length(), from, runes);
+  if (offset < 0) FAIL(OUT_OF_BOUNDS);
+  return Smi::from(offset);
+}
+
+// Returns the byte offsets of every $stride'th rune, as 32-bit little-endian
+// values.  Any rune can then be found by skipping fewer than $stride runes
+// from one of them.
+PRIMITIVE(string_rune_index) {
+  ARGS(StringOrSlice, receiver, int, stride);
+  if (stride <= 0) FAIL(INVALID_ARGUMENT);
+  word entries = Utils::utf_8_rune_count(receiver.address(), receiver.length()) / stride + 1;
+  ByteArray* result = process->allocate_byte_array(entries * sizeof(uint32));
+  if (result == null) FAIL(ALLOCATION_FAILED);
+  ByteArray::Bytes bytes(result);
+  word offset = 0;
+  for (word i = 0; i < entries; i++) {
+    Utils::write_unaligned_uint32_le(bytes.address() + i * sizeof(uint32), offset);
+    if (i + 1 < entries) offset = Utils::utf_8_skip_runes(receiver.address(), receiver.length(), offset, stride);
+  }
+  return result;
+}
+
+PRIMITIVE(string_case_map) {
+  ARGS(StringOrSlice, receiver, int, mapping);
+  if (mapping < Unicode::UPPER_CASE || mapping > Unicode::FOLDED_CASE) FAIL(INVALID_ARGUMENT);
+  Unicode::Case mapping_case = static_cast<Unicode::Case>(mapping);
+  bool changed;
+  word length = Unicode::map_case(mapping_case, receiver.address(), receiver.length(), null, &changed);
+  if (!changed) return _raw_receiver;
+  if (length > INT_MAX) FAIL(OUT_OF_RANGE);
+  String* result = process->allocate_string(length);
+  if (result == null) FAIL(ALLOCATION_FAILED);
+  String::MutableBytes bytes(result);
+  Unicode::map_case(mapping_case, receiver.address(), receiver.length(), bytes.address());
+  return result;
+}
+
+PRIMITIVE(string_normalize) {
+  ARGS(StringOrSlice, receiver, bool, compose);
+  bool changed;
+  word length = Unicode::normalize(compose, receiver.address(), receiver.length(), null, &changed);
+  if (length < 0) FAIL(MALLOC_FAILED);
+  if (!changed) return _raw_receiver;
+  if (length > INT_MAX) FAIL(OUT_OF_RANGE);
+  String* result = process->allocate_string(length);
+  if (result == null) FAIL(ALLOCATION_FAILED);
+  String::MutableBytes bytes(result);
+  if (Unicode::normalize(compose, receiver.address(), receiver.length(), bytes.address()) < 0) FAIL(MALLOC_FAILED);
+  return result;
+}
+
+PRIMITIVE(string_compare_folded) {
+  ARGS(StringOrSlice, receiver, StringOrSlice, other);
+  return Smi::from(Unicode::compare_folded(receiver.address(), receiver.length(),
+                                           other.address(), other.length()));
+}
+
+PRIMITIVE(string_intern) {
+  ARGS(StringOrSlice, receiver, bool, create);
+  ObjectHeap* heap = process->object_heap();
+  if (heap->string_table() == null) {
+    if (!create) return _raw_receiver;
+    if (!heap->enable_string_interning()) FAIL(MALLOC_FAILED);
+  }
+  StringInternTable* table = heap->string_table();
+  if (!StringInternTable::is_candidate(receiver.length())) return _raw_receiver;
+  String* result = table->lookup(receiver.address(), receiver.length());
+  if (result != null) return result;
+  if (is_string(_raw_receiver)) {
+    // Intern the receiver itself, instead of a copy.
+    table->add(String::cast(_raw_receiver));
+    return _raw_receiver;
+  }
+  result = process->allocate_interned_string(char_cast(receiver.address()), receiver.length());
+  if (result == null) FAIL(ALLOCATION_FAILED);
+  return result;
+}
+
+PRIMITIVE(process_set_string_interning) {
+  ARGS(bool, enabled);
+  ObjectHeap* heap = process->object_heap();
+  if (!enabled) {
+    heap->disable_string_interning();
+  } else if (!heap->enable_string_interning()) {
+    FAIL(MALLOC_FAILED);
+  }
+  return process->null_object();
+}
+
 PRIMITIVE(concat_strings) {
   ARGS(Array, array);
   Program* program = process->program();
@@ -1592,6 +2054,85 @@ PRIMITIVE(concat_strings) {
   return result;
 }
 
+// Large enough for the decimal digits of any 64-bit integer, and for any
+// double formatted by NumberFormat::format_double.
+static const int INTERPOLATION_BUFFER_SIZE = NumberFormat::DOUBLE_BUFFER_SIZE;
+
+// Finds the text an entry of an interpolation contributes, if the VM knows
+// how the entry is stringified.  Strings are used as they are.  Numbers,
+// booleans and null are formatted into the buffer, exactly like their
+// stringify methods would do.  None of these classes can be subclassed, so
+// there is no user-defined stringify to respect.
+// Returns false for all other objects.
+static bool interpolation_entry(Process* process, Object* entry,
+                                char* buffer, const uint8** address, int* length) {
+  Program* program = process->program();
+  if (is_smi(entry) || is_large_integer(entry)) {
+    int64 value = is_smi(entry) ? Smi::value(entry) : LargeInteger::cast(entry)->value();
+    char* end = &buffer[INTERPOLATION_BUFFER_SIZE];
+    uint64 magnitude = value < 0 ? -static_cast<uint64>(value) : value;
+    char* p = NumberFormat::format_decimal_backwards(magnitude, end);
+    if (value < 0) *--p = '-';
+    *address = unsigned_cast(p);
+    *length = end - p;
+    return true;
+  }
+  if (is_double(entry)) {
+    *length = NumberFormat::format_double(Double::cast(entry)->value(), buffer);
+    *address = unsigned_cast(buffer);
+    return true;
+  }
+  const char* text = null;
+  if (entry == process->null_object()) {
+    text = "null";
+  } else if (entry == process->true_object()) {
+    text = "true";
+  } else if (entry == process->false_object()) {
+    text = "false";
+  }
+  if (text != null) {
+    *address = unsigned_cast(text);
+    *length = strlen(text);
+    return true;
+  }
+  if (!is_validated_string(program, entry)) return false;
+  Blob blob;
+  HeapObject::cast(entry)->byte_content(program, &blob, STRINGS_ONLY);
+  *address = blob.address();
+  *length = blob.length();
+  return true;
+}
+
+// Builds the result of a string interpolation in one allocation.  The
+// entries are formatted twice, once to compute the size, and once to copy
+// them into the result, so no intermediate strings are created.
+PRIMITIVE(interpolate_strings) {
+  ARGS(Array, array);
+  char buffer[INTERPOLATION_BUFFER_SIZE];
+  word length = 0;
+  for (int index = 0; index < array->length(); index++) {
+    const uint8* address;
+    int entry_length;
+    if (!interpolation_entry(process, array->at(index), buffer, &address, &entry_length)) {
+      FAIL(WRONG_OBJECT_TYPE);
+    }
+    length += entry_length;
+  }
+  if (length > String::max_length_in_process()) FAIL(OUT_OF_RANGE);
+  String* result = process->allocate_string(length);
+  if (result == null) FAIL(ALLOCATION_FAILED);
+  String::MutableBytes bytes(result);
+  int pos = 0;
+  for (int index = 0; index < array->length(); index++) {
+    const uint8* address;
+    int entry_length;
+    interpolation_entry(process, array->at(index), buffer, &address, &entry_length);
+    bytes._initialize(pos, address, 0, entry_length);
+    pos += entry_length;
+  }
+  return result;
+}
+
 PRIMITIVE(string_at) {
   ARGS(StringOrSlice, receiver, int, index);
   if (index < 0 || index >= receiver.length()) FAIL(OUT_OF_BOUNDS);
@@ -1764,7 +2305,7 @@ PRIMITIVE(byte_array_is_raw_bytes) {
 PRIMITIVE(byte_array_length) {
   ARGS(ByteArray, receiver);
   if (!receiver->has_external_address() || receiver->external_tag() == RawByteTag || receiver->external_tag() == MappedFileTag) {
-    return Smi::from(ByteArray::Bytes(receiver).length());
+    return Smi::from(ByteArray::ConstBytes(receiver).length());
   }
   FAIL(WRONG_OBJECT_TYPE);
 }
@@ -1772,7 +2313,7 @@ PRIMITIVE(byte_array_length) {
 PRIMITIVE(byte_array_at) {
   ARGS(ByteArray, receiver, int, index);
   if (!receiver->has_external_address() || receiver->external_tag() == RawByteTag || receiver->external_tag() == MappedFileTag) {
-    ByteArray::Bytes bytes(receiver);
+    ByteArray::ConstBytes bytes(receiver);
     if (!bytes.is_valid_index(index)) FAIL(OUT_OF_BOUNDS);
     return Smi::from(bytes.at(index));
   }
@@ -1946,10 +2487,40 @@ PRIMITIVE(process_send) {
   SystemMessage* message = _new SystemMessage(type, process->group()->id(), process->id(), &encoder);
   if (message == null) FAIL(MALLOC_FAILED);
 
+  Scheduler* scheduler = VM::current()->scheduler();
+  // RPC messages are lists that start with the request id. Requests are
+  // tracked before they are sent, so the reply can't overtake them.
+  Array* rpc = null;
+  word rpc_length = 0;
+  if (type == SystemMessage::RPC_REQUEST || type == SystemMessage::RPC_REPLY || type == SystemMessage::RPC_CANCEL) {
+    rpc = get_array_from_list(array, process);
+    if (rpc) rpc_length = Smi::value(Instance::cast(array)->at(Instance::LIST_SIZE_INDEX));
+  }
+  if (rpc_length > 0 && is_smi(rpc->at(0))) {
+    int id = Smi::value(rpc->at(0));
+    if (type == SystemMessage::RPC_REQUEST) {
+      // The caller may send its deadline after the request arguments.
+      int64 deadline = Process::NO_DEADLINE;
+      if (rpc_length > 3) {
+        Object* raw = rpc->at(3);
+        if (is_smi(raw)) {
+          deadline = Smi::value(raw);
+        } else if (is_large_integer(raw)) {
+          deadline = LargeInteger::cast(raw)->value();
+        }
+      }
+      scheduler->rpc_request(process, process_id, id, deadline);
+    } else if (type == SystemMessage::RPC_REPLY) {
+      scheduler->rpc_reply(process, process_id, id);
+    } else {
+      scheduler->rpc_cancel(process, process_id, id);
+    }
+  }
+
   // One of the calls below takes over the SystemMessage.
   scheduler_err_t result = (process_id >= 0)
-      ? VM::current()->scheduler()->send_message(process_id, message)
-      : VM::current()->scheduler()->send_system_message(message);
+      ? scheduler->send_message(process_id, message)
+      : scheduler->send_system_message(message);
   return BOOL(result == MESSAGE_OK);
 }
 
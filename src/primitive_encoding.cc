@@ -170,4 +170,14 @@ PRIMITIVE(tison_decode) {
   return decoded;
 }
 
+PRIMITIVE(tison_decode_chunk) {
+  ARGS(Blob, bytes, Array, state);
+  if (state->length() != TisonDecoder::STATE_SIZE) FAIL(INVALID_ARGUMENT);
+  TisonDecoder decoder(process, bytes.address(), bytes.length());
+  bool done = decoder.decode_chunk(state);
+  if (decoder.allocation_failed()) FAIL(ALLOCATION_FAILED);
+  if (decoder.malformed_input()) FAIL(WRONG_OBJECT_TYPE);
+  return BOOL(done);
+}
+
 }
@@ -63,7 +63,7 @@ PRIMITIVE(spawn) {
   if (!process_group) FAIL(MALLOC_FAILED);
   AllocationManager free_process_group(process, process_group);
 
-  initial_memory_manager.global_variables = program->global_variables.copy();
+  initial_memory_manager.global_variables = GlobalVariables::create(program);
   if (!initial_memory_manager.global_variables) FAIL(MALLOC_FAILED);
 
   // Takes over the encoder and the initial_memory_manager.
@@ -0,0 +1,102 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "top.h"
+
+#include "process.h"
+#include "objects.h"
+#include "objects_inline.h"
+#include "primitive.h"
+#include "regexp.h"
+
+namespace toit {
+
+MODULE_IMPLEMENTATION(regexp, MODULE_REGEXP)
+
+PRIMITIVE(compile) {
+  ARGS(SimpleResourceGroup, group, Blob, pattern, int, flags);
+  ByteArray* proxy = process->object_heap()->allocate_proxy();
+  if (proxy == null) FAIL(ALLOCATION_FAILED);
+  Regexp* regexp = _new Regexp(group);
+  if (!regexp) FAIL(MALLOC_FAILED);
+  word position;
+  Regexp::Error error = regexp->compile(pattern.address(), pattern.length(), flags, &position);
+  if (error != Regexp::OK) {
+    regexp->resource_group()->unregister_resource(regexp);
+    if (error == Regexp::MALLOC_FAILED) FAIL(MALLOC_FAILED);
+    // Syntax errors are returned as an integer with the reason in the low
+    // bits and the position in the pattern in the rest.
+    return Smi::from(error | (position << 4));
+  }
+  proxy->set_external_address(regexp);
+  return proxy;
+}
+
+PRIMITIVE(group_count) {
+  ARGS(Regexp, regexp);
+  return Smi::from(regexp->group_count());
+}
+
+PRIMITIVE(group_name) {
+  ARGS(Regexp, regexp, int, group);
+  if (group < 0 || group >= regexp->group_count()) FAIL(OUT_OF_RANGE);
+  word length;
+  const uint8* name = regexp->group_name(group, &length);
+  if (name == null) return process->null_object();
+  String* result = process->allocate_string(char_cast(name), length);
+  if (result == null) FAIL(ALLOCATION_FAILED);
+  return result;
+}
+
+// Finds the next match at or after the given position, and writes the
+// start and end of each group into the captures, followed by the position
+// where the search for the next match should continue. Like most engines,
+// an empty match right after the previous match is skipped, so find-all
+// makes progress and doesn't report a match twice.
+PRIMITIVE(search) {
+  ARGS(Regexp, regexp, Blob, subject, int, from, int, previous_end, int, flags, Array, captures);
+  int slots = regexp->group_count() * 2;
+  if (captures->length() <= slots) FAIL(INVALID_ARGUMENT);
+  if (from < 0 || from > subject.length()) FAIL(OUT_OF_RANGE);
+  word position = from;
+  word next;
+  while (true) {
+    if (!regexp->search(subject.address(), subject.length(), position, flags)) return BOOL(false);
+    word start = regexp->capture(0);
+    word end = regexp->capture(1);
+    if (start != end) {
+      next = end;
+      break;
+    }
+    next = end + Regexp::character_width(subject.address(), subject.length(), end);
+    if (start != previous_end) break;
+    if (next > subject.length()) return BOOL(false);
+    position = next;
+  }
+  for (int i = 0; i < slots; i++) {
+    captures->at_put(i, Smi::from(regexp->capture(i)));
+  }
+  captures->at_put(slots, Smi::from(next));
+  return BOOL(true);
+}
+
+PRIMITIVE(close) {
+  ARGS(Regexp, regexp);
+  regexp->resource_group()->unregister_resource(regexp);
+  regexp_proxy->clear_external_address();
+  return process->null_object();
+}
+
+}
@@ -26,6 +26,7 @@
 #include "objects_inline.h"
 #include "primitive.h"
 #include "nano_zlib.h"
+#include "delta.h"
 
 namespace toit {
 
@@ -303,4 +304,51 @@ PRIMITIVE(zlib_uninit) {
 #endif
 }
 
+PRIMITIVE(delta_encode) {
+  ARGS(Blob, source, Blob, target, int, block_size);
+  if (block_size < 4 || block_size > 0x10000) FAIL(OUT_OF_RANGE);
+  DeltaEncoder encoder(source.address(), source.length(), target.address(), target.length(), block_size);
+  if (!encoder.encode()) FAIL(MALLOC_FAILED);
+  ByteArray* result = process->allocate_byte_array(encoder.delta_length());
+  if (result == null) FAIL(ALLOCATION_FAILED);
+  memcpy(ByteArray::Bytes(result).address(), encoder.delta(), encoder.delta_length());
+  return result;
+}
+
+PRIMITIVE(delta_patch_start) {
+  ARGS(SimpleResourceGroup, group);
+  ByteArray* proxy = process->object_heap()->allocate_proxy();
+  if (proxy == null) FAIL(ALLOCATION_FAILED);
+  DeltaPatcher* patcher = _new DeltaPatcher(group);
+  if (!patcher) FAIL(MALLOC_FAILED);
+  proxy->set_external_address(patcher);
+  return proxy;
+}
+
+PRIMITIVE(delta_patch_add) {
+  ARGS(DeltaPatcher, patcher, Blob, source, MutableBlob, destination_bytes, int, index, Blob, data, int, from, int, to);
+  if (from < 0 || to > data.length() || from > to) FAIL(OUT_OF_RANGE);
+  if (index < 0 || index > destination_bytes.length()) FAIL(OUT_OF_RANGE);
+  // Like rle_add, we return the distances packed in 15 bit fields, so we
+  // limit the sizes we attempt.
+  word destination_length = Utils::min<word>(index + 0x7000, destination_bytes.length());
+  to = Utils::min(to, from + 0x7000);
+  word read = 0;
+  word written = 0;
+  bool success = patcher->patch(source.address(), source.length(),
+                                data.address() + from, to - from, &read,
+                                destination_bytes.address() + index, destination_length - index, &written);
+  if (!success) FAIL(INVALID_ARGUMENT);
+  ASSERT(read < 0x8000 && written < 0x8000 && read >= 0 && written >= 0);
+  return Smi::from(read | (written << 15));
+}
+
+PRIMITIVE(delta_patch_close) {
+  ARGS(DeltaPatcher, patcher);
+  bool done = patcher->is_done();
+  patcher->resource_group()->unregister_resource(patcher);
+  patcher_proxy->clear_external_address();
+  return BOOL(done);
+}
+
 }
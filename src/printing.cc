@@ -169,6 +169,11 @@ void print_bytecode(Printer* printer, uint8* bcp, int bci) {
       printer->printf(" S%u O%u", index, offset);
       break;
     }
+    case OP_BS_SO_BS_BU: {
+      int offset = Utils::read_unaligned_uint16(bcp + 2);
+      printer->printf(" S%u O%u S%u %u", index, offset, bcp[4], bcp[5]);
+      break;
+    }
     case OP_BU_SO: {
       int offset = Utils::read_unaligned_uint16(bcp + 2);
       printer->printf(" %u O%u", bcp[1], offset);
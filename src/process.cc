@@ -14,6 +14,7 @@
 // directory of this repository.
 
 #include "entropy_mixer.h"
+#include "flags.h"
 #include "heap.h"
 #include "heap_report.h"
 #include "interpreter.h"
@@ -23,6 +24,7 @@
 #include "process_group.h"
 #include "resource.h"
 #include "scheduler.h"
+#include "string_intern.h"
 #include "vm.h"
 
 namespace toit {
@@ -56,7 +58,8 @@ Process::Process(Program* program, ProcessRunner* runner, ProcessGroup* group, S
     , random_state1_(2)
     , signals_(0)
     , state_(IDLE)
-    , scheduler_thread_(null) {
+    , scheduler_thread_(null)
+    , numa_node_(Flags::numa ? OS::current_numa_node() : -1) {
   if (initial_memory) initial_memory->dont_auto_free();
   // We can't start a process from a heap that has not been linearly allocated
   // because we use the address range to distinguish program pointers and
@@ -246,6 +249,18 @@ Object* Process::allocate_string_or_error(const char* content, int length) {
   return result;
 }
 
+String* Process::allocate_interned_string(const char* content, int length) {
+  StringInternTable* table = object_heap()->string_table();
+  ASSERT(table != null);
+  auto bytes = reinterpret_cast<const uint8*>(content);
+  String* result = table->lookup(bytes, length);
+  if (result != null) return result;
+  result = allocate_string(content, length);
+  // If the table can't grow we just don't intern the string.
+  if (result != null && StringInternTable::is_candidate(length)) table->add(result);
+  return result;
+}
+
 String* Process::allocate_string(const char* content) {
   return allocate_string(content, strlen(content));
 }
@@ -382,9 +397,79 @@ void Process::clear_signal(Signal signal) {
 }
 
 uint8 Process::update_priority() {
-  uint8 priority = target_priority_;
-  priority_ = priority;
-  return priority;
+  compute_priority(&priority_, &deadline_);
+  return priority_;
+}
+
+bool Process::has_priority_update() const {
+  uint8 priority;
+  int64 deadline;
+  compute_priority(&priority, &deadline);
+  return priority != priority_ || deadline != deadline_;
+}
+
+void Process::compute_priority(uint8* priority, int64* deadline) const {
+  // Processes in a group that has used up its quota only run when there
+  // is nothing else to do, unless they serve more important processes.
+  uint8 result_priority = group_->is_throttled() ? PRIORITY_IDLE : target_priority_;
+  int64 result_deadline = target_deadline_;
+  for (int i = 0; i < inherited_count_; i++) {
+    const InheritedPriority& entry = inherited_[i];
+    if (entry.priority > result_priority) result_priority = entry.priority;
+    if (entry.deadline < result_deadline) result_deadline = entry.deadline;
+  }
+  *priority = result_priority;
+  *deadline = result_deadline;
+}
+
+bool Process::inherit_priority(int pid, int id, uint8 priority, int64 deadline) {
+  InheritedPriority* entry = null;
+  if (inherited_count_ < MAX_INHERITED_PRIORITIES) {
+    entry = &inherited_[inherited_count_++];
+  } else {
+    // All entries are in use, so we replace the least important one if the
+    // new request is more important. The replaced request is served with
+    // the priority the process would otherwise have.
+    entry = &inherited_[0];
+    for (int i = 1; i < MAX_INHERITED_PRIORITIES; i++) {
+      InheritedPriority* candidate = &inherited_[i];
+      if (candidate->priority < entry->priority ||
+          (candidate->priority == entry->priority && candidate->deadline > entry->deadline)) {
+        entry = candidate;
+      }
+    }
+    if (priority < entry->priority ||
+        (priority == entry->priority && deadline >= entry->deadline)) {
+      return false;
+    }
+  }
+  entry->pid = pid;
+  entry->id = id;
+  entry->priority = priority;
+  entry->deadline = deadline;
+  return true;
+}
+
+bool Process::release_inherited_priority(int pid, int id) {
+  for (int i = 0; i < inherited_count_; i++) {
+    if (inherited_[i].pid != pid || inherited_[i].id != id) continue;
+    inherited_[i] = inherited_[--inherited_count_];
+    return true;
+  }
+  return false;
+}
+
+bool Process::release_inherited_priorities(int pid) {
+  bool released = false;
+  for (int i = 0; i < inherited_count_; ) {
+    if (inherited_[i].pid == pid) {
+      inherited_[i] = inherited_[--inherited_count_];
+      released = true;
+    } else {
+      i++;
+    }
+  }
+  return released;
 }
 
 #if defined(TOIT_WINDOWS)
@@ -78,6 +78,14 @@ class Process : public ProcessListFromProcessGroup::Element,
   static const uint8 PRIORITY_HIGH     = 213;
   static const uint8 PRIORITY_CRITICAL = 255;
 
+  // Deadlines are monotonic timestamps in microseconds. Processes without
+  // a deadline sort after all processes with one.
+  static const int64 NO_DEADLINE = INT64_MAX;
+
+  // The number of RPC requests a process can inherit a priority from at
+  // the same time.
+  static const int MAX_INHERITED_PRIORITIES = 4;
+
   static const char* StateName[];
 
   // Constructor for an internal process based on Toit code.
@@ -92,6 +100,7 @@ class Process : public ProcessListFromProcessGroup::Element,
   // Construction support.
   void set_main_arguments(uint8* arguments);
   void set_spawn_arguments(uint8* arguments);
+  void set_spawn_method(Method method) { spawn_method_ = method; }
 #ifndef TOIT_FREERTOS
   void set_main_arguments(char** argv);
   void set_spawn_arguments(SnapshotBundle system, SnapshotBundle application);
@@ -154,6 +163,18 @@ class Process : public ProcessListFromProcessGroup::Element,
     scheduler_thread_ = scheduler_thread;
   }
 
+  // The NUMA node the process last ran on, or -1 if the scheduler
+  // doesn't keep track of nodes. The heap of the process grows into
+  // memory on that node.
+  int numa_node() const { return numa_node_; }
+  void set_numa_node(int node) {
+    if (node != numa_node_ && numa_node_ >= 0 && node >= 0) numa_migrations_++;
+    numa_node_ = node;
+  }
+  int numa_migrations() const { return numa_migrations_; }
+  bool numa_passed_over() const { return numa_passed_over_; }
+  void set_numa_passed_over(bool value) { numa_passed_over_ = value; }
+
   void signal(Signal signal);
   void clear_signal(Signal signal);
   uint32 signals() const { return signals_; }
@@ -169,9 +190,33 @@ class Process : public ProcessListFromProcessGroup::Element,
   // again. Once a process is ready to run, the scheduler will
   // update the priority and make the target priority the current
   // priority.
+  uint8 target_priority() const { return target_priority_; }
   void set_target_priority(uint8 value) { target_priority_ = value; }
   uint8 update_priority();
 
+  // Processes in the same ready queue run in the order of their deadlines.
+  // Like the priority, the deadline a process is queued with is only
+  // updated by the scheduler when the process is ready to run.
+  int64 deadline() const { return deadline_; }
+  int64 target_deadline() const { return target_deadline_; }
+  void set_target_deadline(int64 value) { target_deadline_ = value; }
+
+  // While a process serves RPC requests it runs with at least the priority
+  // and at most the deadline of the callers, so a less important service
+  // doesn't hold up more important callers. The requests are identified by
+  // the caller's process id and the request id.
+  bool inherit_priority(int pid, int id, uint8 priority, int64 deadline);
+  bool release_inherited_priority(int pid, int id);
+  bool release_inherited_priorities(int pid);
+
+  // Computes the priority and the deadline the process runs with the next
+  // time it is ready to run.
+  void compute_priority(uint8* priority, int64* deadline) const;
+
+  // Returns whether the next call to update_priority changes the priority
+  // or the deadline.
+  bool has_priority_update() const;
+
   // TODO(mikkel): current_directory could be a union with an int and a char*. The clients of this member would know
   //               which field to access.
 #if defined(TOIT_WINDOWS)
@@ -188,6 +233,11 @@ class Process : public ProcessListFromProcessGroup::Element,
   String* allocate_string(const char* content, int length);
   Object* allocate_string_or_error(const char* content);
   Object* allocate_string_or_error(const char* content, int length);
+  // Returns the interned string with the given content.  Allocates and
+  // interns it if there is none yet, or if the content is too long to be
+  // interned.  The process must intern strings.  Returns null on allocation
+  // failure.
+  String* allocate_interned_string(const char* content, int length);
 #if defined(TOIT_WINDOWS)
   String* allocate_string(const wchar_t* content);
   String* allocate_string(const wchar_t* content, word length);
@@ -217,6 +267,21 @@ class Process : public ProcessListFromProcessGroup::Element,
     object_heap_.unregister_external_allocation(size);
   }
 
+  // The CPU time the process has used in the time slices it has
+  // finished.
+  int64 cpu_time_us() const { return cpu_time_us_; }
+  void add_cpu_time(int64 us) { cpu_time_us_ += us; }
+
+  // Returns the bytes allocated since the scheduler last accounted
+  // for them. Unlike bytes_allocated_delta, this isn't affected by
+  // the process asking for its own allocations.
+  int64 take_allocation_delta() {
+    int64 current = object_heap()->total_bytes_allocated();
+    int64 result = current - accounted_bytes_allocated_;
+    accounted_bytes_allocated_ = current;
+    return result;
+  }
+
   int64 bytes_allocated_delta() {
     int64 current = object_heap()->total_bytes_allocated();
     int64 result = current - last_bytes_allocated_;
@@ -306,6 +371,17 @@ class Process : public ProcessListFromProcessGroup::Element,
 
   uint8 priority_ = PRIORITY_NORMAL;
   uint8 target_priority_ = PRIORITY_NORMAL;
+  int64 deadline_ = NO_DEADLINE;
+  int64 target_deadline_ = NO_DEADLINE;
+
+  struct InheritedPriority {
+    int pid;
+    int id;
+    int64 deadline;
+    uint8 priority;
+  };
+  InheritedPriority inherited_[MAX_INHERITED_PRIORITIES];
+  int inherited_count_ = 0;
 
   uword program_heap_address_;
   uword program_heap_size_;
@@ -319,6 +395,8 @@ class Process : public ProcessListFromProcessGroup::Element,
 
   ObjectHeap object_heap_;
   int64 last_bytes_allocated_;
+  int64 accounted_bytes_allocated_ = 0;
+  int64 cpu_time_us_ = 0;
 
   MessageFIFO messages_;
 
@@ -338,6 +416,10 @@ class Process : public ProcessListFromProcessGroup::Element,
   State state_;
   SchedulerThread* scheduler_thread_;
 
+  int numa_node_;
+  int numa_migrations_ = 0;
+  bool numa_passed_over_ = false;
+
   bool construction_failed_ = false;
   bool idle_since_gc_ = true;
 
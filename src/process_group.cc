@@ -29,6 +29,9 @@ ProcessGroup::ProcessGroup(int id, Program* program, AlignedMemoryBase* memory)
     , memory_(memory) {}
 
 ProcessGroup::~ProcessGroup() {
+  // Parked processes refer to the program, so the scheduler deletes them
+  // first.
+  ASSERT(parked_.is_empty());
   delete memory_;
 }
 
@@ -58,4 +61,18 @@ bool ProcessGroup::remove(Process* process) {
   return !processes_.is_empty();
 }
 
+void ProcessGroup::park(Process* process) {
+  ASSERT(VM::current()->scheduler()->is_locked());
+  ASSERT(process->group() == this);
+  parked_.prepend(process);
+  parked_count_++;
+}
+
+Process* ProcessGroup::unpark() {
+  ASSERT(VM::current()->scheduler()->is_locked());
+  Process* process = parked_.remove_first();
+  if (process != null) parked_count_--;
+  return process;
+}
+
 } // namespace toit
@@ -45,6 +45,34 @@ class ProcessGroup : public ProcessGroupList::Element {
 
   ProcessListFromProcessGroup& processes() { return processes_; }
 
+  // Parked processes have been set up for the program of the group, but
+  // haven't been started yet. They are not part of the group until they
+  // are taken out of the pool by spawning them.
+  int spawn_pool_size() const { return spawn_pool_size_; }
+  void set_spawn_pool_size(int size) { spawn_pool_size_ = size; }
+  bool needs_parked_process() const { return parked_count_ < spawn_pool_size_; }
+  int parked_count() const { return parked_count_; }
+  void park(Process* process);
+  // Returns null if there are no parked processes.
+  Process* unpark();
+
+  static const int MAX_SPAWN_POOL_SIZE = 64;
+
+  // The CPU time and the allocations of all processes in the group,
+  // including the ones that have terminated. Processes are accounted
+  // for at the end of each time slice.
+  int64 cpu_time_us() const { return cpu_time_us_; }
+  int64 bytes_allocated() const { return bytes_allocated_; }
+
+  // Quotas limit the CPU time and the allocations of the group per
+  // quota period. Negative quotas don't limit anything. A group that
+  // exceeds one of its quotas is throttled until the period ends.
+  bool has_quota() const { return cpu_quota_us_ >= 0 || allocation_quota_ >= 0; }
+  int64 cpu_quota_us() const { return cpu_quota_us_; }
+  int64 allocation_quota() const { return allocation_quota_; }
+  int64 period_cpu_time_us() const { return period_cpu_time_us_; }
+  bool is_throttled() const { return throttled_; }
+
  private:
   const int id_;
   Program* const program_;
@@ -55,6 +83,20 @@ class ProcessGroup : public ProcessGroupList::Element {
 
   ProcessListFromProcessGroup processes_;
 
+  ProcessListFromProcessGroup parked_;
+  int parked_count_ = 0;
+  int spawn_pool_size_ = 0;
+
+  int64 cpu_time_us_ = 0;
+  int64 bytes_allocated_ = 0;
+
+  int64 cpu_quota_us_ = -1;
+  int64 allocation_quota_ = -1;
+  int64 period_start_ = 0;
+  int64 period_cpu_time_us_ = 0;
+  int64 period_bytes_allocated_ = 0;
+  bool throttled_ = false;
+
   ProcessGroup(int id, Program* program, AlignedMemoryBase* memory);
 
   friend class Scheduler;
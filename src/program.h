@@ -262,13 +262,6 @@ class Program : public FlashAllocation {
       callback->c_address(reinterpret_cast<void**>(&array_));
     }
 
-    Object** copy() {
-      Object** copy = unvoid_cast<Object**>(malloc(sizeof(Object*) * length()));
-      if (copy == null) return copy;
-      memcpy(copy, raw_array(), sizeof(Object*) * length());
-      return copy;
-    }
-
    private:
     T* array_;
     int length_;
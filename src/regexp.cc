@@ -0,0 +1,1260 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "regexp.h"
+#include "string_search.h"
+#include "utils.h"
+
+#include <string.h>
+
+namespace toit {
+
+static const int MAX_CHARACTER = 0x10ffff;
+static const int REPLACEMENT_CHARACTER = 0xfffd;
+
+// Limits that keep the memory needed by a compiled program reasonable.
+static const int MAX_PROGRAM_LENGTH = 10000;
+static const int MAX_REPETITION = 1000;
+static const int MAX_GROUPS = 500;
+static const int MAX_NESTING = 100;
+static const int MAX_NAME_LENGTH = 64;
+static const int MAX_PREFIX_LENGTH = 64;
+
+enum RegexpOpcode {
+  MATCH_CHARACTER,  // Matches a character in the range [x..y].
+  MATCH_CLASS,      // Matches a character in one of the y ranges starting at x.
+  MATCH_ANY,
+  MATCH_ANY_EXCEPT_NEWLINE,
+  SPLIT,            // Continues at x, then at y with lower priority.
+  JUMP,             // Continues at x.
+  SAVE,             // Records the position in slot x.
+  CHECK_ASSERTION,  // Checks the assertion x without consuming input.
+  MATCH,
+};
+
+enum Assertion {
+  BEGIN_TEXT,
+  END_TEXT,
+  BEGIN_LINE,
+  END_LINE,
+  WORD_BOUNDARY,
+  NOT_WORD_BOUNDARY,
+};
+
+struct Regexp::Instruction {
+  int32 opcode;
+  int32 x;
+  int32 y;
+};
+
+struct Regexp::ThreadList {
+  // A sparse set of program counters, in priority order, with the slots of
+  // the thread at each of them.
+  int* sparse;
+  int* dense;
+  word* slots;
+  int size;
+
+  bool contains(int pc) const {
+    int index = sparse[pc];
+    return index < size && dense[index] == pc;
+  }
+
+  int insert(int pc) {
+    sparse[pc] = size;
+    dense[size] = pc;
+    return size++;
+  }
+};
+
+// Decodes the character at the position, which must be in the subject.
+// Invalid UTF-8 is decoded a byte at a time, as the replacement character.
+static inline int decode_character(const uint8* subject, word length, word position, int* width) {
+  int c = subject[position];
+  *width = 1;
+  if (c <= Utils::MAX_ASCII) return c;
+  int n;
+  int minimum;
+  if ((c & 0xe0) == 0xc0) {
+    n = 2;
+    minimum = 0x80;
+    c &= 0x1f;
+  } else if ((c & 0xf0) == 0xe0) {
+    n = 3;
+    minimum = 0x800;
+    c &= 0x0f;
+  } else if ((c & 0xf8) == 0xf0) {
+    n = 4;
+    minimum = 0x10000;
+    c &= 0x07;
+  } else {
+    return REPLACEMENT_CHARACTER;
+  }
+  if (position + n > length) return REPLACEMENT_CHARACTER;
+  for (int i = 1; i < n; i++) {
+    int b = subject[position + i];
+    if ((b & 0xc0) != Utils::UTF_8_PAYLOAD) return REPLACEMENT_CHARACTER;
+    c = (c << Utils::UTF_8_BITS_PER_BYTE) | (b & Utils::UTF_8_MASK);
+  }
+  if (c < minimum || c > MAX_CHARACTER) return REPLACEMENT_CHARACTER;
+  if (Utils::MIN_SURROGATE <= c && c <= Utils::MAX_SURROGATE) return REPLACEMENT_CHARACTER;
+  *width = n;
+  return c;
+}
+
+static int encode_character(int c, uint8* buffer) {
+  if (c <= Utils::MAX_ASCII) {
+    buffer[0] = c;
+    return 1;
+  }
+  int n = c < 0x800 ? 2 : (c < 0x10000 ? 3 : 4);
+  for (int i = n - 1; i > 0; i--) {
+    buffer[i] = Utils::UTF_8_PAYLOAD | (c & Utils::UTF_8_MASK);
+    c >>= Utils::UTF_8_BITS_PER_BYTE;
+  }
+  buffer[0] = (0xf00 >> n) | c;
+  return n;
+}
+
+static inline bool is_word_character(int c) {
+  return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '_';
+}
+
+template<typename T>
+static bool ensure_capacity(T** array, int* capacity, int needed) {
+  if (needed <= *capacity) return true;
+  int new_capacity = Utils::max(needed, *capacity * 2 + 8);
+  T* grown = unvoid_cast<T*>(realloc(*array, new_capacity * sizeof(T)));
+  if (grown == null) return false;
+  *array = grown;
+  *capacity = new_capacity;
+  return true;
+}
+
+// Parses a pattern into a syntax tree and compiles the tree into a program.
+class RegexpCompiler {
+ public:
+  RegexpCompiler(const uint8* pattern, word length, int flags)
+      : pattern_(pattern)
+      , length_(length)
+      , flags_(flags) {}
+
+  ~RegexpCompiler() {
+    free(nodes_);
+    free(ranges_);
+    free(names_);
+    free(program_);
+  }
+
+  Regexp::Error compile();
+
+  word error_position() const { return error_position_; }
+
+  // Transfer the results to the regexp.
+  Regexp::Instruction* take_program(int* length) {
+    *length = program_length_;
+    Regexp::Instruction* result = program_;
+    program_ = null;
+    return result;
+  }
+  int32* take_ranges() {
+    int32* result = ranges_;
+    ranges_ = null;
+    return result;
+  }
+  uint8* take_names(word* length) {
+    *length = names_length_;
+    uint8* result = names_;
+    names_ = null;
+    return result;
+  }
+  int group_count() const { return group_count_; }
+  bool is_anchored() const;
+  int literal_prefix(uint8* buffer);
+
+ private:
+  enum NodeType {
+    EMPTY,
+    RANGES,
+    ANY_CHARACTER,
+    ANY_CHARACTER_EXCEPT_NEWLINE,
+    ASSERTION,
+    CONCATENATION,
+    ALTERNATION,
+    REPETITION,
+    CAPTURE,
+  };
+
+  struct Node {
+    NodeType type;
+    // Children are linked through their siblings.
+    int first_child;
+    int last_child;
+    int next_sibling;
+    // For RANGES the index of the first pair and the number of pairs. For
+    // REPETITION the bounds, with y == -1 for no upper bound. For CAPTURE
+    // the group, and for ASSERTION the kind.
+    int x;
+    int y;
+    bool greedy;
+  };
+
+  const uint8* const pattern_;
+  const word length_;
+  word position_ = 0;
+  int flags_;
+  int depth_ = 0;
+
+  Node* nodes_ = null;
+  int node_count_ = 0;
+  int node_capacity_ = 0;
+
+  // Pairs of first and last character.
+  int32* ranges_ = null;
+  int range_count_ = 0;
+  int range_capacity_ = 0;
+
+  uint8* names_ = null;
+  int names_length_ = 0;
+  int names_capacity_ = 0;
+
+  int group_count_ = 1;
+  int root_ = -1;
+
+  Regexp::Instruction* program_ = null;
+  int program_length_ = 0;
+  int program_capacity_ = 0;
+
+  Regexp::Error error_ = Regexp::OK;
+  word error_position_ = 0;
+
+  int fail(Regexp::Error error) {
+    if (error_ == Regexp::OK) {
+      error_ = error;
+      error_position_ = position_;
+    }
+    return -1;
+  }
+
+  bool at_end() const { return position_ >= length_; }
+  int peek() const { return at_end() ? -1 : pattern_[position_]; }
+  bool accept(int c) {
+    if (peek() != c) return false;
+    position_++;
+    return true;
+  }
+  int next_character() {
+    int width;
+    int c = decode_character(pattern_, length_, position_, &width);
+    position_ += width;
+    return c;
+  }
+
+  int new_node(NodeType type, int x = 0, int y = 0);
+  void add_child(int parent, int child);
+  int add_range(int first, int last);
+
+  int parse_alternation();
+  int parse_concatenation();
+  int parse_atom();
+  int parse_group();
+  int parse_class();
+  int parse_repetition(int atom);
+  bool parse_bounds(int* min, int* max);
+  bool parse_number(int* result);
+  int parse_escape();
+  int parse_class_escape(int* c);
+  int parse_hex();
+  int add_perl_class(int c);
+  int literal(int c);
+  void normalize_ranges(int start, bool negate);
+
+  bool emit_node(int node);
+  int emit(int opcode, int x = 0, int y = 0);
+  void patch_chain(int head, bool patch_x, int target);
+
+  int literal_prefix(int node, uint8* buffer, int* length, bool* complete);
+};
+
+int RegexpCompiler::new_node(NodeType type, int x, int y) {
+  if (!ensure_capacity(&nodes_, &node_capacity_, node_count_ + 1)) return fail(Regexp::MALLOC_FAILED);
+  Node* node = &nodes_[node_count_];
+  node->type = type;
+  node->first_child = -1;
+  node->last_child = -1;
+  node->next_sibling = -1;
+  node->x = x;
+  node->y = y;
+  node->greedy = true;
+  return node_count_++;
+}
+
+void RegexpCompiler::add_child(int parent, int child) {
+  Node* node = &nodes_[parent];
+  if (node->last_child < 0) {
+    node->first_child = child;
+  } else {
+    nodes_[node->last_child].next_sibling = child;
+  }
+  node->last_child = child;
+}
+
+int RegexpCompiler::add_range(int first, int last) {
+  if (!ensure_capacity(&ranges_, &range_capacity_, range_count_ * 2 + 2)) return fail(Regexp::MALLOC_FAILED);
+  ranges_[range_count_ * 2] = first;
+  ranges_[range_count_ * 2 + 1] = last;
+  range_count_++;
+  return 0;
+}
+
+Regexp::Error RegexpCompiler::compile() {
+  root_ = parse_alternation();
+  if (root_ >= 0 && !at_end()) {
+    // Only a ')' stops the top level parser early.
+    root_ = fail(Regexp::UNEXPECTED_PARENTHESIS);
+  }
+  if (root_ < 0) return error_;
+  // The whole match is group 0.
+  if (emit(SAVE, 0) < 0 ||
+      !emit_node(root_) ||
+      emit(SAVE, 1) < 0 ||
+      emit(MATCH) < 0) {
+    return error_;
+  }
+  return Regexp::OK;
+}
+
+int RegexpCompiler::parse_alternation() {
+  if (++depth_ > MAX_NESTING) return fail(Regexp::TOO_BIG);
+  int first = parse_concatenation();
+  if (first < 0 || peek() != '|') {
+    depth_--;
+    return first;
+  }
+  int alternation = new_node(ALTERNATION);
+  if (alternation < 0) return -1;
+  add_child(alternation, first);
+  while (accept('|')) {
+    int branch = parse_concatenation();
+    if (branch < 0) return -1;
+    add_child(alternation, branch);
+  }
+  depth_--;
+  return alternation;
+}
+
+int RegexpCompiler::parse_concatenation() {
+  int concatenation = new_node(CONCATENATION);
+  if (concatenation < 0) return -1;
+  while (!at_end() && peek() != '|' && peek() != ')') {
+    int atom = parse_atom();
+    if (atom < 0) {
+      if (error_ != Regexp::OK) return -1;
+      // A group that only changed the flags.
+      continue;
+    }
+    atom = parse_repetition(atom);
+    if (atom < 0) return -1;
+    add_child(concatenation, atom);
+  }
+  return concatenation;
+}
+
+int RegexpCompiler::parse_atom() {
+  int c = peek();
+  switch (c) {
+    case '(':
+      position_++;
+      return parse_group();
+    case '[':
+      position_++;
+      return parse_class();
+    case '.':
+      position_++;
+      return new_node((flags_ & Regexp::DOT_ALL) ? ANY_CHARACTER : ANY_CHARACTER_EXCEPT_NEWLINE);
+    case '^':
+      position_++;
+      return new_node(ASSERTION, (flags_ & Regexp::MULTILINE) ? BEGIN_LINE : BEGIN_TEXT);
+    case '$':
+      position_++;
+      return new_node(ASSERTION, (flags_ & Regexp::MULTILINE) ? END_LINE : END_TEXT);
+    case '\\':
+      position_++;
+      return parse_escape();
+    case '*':
+    case '+':
+    case '?':
+      return fail(Regexp::NOTHING_TO_REPEAT);
+    case '{': {
+      word start = position_;
+      int min, max;
+      if (parse_bounds(&min, &max)) {
+        position_ = start;
+        return fail(Regexp::NOTHING_TO_REPEAT);
+      }
+      // Not a repetition, so a literal '{'.
+      position_ = start + 1;
+      return literal('{');
+    }
+    default:
+      return literal(next_character());
+  }
+}
+
+int RegexpCompiler::parse_group() {
+  int saved_flags = flags_;
+  int group = -1;
+  if (accept('?')) {
+    if (accept('P') && peek() != '<') return fail(Regexp::INVALID_GROUP);
+    if (accept('<')) {
+      // A named group.
+      word start = position_;
+      while (!at_end() && peek() != '>') {
+        if (!is_word_character(peek())) return fail(Regexp::INVALID_GROUP);
+        position_++;
+      }
+      word name_length = position_ - start;
+      if (!accept('>') || name_length == 0 || name_length > MAX_NAME_LENGTH) return fail(Regexp::INVALID_GROUP);
+      if (group_count_ >= MAX_GROUPS) return fail(Regexp::TOO_BIG);
+      group = group_count_++;
+      if (!ensure_capacity(&names_, &names_capacity_, names_length_ + 3 + name_length)) {
+        return fail(Regexp::MALLOC_FAILED);
+      }
+      names_[names_length_++] = group & 0xff;
+      names_[names_length_++] = group >> 8;
+      names_[names_length_++] = name_length;
+      memcpy(&names_[names_length_], &pattern_[start], name_length);
+      names_length_ += name_length;
+    } else {
+      // Flags, either for the rest of the enclosing group, or for a
+      // non-capturing group.
+      bool negate = false;
+      while (true) {
+        int c = peek();
+        int flag = 0;
+        if (c == 'i') {
+          flag = Regexp::CASE_INSENSITIVE;
+        } else if (c == 'm') {
+          flag = Regexp::MULTILINE;
+        } else if (c == 's') {
+          flag = Regexp::DOT_ALL;
+        } else if (c == '-' && !negate) {
+          negate = true;
+          position_++;
+          continue;
+        } else {
+          break;
+        }
+        position_++;
+        if (negate) {
+          flags_ &= ~flag;
+        } else {
+          flags_ |= flag;
+        }
+      }
+      if (accept(')')) {
+        // Keeps the flags, but doesn't produce a node.
+        return -1;
+      }
+      if (!accept(':')) return fail(Regexp::INVALID_GROUP);
+    }
+  } else {
+    if (group_count_ >= MAX_GROUPS) return fail(Regexp::TOO_BIG);
+    group = group_count_++;
+  }
+  int body = parse_alternation();
+  if (body < 0) return -1;
+  if (!accept(')')) return fail(Regexp::MISSING_PARENTHESIS);
+  flags_ = saved_flags;
+  if (group < 0) return body;
+  int capture = new_node(CAPTURE, group);
+  if (capture < 0) return -1;
+  add_child(capture, body);
+  return capture;
+}
+
+int RegexpCompiler::parse_class() {
+  int start = range_count_;
+  bool negate = accept('^');
+  bool first = true;
+  while (true) {
+    if (at_end()) return fail(Regexp::MISSING_BRACKET);
+    if (!first && peek() == ']') break;
+    first = false;
+    word item_position = position_;
+    int low;
+    if (accept('\\')) {
+      int result = parse_class_escape(&low);
+      if (result < 0) return -1;
+      // A Perl class like \d was added directly.
+      if (result == 1) continue;
+    } else {
+      low = next_character();
+    }
+    int high = low;
+    if (peek() == '-' && position_ + 1 < length_ && pattern_[position_ + 1] != ']') {
+      position_++;
+      if (accept('\\')) {
+        int result = parse_class_escape(&high);
+        if (result < 0) return -1;
+        if (result == 1) {
+          position_ = item_position;
+          return fail(Regexp::INVALID_RANGE);
+        }
+      } else {
+        high = next_character();
+      }
+      if (high < low) {
+        position_ = item_position;
+        return fail(Regexp::INVALID_RANGE);
+      }
+    }
+    if (add_range(low, high) < 0) return -1;
+  }
+  position_++;  // Skip the ']'.
+  normalize_ranges(start, negate);
+  if (error_ != Regexp::OK) return -1;
+  return new_node(RANGES, start, range_count_ - start);
+}
+
+// Sorts and merges the ranges from the start, adds the other case of
+// ASCII letters if the pattern is case insensitive, and negates them if
+// needed.
+void RegexpCompiler::normalize_ranges(int start, bool negate) {
+  if (flags_ & Regexp::CASE_INSENSITIVE) {
+    int end = range_count_;
+    for (int i = start; i < end; i++) {
+      int first = ranges_[i * 2];
+      int last = ranges_[i * 2 + 1];
+      int lower_first = Utils::max(first, static_cast<int>('a'));
+      int lower_last = Utils::min(last, static_cast<int>('z'));
+      if (lower_first <= lower_last && add_range(lower_first - 32, lower_last - 32) < 0) return;
+      int upper_first = Utils::max(first, static_cast<int>('A'));
+      int upper_last = Utils::min(last, static_cast<int>('Z'));
+      if (upper_first <= upper_last && add_range(upper_first + 32, upper_last + 32) < 0) return;
+    }
+  }
+  // Insertion sort, since classes are short.
+  int32* pairs = &ranges_[start * 2];
+  int count = range_count_ - start;
+  for (int i = 1; i < count; i++) {
+    int32 first = pairs[i * 2];
+    int32 last = pairs[i * 2 + 1];
+    int j = i - 1;
+    while (j >= 0 && pairs[j * 2] > first) {
+      pairs[(j + 1) * 2] = pairs[j * 2];
+      pairs[(j + 1) * 2 + 1] = pairs[j * 2 + 1];
+      j--;
+    }
+    pairs[(j + 1) * 2] = first;
+    pairs[(j + 1) * 2 + 1] = last;
+  }
+  int merged = 0;
+  for (int i = 0; i < count; i++) {
+    if (merged > 0 && pairs[i * 2] <= pairs[(merged - 1) * 2 + 1] + 1) {
+      pairs[(merged - 1) * 2 + 1] = Utils::max(pairs[(merged - 1) * 2 + 1], pairs[i * 2 + 1]);
+    } else {
+      pairs[merged * 2] = pairs[i * 2];
+      pairs[merged * 2 + 1] = pairs[i * 2 + 1];
+      merged++;
+    }
+  }
+  range_count_ = start + merged;
+  if (!negate) return;
+  // The complement has at most one more range. It is built after the
+  // ranges and then moved down.
+  int next = 0;
+  int complement = range_count_;
+  for (int i = 0; i < merged; i++) {
+    int first = ranges_[(start + i) * 2];
+    int last = ranges_[(start + i) * 2 + 1];
+    if (first > next && add_range(next, first - 1) < 0) return;
+    next = last + 1;
+  }
+  if (next <= MAX_CHARACTER && add_range(next, MAX_CHARACTER) < 0) return;
+  int complement_count = range_count_ - complement;
+  memmove(&ranges_[start * 2], &ranges_[complement * 2], complement_count * 2 * sizeof(int32));
+  range_count_ = start + complement_count;
+}
+
+int RegexpCompiler::literal(int c) {
+  int start = range_count_;
+  if (add_range(c, c) < 0) return -1;
+  normalize_ranges(start, false);
+  if (error_ != Regexp::OK) return -1;
+  return new_node(RANGES, start, range_count_ - start);
+}
+
+// Adds the ranges of \d, \w, \s, or their negations, and returns the
+// number of ranges added, or -1.
+int RegexpCompiler::add_perl_class(int c) {
+  int start = range_count_;
+  switch (c | 0x20) {
+    case 'd':
+      if (add_range('0', '9') < 0) return -1;
+      break;
+    case 'w':
+      if (add_range('0', '9') < 0 || add_range('A', 'Z') < 0 ||
+          add_range('_', '_') < 0 || add_range('a', 'z') < 0) {
+        return -1;
+      }
+      break;
+    case 's':
+      if (add_range('\t', '\r') < 0 || add_range(' ', ' ') < 0) return -1;
+      break;
+  }
+  if ('A' <= c && c <= 'Z') {
+    // The negated classes, computed in place.
+    int flags = flags_;
+    flags_ &= ~Regexp::CASE_INSENSITIVE;
+    normalize_ranges(start, true);
+    flags_ = flags;
+    if (error_ != Regexp::OK) return -1;
+  }
+  return range_count_ - start;
+}
+
+// Parses a single character after a backslash, or returns -1 if it isn't
+// a character escape.
+static int simple_escape(int c) {
+  switch (c) {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    case 'a': return '\a';
+    case '0': return '\0';
+  }
+  // Escaped punctuation stands for itself.
+  if (c <= Utils::MAX_ASCII && !is_word_character(c) && c > ' ') return c;
+  return -1;
+}
+
+int RegexpCompiler::parse_hex() {
+  bool braces = accept('{');
+  int value = 0;
+  int digits = 0;
+  while (!at_end()) {
+    int c = peek();
+    int digit;
+    if ('0' <= c && c <= '9') {
+      digit = c - '0';
+    } else if ('a' <= (c | 0x20) && (c | 0x20) <= 'f') {
+      digit = (c | 0x20) - 'a' + 10;
+    } else {
+      break;
+    }
+    if (!braces && digits == 2) break;
+    value = value * 16 + digit;
+    if (value > MAX_CHARACTER) return fail(Regexp::INVALID_ESCAPE);
+    digits++;
+    position_++;
+  }
+  if (digits == 0 || (braces ? !accept('}') : digits != 2)) return fail(Regexp::INVALID_ESCAPE);
+  return value;
+}
+
+int RegexpCompiler::parse_escape() {
+  if (at_end()) return fail(Regexp::INVALID_ESCAPE);
+  int c = pattern_[position_++];
+  switch (c) {
+    case 'b': return new_node(ASSERTION, WORD_BOUNDARY);
+    case 'B': return new_node(ASSERTION, NOT_WORD_BOUNDARY);
+    case 'A': return new_node(ASSERTION, BEGIN_TEXT);
+    case 'z': return new_node(ASSERTION, END_TEXT);
+    case 'd': case 'D': case 'w': case 'W': case 's': case 'S': {
+      int start = range_count_;
+      int count = add_perl_class(c);
+      if (count < 0) return -1;
+      return new_node(RANGES, start, count);
+    }
+    case 'x': {
+      int value = parse_hex();
+      if (value < 0) return -1;
+      return literal(value);
+    }
+  }
+  int value = simple_escape(c);
+  if (value < 0) {
+    position_--;
+    return fail(Regexp::INVALID_ESCAPE);
+  }
+  return literal(value);
+}
+
+// Parses an escape in a character class. Returns 0 and sets *c for a
+// single character, returns 1 if a Perl class was added, or -1.
+int RegexpCompiler::parse_class_escape(int* c) {
+  if (at_end()) return fail(Regexp::INVALID_ESCAPE);
+  int escaped = pattern_[position_++];
+  switch (escaped) {
+    case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+      return add_perl_class(escaped) < 0 ? -1 : 1;
+    case 'x':
+      *c = parse_hex();
+      return *c < 0 ? -1 : 0;
+    case 'b':
+      *c = '\b';
+      return 0;
+  }
+  *c = simple_escape(escaped);
+  if (*c < 0) {
+    position_--;
+    return fail(Regexp::INVALID_ESCAPE);
+  }
+  return 0;
+}
+
+bool RegexpCompiler::parse_number(int* result) {
+  int value = 0;
+  int digits = 0;
+  while ('0' <= peek() && peek() <= '9') {
+    value = value * 10 + pattern_[position_++] - '0';
+    if (value > MAX_REPETITION) value = MAX_REPETITION + 1;
+    digits++;
+  }
+  *result = value;
+  return digits > 0;
+}
+
+// Parses {n}, {n,} or {n,m}. Returns false, without reporting an error,
+// if the input doesn't have that form.
+bool RegexpCompiler::parse_bounds(int* min, int* max) {
+  if (!accept('{')) return false;
+  if (!parse_number(min)) return false;
+  if (accept(',')) {
+    if (peek() == '}') {
+      *max = -1;
+    } else if (!parse_number(max)) {
+      return false;
+    }
+  } else {
+    *max = *min;
+  }
+  return accept('}');
+}
+
+int RegexpCompiler::parse_repetition(int atom) {
+  int min, max;
+  word start = position_;
+  switch (peek()) {
+    case '*':
+      position_++;
+      min = 0;
+      max = -1;
+      break;
+    case '+':
+      position_++;
+      min = 1;
+      max = -1;
+      break;
+    case '?':
+      position_++;
+      min = 0;
+      max = 1;
+      break;
+    case '{':
+      if (!parse_bounds(&min, &max)) {
+        // A literal '{', parsed as the next atom.
+        position_ = start;
+        return atom;
+      }
+      if (min > MAX_REPETITION || max > MAX_REPETITION || (max >= 0 && max < min)) {
+        position_ = start;
+        return fail(Regexp::INVALID_REPETITION);
+      }
+      break;
+    default:
+      return atom;
+  }
+  bool greedy = !accept('?');
+  int c = peek();
+  if (c == '*' || c == '+' || c == '?') return fail(Regexp::INVALID_REPETITION);
+  if (c == '{') {
+    word next = position_;
+    int ignored_min, ignored_max;
+    bool is_bounds = parse_bounds(&ignored_min, &ignored_max);
+    position_ = next;
+    if (is_bounds) return fail(Regexp::INVALID_REPETITION);
+  }
+  int repetition = new_node(REPETITION, min, max);
+  if (repetition < 0) return -1;
+  nodes_[repetition].greedy = greedy;
+  add_child(repetition, atom);
+  return repetition;
+}
+
+int RegexpCompiler::emit(int opcode, int x, int y) {
+  if (program_length_ >= MAX_PROGRAM_LENGTH) return fail(Regexp::TOO_BIG);
+  if (!ensure_capacity(&program_, &program_capacity_, program_length_ + 1)) return fail(Regexp::MALLOC_FAILED);
+  Regexp::Instruction* instruction = &program_[program_length_];
+  instruction->opcode = opcode;
+  instruction->x = x;
+  instruction->y = y;
+  return program_length_++;
+}
+
+// Instructions whose targets aren't known yet are chained through the
+// target that needs patching, ending with -1.
+void RegexpCompiler::patch_chain(int head, bool patch_x, int target) {
+  while (head >= 0) {
+    Regexp::Instruction* instruction = &program_[head];
+    int32* field = patch_x ? &instruction->x : &instruction->y;
+    head = *field;
+    *field = target;
+  }
+}
+
+bool RegexpCompiler::emit_node(int index) {
+  const Node& node = nodes_[index];
+  switch (node.type) {
+    case EMPTY:
+      return true;
+    case RANGES:
+      if (node.y == 1) {
+        return emit(MATCH_CHARACTER, ranges_[node.x * 2], ranges_[node.x * 2 + 1]) >= 0;
+      }
+      return emit(MATCH_CLASS, node.x, node.y) >= 0;
+    case ANY_CHARACTER:
+      return emit(MATCH_ANY) >= 0;
+    case ANY_CHARACTER_EXCEPT_NEWLINE:
+      return emit(MATCH_ANY_EXCEPT_NEWLINE) >= 0;
+    case ASSERTION:
+      return emit(CHECK_ASSERTION, node.x) >= 0;
+    case CONCATENATION:
+      for (int child = node.first_child; child >= 0; child = nodes_[child].next_sibling) {
+        if (!emit_node(child)) return false;
+      }
+      return true;
+    case ALTERNATION: {
+      int jumps = -1;
+      for (int child = node.first_child; child >= 0; child = nodes_[child].next_sibling) {
+        if (nodes_[child].next_sibling < 0) {
+          if (!emit_node(child)) return false;
+          break;
+        }
+        int split = emit(SPLIT, program_length_ + 1, -1);
+        if (split < 0 || !emit_node(child)) return false;
+        jumps = emit(JUMP, jumps);
+        if (jumps < 0) return false;
+        program_[split].y = program_length_;
+      }
+      patch_chain(jumps, true, program_length_);
+      return true;
+    }
+    case CAPTURE:
+      return emit(SAVE, node.x * 2) >= 0 &&
+          emit_node(node.first_child) &&
+          emit(SAVE, node.x * 2 + 1) >= 0;
+    case REPETITION: {
+      int min = node.x;
+      int max = node.y;
+      int child = node.first_child;
+      int required = (max < 0 && min > 0) ? min - 1 : min;
+      for (int i = 0; i < required; i++) {
+        if (!emit_node(child)) return false;
+      }
+      if (max < 0) {
+        if (min > 0) {
+          // One or more: the body, then a loop back to it.
+          int loop = program_length_;
+          if (!emit_node(child)) return false;
+          int next = program_length_ + 1;
+          return emit(SPLIT, node.greedy ? loop : next, node.greedy ? next : loop) >= 0;
+        }
+        // Zero or more: a split that either enters the body or exits.
+        int loop = emit(SPLIT, -1, -1);
+        if (loop < 0 || !emit_node(child) || emit(JUMP, loop) < 0) return false;
+        program_[loop].x = node.greedy ? loop + 1 : program_length_;
+        program_[loop].y = node.greedy ? program_length_ : loop + 1;
+        return true;
+      }
+      // The optional repetitions are nested, so each exits to the end.
+      int exits = -1;
+      for (int i = min; i < max; i++) {
+        int split = node.greedy
+            ? emit(SPLIT, program_length_ + 1, exits)
+            : emit(SPLIT, exits, program_length_ + 1);
+        if (split < 0) return false;
+        exits = split;
+        if (!emit_node(child)) return false;
+      }
+      patch_chain(exits, !node.greedy, program_length_);
+      return true;
+    }
+  }
+  UNREACHABLE();
+  return false;
+}
+
+bool RegexpCompiler::is_anchored() const {
+  int index = root_;
+  while (true) {
+    const Node* node = &nodes_[index];
+    if (node->type == CONCATENATION || node->type == CAPTURE) {
+      if (node->first_child < 0) return false;
+      index = node->first_child;
+      continue;
+    }
+    return node->type == ASSERTION && node->x == BEGIN_TEXT;
+  }
+}
+
+// Collects the literal characters every match of the node starts with.
+// Sets *complete if the node is exactly the literal.
+int RegexpCompiler::literal_prefix(int index, uint8* buffer, int* length, bool* complete) {
+  const Node* node = &nodes_[index];
+  *complete = false;
+  switch (node->type) {
+    case RANGES: {
+      int c = ranges_[node->x * 2];
+      // The replacement character also matches invalid bytes.
+      if (node->y != 1 || c != ranges_[node->x * 2 + 1] || c == REPLACEMENT_CHARACTER) return 0;
+      if (*length + 4 > MAX_PREFIX_LENGTH) return 0;
+      *length += encode_character(c, buffer + *length);
+      *complete = true;
+      return 0;
+    }
+    case CONCATENATION:
+      for (int child = node->first_child; child >= 0; child = nodes_[child].next_sibling) {
+        bool child_complete;
+        literal_prefix(child, buffer, length, &child_complete);
+        if (!child_complete) return 0;
+      }
+      *complete = true;
+      return 0;
+    case CAPTURE:
+      return literal_prefix(node->first_child, buffer, length, complete);
+    default:
+      return 0;
+  }
+}
+
+int RegexpCompiler::literal_prefix(uint8* buffer) {
+  int length = 0;
+  bool complete;
+  literal_prefix(root_, buffer, &length, &complete);
+  return length;
+}
+
+Regexp::~Regexp() {
+  free(program_);
+  free(ranges_);
+  free(names_);
+  free(prefix_);
+  delete prefix_searcher_;
+  if (lists_ != null) {
+    for (int i = 0; i < 2; i++) {
+      free(lists_[i].sparse);
+      free(lists_[i].dense);
+      free(lists_[i].slots);
+    }
+    free(lists_);
+  }
+  free(stack_);
+  free(slots_);
+  free(captures_);
+}
+
+Regexp::Error Regexp::compile(const uint8* pattern, word length, int flags, word* error_position) {
+  ASSERT(program_ == null);
+  RegexpCompiler compiler(pattern, length, flags);
+  Error error = compiler.compile();
+  if (error != OK) {
+    *error_position = compiler.error_position();
+    return error;
+  }
+  *error_position = 0;
+  anchored_ = compiler.is_anchored();
+  uint8 prefix[MAX_PREFIX_LENGTH];
+  word prefix_length = anchored_ ? 0 : compiler.literal_prefix(prefix);
+  program_ = compiler.take_program(&program_length_);
+  ranges_ = compiler.take_ranges();
+  names_ = compiler.take_names(&names_length_);
+  slot_count_ = compiler.group_count() * 2;
+  if (prefix_length > 0) {
+    prefix_ = unvoid_cast<uint8*>(malloc(prefix_length));
+    if (prefix_ == null) return MALLOC_FAILED;
+    memcpy(prefix_, prefix, prefix_length);
+    prefix_length_ = prefix_length;
+    prefix_searcher_ = _new SubstringSearcher(prefix_, prefix_length_);
+    if (prefix_searcher_ == null) return MALLOC_FAILED;
+  }
+  if (!allocate_scratch()) return MALLOC_FAILED;
+  if (!anchored_ && prefix_length == 0) compute_first_bytes();
+  return OK;
+}
+
+void Regexp::compute_first_bytes() {
+  memset(first_bytes_, 0, sizeof(first_bytes_));
+  // Follow the instructions that don't consume input from the start, using
+  // the scratch space of the first thread list to avoid visiting them twice.
+  ThreadList* visited = &lists_[0];
+  visited->size = 0;
+  int* worklist = lists_[1].dense;
+  int count = 0;
+  worklist[count++] = 0;
+  visited->insert(0);
+  while (count > 0) {
+    const Instruction* instruction = &program_[worklist[--count]];
+    int targets[2];
+    int target_count = 0;
+    switch (instruction->opcode) {
+      case MATCH_CHARACTER:
+      case MATCH_CLASS: {
+        int ranges = instruction->opcode == MATCH_CLASS ? instruction->y : 1;
+        for (int i = 0; i < ranges; i++) {
+          int first = instruction->opcode == MATCH_CLASS ? ranges_[(instruction->x + i) * 2] : instruction->x;
+          int last = instruction->opcode == MATCH_CLASS ? ranges_[(instruction->x + i) * 2 + 1] : instruction->y;
+          if (last > Utils::MAX_ASCII) {
+            memset(&first_bytes_[0x80 >> 3], 0xff, 0x80 >> 3);
+            last = Utils::MAX_ASCII;
+          }
+          for (int c = first; c <= last; c++) first_bytes_[c >> 3] |= 1 << (c & 7);
+        }
+        break;
+      }
+      case SPLIT:
+        targets[target_count++] = instruction->y;
+        targets[target_count++] = instruction->x;
+        break;
+      case JUMP:
+        targets[target_count++] = instruction->x;
+        break;
+      case SAVE:
+      case CHECK_ASSERTION:
+        targets[target_count++] = instruction - program_ + 1;
+        break;
+      default:
+        // Matches any character, or can match the empty string.
+        visited->size = 0;
+        return;
+    }
+    for (int i = 0; i < target_count; i++) {
+      if (visited->contains(targets[i])) continue;
+      visited->insert(targets[i]);
+      worklist[count++] = targets[i];
+    }
+  }
+  visited->size = 0;
+  for (unsigned i = 0; i < sizeof(first_bytes_); i++) {
+    if (first_bytes_[i] != 0xff) {
+      has_first_bytes_ = true;
+      return;
+    }
+  }
+}
+
+bool Regexp::allocate_scratch() {
+  lists_ = unvoid_cast<ThreadList*>(calloc(2, sizeof(ThreadList)));
+  if (lists_ == null) return false;
+  for (int i = 0; i < 2; i++) {
+    ThreadList* list = &lists_[i];
+    // The sparse set reads entries that were never written, so they must
+    // be initialized.
+    list->sparse = unvoid_cast<int*>(calloc(program_length_, sizeof(int)));
+    list->dense = unvoid_cast<int*>(malloc(program_length_ * sizeof(int)));
+    list->slots = unvoid_cast<word*>(malloc(program_length_ * slot_count_ * sizeof(word)));
+    if (list->sparse == null || list->dense == null || list->slots == null) return false;
+  }
+  // Each instruction pushes at most one entry of two words.
+  stack_ = unvoid_cast<word*>(malloc((program_length_ + 1) * 2 * sizeof(word)));
+  slots_ = unvoid_cast<word*>(malloc(slot_count_ * sizeof(word)));
+  captures_ = unvoid_cast<word*>(malloc(slot_count_ * sizeof(word)));
+  return stack_ != null && slots_ != null && captures_ != null;
+}
+
+const uint8* Regexp::group_name(int group, word* length) const {
+  word i = 0;
+  while (i < names_length_) {
+    int index = names_[i] | (names_[i + 1] << 8);
+    int name_length = names_[i + 2];
+    if (index == group) {
+      *length = name_length;
+      return &names_[i + 3];
+    }
+    i += 3 + name_length;
+  }
+  return null;
+}
+
+int Regexp::character_width(const uint8* subject, word length, word position) {
+  if (position >= length) return 1;
+  int width;
+  decode_character(subject, length, position, &width);
+  return width;
+}
+
+bool Regexp::check_assertion(int kind, const uint8* subject, word length, word position) const {
+  switch (kind) {
+    case BEGIN_TEXT:
+      return position == 0;
+    case END_TEXT:
+      return position == length;
+    case BEGIN_LINE:
+      return position == 0 || subject[position - 1] == '\n';
+    case END_LINE:
+      return position == length || subject[position] == '\n';
+    case WORD_BOUNDARY:
+    case NOT_WORD_BOUNDARY: {
+      bool before = position > 0 && is_word_character(subject[position - 1]);
+      bool after = position < length && is_word_character(subject[position]);
+      return (before != after) == (kind == WORD_BOUNDARY);
+    }
+  }
+  UNREACHABLE();
+  return false;
+}
+
+bool Regexp::matches_class(const Instruction* instruction, int character) const {
+  // Binary search for the last range that starts at or before the
+  // character.
+  const int32* pairs = &ranges_[instruction->x * 2];
+  int low = 0;
+  int high = instruction->y;
+  while (low < high) {
+    int middle = (low + high) / 2;
+    if (pairs[middle * 2] <= character) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low > 0 && character <= pairs[(low - 1) * 2 + 1];
+}
+
+// Adds the thread at the pc to the list, following jumps and splits, so
+// the list only contains instructions that consume input or match. The
+// slots are updated on the way and restored afterwards.
+void Regexp::add_thread(ThreadList* list, int pc, const uint8* subject, word length, word position, word* slots) {
+  word* stack = stack_;
+  int top = 0;
+  // Entries are pairs of a slot and its old value, or -1 and a pc.
+  stack[top++] = -1;
+  stack[top++] = pc;
+  while (top > 0) {
+    word value = stack[--top];
+    word slot = stack[--top];
+    if (slot >= 0) {
+      slots[slot] = value;
+      continue;
+    }
+    pc = value;
+    while (!list->contains(pc)) {
+      int index = list->insert(pc);
+      const Instruction* instruction = &program_[pc];
+      if (instruction->opcode == JUMP) {
+        pc = instruction->x;
+      } else if (instruction->opcode == SPLIT) {
+        stack[top++] = -1;
+        stack[top++] = instruction->y;
+        pc = instruction->x;
+      } else if (instruction->opcode == SAVE) {
+        stack[top++] = instruction->x;
+        stack[top++] = slots[instruction->x];
+        slots[instruction->x] = position;
+        pc++;
+      } else if (instruction->opcode == CHECK_ASSERTION) {
+        if (!check_assertion(instruction->x, subject, length, position)) break;
+        pc++;
+      } else {
+        memcpy(&list->slots[index * slot_count_], slots, slot_count_ * sizeof(word));
+        break;
+      }
+    }
+  }
+}
+
+word Regexp::find_prefix(const uint8* subject, word length, word from) const {
+  if (prefix_length_ == 1) {
+    const void* found = memchr(subject + from, prefix_[0], length - from);
+    return found == null ? -1 : static_cast<const uint8*>(found) - subject;
+  }
+  return prefix_searcher_->find(subject, from, length);
+}
+
+bool Regexp::search(const uint8* subject, word length, word from, int flags) {
+  bool seed_once = anchored_ || (flags & ANCHOR_START) != 0;
+  bool anchor_end = (flags & ANCHOR_END) != 0;
+  if (anchored_ && from != 0) return false;
+  ThreadList* current = &lists_[0];
+  ThreadList* next = &lists_[1];
+  current->size = 0;
+  bool matched = false;
+  word position = from;
+  while (true) {
+    if (current->size == 0) {
+      // No match in progress, so we are done, or can skip ahead.
+      if (matched || (seed_once && position != from)) break;
+      if (prefix_searcher_ != null && !seed_once) {
+        position = find_prefix(subject, length, position);
+        if (position < 0) break;
+      } else if (has_first_bytes_ && !seed_once) {
+        while (position < length && !is_first_byte(subject[position])) position++;
+        if (position == length) break;
+      }
+    }
+    if (!matched && (!seed_once || position == from)) {
+      // Start a new thread at this position, with the lowest priority.
+      for (int i = 0; i < slot_count_; i++) slots_[i] = -1;
+      add_thread(current, 0, subject, length, position, slots_);
+    }
+    int character = -1;
+    int width = 0;
+    if (position < length) character = decode_character(subject, length, position, &width);
+    next->size = 0;
+    for (int i = 0; i < current->size; i++) {
+      int pc = current->dense[i];
+      const Instruction* instruction = &program_[pc];
+      word* slots = &current->slots[i * slot_count_];
+      bool step = false;
+      switch (instruction->opcode) {
+        case MATCH_CHARACTER:
+          step = instruction->x <= character && character <= instruction->y;
+          break;
+        case MATCH_CLASS:
+          step = character >= 0 && matches_class(instruction, character);
+          break;
+        case MATCH_ANY:
+          step = character >= 0;
+          break;
+        case MATCH_ANY_EXCEPT_NEWLINE:
+          step = character >= 0 && character != '\n';
+          break;
+        case MATCH:
+          if (anchor_end && position != length) continue;
+          memcpy(captures_, slots, slot_count_ * sizeof(word));
+          matched = true;
+          // Threads with lower priority can't produce a preferred match.
+          i = current->size;
+          continue;
+        default:
+          // Jumps, splits, saves and assertions were followed when the
+          // thread was added.
+          continue;
+      }
+      if (step) add_thread(next, pc + 1, subject, length, position + width, slots);
+    }
+    if (position >= length) break;
+    ThreadList* swap = current;
+    current = next;
+    next = swap;
+    position += width;
+  }
+  return matched;
+}
+
+} // namespace toit
@@ -0,0 +1,136 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+#include "resource.h"
+#include "tags.h"
+
+namespace toit {
+
+class SubstringSearcher;
+
+// A compiled regular expression.
+//
+// The pattern is compiled once into a program for a Thompson NFA, which is
+// run by a Pike VM. The VM keeps at most one thread per instruction, so a
+// search takes time proportional to the length of the subject times the
+// length of the program, whatever the pattern. There is no backtracking,
+// and hence no backreferences or lookaround.
+//
+// Subjects are UTF-8. Invalid bytes are matched one at a time, as if they
+// were U+FFFD. All memory needed for a search is allocated when compiling,
+// so searches never allocate.
+class Regexp : public SimpleResource {
+ public:
+  TAG(Regexp);
+
+  // Flags for $compile.
+  static const int CASE_INSENSITIVE = 1 << 0;
+  static const int MULTILINE = 1 << 1;
+  static const int DOT_ALL = 1 << 2;
+
+  // Flags for $search.
+  static const int ANCHOR_START = 1 << 0;
+  static const int ANCHOR_END = 1 << 1;
+
+  // Reasons for a failed compilation.
+  enum Error {
+    OK = 0,
+    MALLOC_FAILED,
+    MISSING_PARENTHESIS,
+    UNEXPECTED_PARENTHESIS,
+    MISSING_BRACKET,
+    INVALID_ESCAPE,
+    INVALID_RANGE,
+    INVALID_REPETITION,
+    NOTHING_TO_REPEAT,
+    INVALID_GROUP,
+    TOO_BIG,
+  };
+
+  explicit Regexp(SimpleResourceGroup* group) : SimpleResource(group) {}
+  ~Regexp();
+
+  // Compiles the pattern. On failure, returns the reason and sets the
+  // position in the pattern where it was detected.
+  Error compile(const uint8* pattern, word length, int flags, word* error_position);
+
+  // The number of capture groups, including the implicit group 0 for the
+  // whole match.
+  int group_count() const { return slot_count_ / 2; }
+
+  // The name of the given group, or null if it is unnamed. Names are not
+  // '\0' terminated.
+  const uint8* group_name(int group, word* length) const;
+
+  // Finds the leftmost match that starts at or after $from, preferring
+  // alternatives and repetitions like a backtracking engine would.
+  bool search(const uint8* subject, word length, word from, int flags);
+
+  // The start (even slots) and end (odd slots) of the groups of the last
+  // successful search. Groups that didn't take part in the match are -1.
+  word capture(int slot) const { return captures_[slot]; }
+
+  // The width of the character that starts at the given position of a
+  // subject, as seen by the matcher.
+  static int character_width(const uint8* subject, word length, word position);
+
+  struct Instruction;
+  struct ThreadList;
+
+ private:
+  Instruction* program_ = null;
+  int program_length_ = 0;
+  // Sorted ranges of characters for the classes of the program, as pairs
+  // of first and last character.
+  int32* ranges_ = null;
+
+  int slot_count_ = 2;
+  // Group names, each preceded by the group index and length.
+  uint8* names_ = null;
+  word names_length_ = 0;
+
+  // Whether the program can only match at the start of the subject.
+  bool anchored_ = false;
+
+  // A literal every match starts with, used to skip ahead quickly.
+  uint8* prefix_ = null;
+  word prefix_length_ = 0;
+  SubstringSearcher* prefix_searcher_ = null;
+
+  // The bytes a match can start with, as a bitmap, when there is no literal
+  // prefix. Either all non-ASCII bytes are in the set or none, so skipping
+  // bytes that aren't in it keeps the position at a character boundary.
+  bool has_first_bytes_ = false;
+  uint8 first_bytes_[32];
+
+  // Scratch space for $search.
+  ThreadList* lists_ = null;
+  word* stack_ = null;
+  word* slots_ = null;
+  word* captures_ = null;
+
+  bool allocate_scratch();
+  void compute_first_bytes();
+  bool is_first_byte(uint8 byte) const { return (first_bytes_[byte >> 3] & (1 << (byte & 7))) != 0; }
+  void add_thread(ThreadList* list, int pc, const uint8* subject, word length, word position, word* slots);
+  bool check_assertion(int kind, const uint8* subject, word length, word position) const;
+  bool matches_class(const Instruction* instruction, int character) const;
+  word find_prefix(const uint8* subject, word length, word from) const;
+};
+
+} // namespace toit
@@ -19,9 +19,54 @@
 #include "../process.h"
 #include "../os.h"
 #include "../flash_registry.h"
+#include "../sha.h"
+#include "../snapshot.h"
 
 namespace toit {
 
+// Writes a relocatable image to flash as it streams in. The data is accepted
+// in pieces of any size; only complete chunks of relocation bits and words
+// are written and the rest is kept until more data arrives. The SHA-256 of
+// the streamed data is computed in the same pass, so the image can be
+// verified when it is committed without reading it back.
+class ImageWriter {
+ public:
+  TAG(ImageWriter);
+  explicit ImageWriter(ProgramImage image)
+      : output_(image)
+      , sha_(null, 256) {}
+
+  static const int CHUNK_BYTE_SIZE = ImageOutputStream::CHUNK_SIZE * WORD_SIZE;
+
+  ImageOutputStream* output() { return &output_; }
+
+  // The number of bytes accepted so far.
+  word written() const { return written_; }
+
+  // Whether the data so far ends in the middle of a chunk.
+  bool has_partial_chunk() const { return partial_fill_ > 0; }
+
+  // Returns an error or null.
+  Object* write(Process* process, const uint8* data, word length);
+
+  void digest(uint8* hash) const {
+    Sha copy(&sha_);
+    copy.get(hash);
+  }
+
+ private:
+  ImageOutputStream output_;
+  Sha sha_;
+  word written_ = 0;
+  int partial_fill_ = 0;
+  uint8 partial_[CHUNK_BYTE_SIZE];
+
+  void accept(const uint8* data, word length) {
+    sha_.add(data, length);
+    written_ += length;
+  }
+};
+
 MODULE_IMPLEMENTATION(image, MODULE_IMAGE)
 
 PRIMITIVE(current_id) {
@@ -42,10 +87,10 @@ PRIMITIVE(writer_create) {
   if (!FlashRegistry::erase_chunk(offset, byte_size)) FAIL(HARDWARE_ERROR);
   void* address = FlashRegistry::region(offset, byte_size);
   ProgramImage image(address, byte_size);
-  ImageOutputStream* output = _new ImageOutputStream(image);
-  if (output == null) FAIL(MALLOC_FAILED);
+  ImageWriter* writer = _new ImageWriter(image);
+  if (writer == null) FAIL(MALLOC_FAILED);
 
-  result->set_external_address(output);
+  result->set_external_address(writer);
   return result;
 }
 
@@ -55,7 +100,8 @@ static Object* write_image_chunk(Process* process, ImageOutputStream* output, co
   word buffer[WORD_BIT_SIZE];
 
   bool first = output->empty();
-  int offset = FlashRegistry::offset(output->cursor());
+  void* cursor = output->cursor();
+  int offset = FlashRegistry::offset(cursor);
   if (offset < 0 || offset + output_byte_size > FlashRegistry::allocations_size()) FAIL(OUT_OF_BOUNDS);
   output->write(data, length, buffer);
 
@@ -73,26 +119,81 @@ static Object* write_image_chunk(Process* process, ImageOutputStream* output, co
   } else {
     success = FlashRegistry::write_chunk(buffer, offset, output_byte_size);
   }
-  if (!success) FAIL(HARDWARE_ERROR);
+  if (!success) {
+    // Leave the output where it was, so the chunk can be written again.
+    output->rewind(cursor);
+    FAIL(HARDWARE_ERROR);
+  }
+  return null;
+}
+
+Object* ImageWriter::write(Process* process, const uint8* data, word length) {
+  // Check the size up front, so a failing write doesn't leave a partially
+  // written image behind.
+  word chunks = (partial_fill_ + length) / CHUNK_BYTE_SIZE;
+  word output_byte_size = chunks * (CHUNK_BYTE_SIZE - WORD_SIZE);
+  word offset = FlashRegistry::offset(output_.cursor());
+  if (offset < 0 || offset + output_byte_size > FlashRegistry::allocations_size()) FAIL(OUT_OF_BOUNDS);
+
+  // Bytes only count as written once they are in the partial chunk or in
+  // flash. If writing a chunk fails, the caller can resume from `written`.
+  if (partial_fill_ > 0) {
+    word missing = Utils::min<word>(CHUNK_BYTE_SIZE - partial_fill_, length);
+    memcpy(&partial_[partial_fill_], data, missing);
+    if (partial_fill_ + missing < CHUNK_BYTE_SIZE) {
+      partial_fill_ += missing;
+      accept(data, missing);
+      return null;
+    }
+    Object* error = write_image_chunk(process, &output_, reinterpret_cast<const word*>(partial_), ImageOutputStream::CHUNK_SIZE);
+    if (error) return error;
+    partial_fill_ = 0;
+    accept(data, missing);
+    data += missing;
+    length -= missing;
+  }
+  while (length >= CHUNK_BYTE_SIZE) {
+    Object* error = write_image_chunk(process, &output_, reinterpret_cast<const word*>(data), ImageOutputStream::CHUNK_SIZE);
+    if (error) return error;
+    accept(data, CHUNK_BYTE_SIZE);
+    data += CHUNK_BYTE_SIZE;
+    length -= CHUNK_BYTE_SIZE;
+  }
+  memcpy(partial_, data, length);
+  partial_fill_ = length;
+  accept(data, length);
   return null;
 }
 
 PRIMITIVE(writer_write) {
-  ARGS(ImageOutputStream, output, Blob, content_bytes, int, from, int, to);
+  ARGS(ImageWriter, writer, Blob, content_bytes, int, from, int, to);
   if (to < from || from < 0) FAIL(INVALID_ARGUMENT);
   if (to > content_bytes.length()) FAIL(OUT_OF_BOUNDS);
-  const word* data = reinterpret_cast<const word*>(content_bytes.address() + from);
-  int length = (to - from) / WORD_SIZE;
-  Object* error = write_image_chunk(process, output, data, length);
+  Object* error = writer->write(process, content_bytes.address() + from, to - from);
   return error ? error : process->null_object();
 }
 
+PRIMITIVE(writer_written) {
+  ARGS(ImageWriter, writer);
+  return Primitive::integer(writer->written(), process);
+}
+
+PRIMITIVE(writer_digest) {
+  ARGS(ImageWriter, writer);
+  ByteArray* result = process->allocate_byte_array(Sha::HASH_LENGTH_256);
+  if (result == null) FAIL(ALLOCATION_FAILED);
+  writer->digest(ByteArray::Bytes(result).address());
+  return result;
+}
+
 PRIMITIVE(writer_commit) {
-  ARGS(ImageOutputStream, output, Blob, metadata_blob);
+  ARGS(ImageWriter, writer, Blob, metadata_blob);
   uint8 metadata[FlashAllocation::Header::METADATA_SIZE];
   if (metadata_blob.length() != sizeof(metadata)) FAIL(INVALID_ARGUMENT);
   memcpy(metadata, metadata_blob.address(), sizeof(metadata));
 
+  if (writer->has_partial_chunk()) FAIL(OUT_OF_BOUNDS);
+  ImageOutputStream* output = writer->output();
   ProgramImage image = output->image();
   if (!image.is_valid() || output->cursor() != image.end()) FAIL(OUT_OF_BOUNDS);
 
@@ -124,9 +225,9 @@ PRIMITIVE(writer_commit) {
 }
 
 PRIMITIVE(writer_close) {
-  ARGS(ImageOutputStream, output);
-  delete output;
-  output_proxy->clear_external_address();
+  ARGS(ImageWriter, writer);
+  delete writer;
+  writer_proxy->clear_external_address();
   return process->null_object();
 }
 
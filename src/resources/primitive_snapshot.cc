@@ -59,7 +59,7 @@ PRIMITIVE(launch) {
   ProcessGroup* process_group = ProcessGroup::create(gid, program, image.memory());
   ASSERT(process_group);  // Allocations only fail on devices.
 
-  initial_memory_manager.global_variables = program->global_variables.copy();
+  initial_memory_manager.global_variables = GlobalVariables::create(program);
   ASSERT(initial_memory_manager.global_variables);
 
   // We don't use snapshots on devices so we assume malloc/new cannot fail.
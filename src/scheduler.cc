@@ -38,7 +38,18 @@ namespace toit {
 // returning to the scheduler.
 static const int64 PROCESS_MAX_RUN_TIME_US = 10 * 1000 * 1000;
 
+// Returns whether a process with the given priority and deadline should run
+// before the other process.
+static bool is_more_urgent(uint8 priority, int64 deadline, Process* other) {
+  if (priority != other->priority()) return priority > other->priority();
+  return deadline < other->deadline();
+}
+
 void SchedulerThread::entry() {
+  if (Flags::cpu_affinity || Flags::numa) {
+    OS::set_thread_affinity(core_);
+  }
+  if (Flags::numa) numa_node_ = OS::current_numa_node();
   scheduler_->run(this);
 }
 
@@ -78,14 +89,14 @@ Scheduler::~Scheduler() {
   OS::dispose(mutex_);
 }
 
-SystemMessage* Scheduler::new_process_message(SystemMessage::Type type, int gid) {
+SystemMessage* Scheduler::new_process_message(SystemMessage::Type type, int gid, int value) {
   uint8* data = unvoid_cast<uint8*>(malloc(MESSAGING_PROCESS_MESSAGE_SIZE));
   if (data == NULL) return NULL;
 
   // We must encode a proper message in the data. Otherwise, we cannot free it
   // later without running into issues when we traverse the data to find pointers
   // to external memory areas.
-  MessageEncoder::encode_process_message(data, 0);  // Does not take over data.
+  MessageEncoder::encode_process_message(data, value);  // Does not take over data.
 
   SystemMessage* result = _new SystemMessage(type, gid, -1, data);  // Takes over data.
   if (result == null) {
@@ -107,7 +118,7 @@ Process* Scheduler::new_boot_process(Locker& locker, Program* program, int group
 
   ProcessGroup* group = ProcessGroup::create(group_id, program);
   SystemMessage* termination = new_process_message(SystemMessage::TERMINATED, group_id);
-  manager.global_variables = program->global_variables.copy();
+  manager.global_variables = GlobalVariables::create(program);
   ASSERT(manager.global_variables);  // Booting system.
   Process* process = _new Process(program, group, termination, &manager);
   ASSERT(process);
@@ -201,6 +212,7 @@ Scheduler::ExitState Scheduler::launch_program(Locker& locker, Process* process)
       // their process has been deleted.
       delete process;
     }
+    delete_parked_processes(locker, group, 0);
     delete group;
   }
 
@@ -298,6 +310,10 @@ scheduler_err_t Scheduler::send_system_message(Locker& locker, SystemMessage* me
       // Do nothing. With no boot process, we don't care about newly spawned processes.
       break;
     }
+    case SystemMessage::QUOTA_EXCEEDED: {
+      // Do nothing. The group is throttled anyway.
+      break;
+    }
     default:
       FATAL("unhandled system message %d", message->type());
   }
@@ -358,6 +374,81 @@ int Scheduler::spawn(Program* program, ProcessGroup* process_group, int priority
   return pid;
 }
 
+int Scheduler::spawn_parked(ProcessGroup* process_group, int priority, Method method, MessageEncoder* arguments) {
+  Locker locker(mutex_);
+  if (process_group->parked_count() == 0) return INVALID_PROCESS_ID;
+
+  SystemMessage* spawned = new_process_message(SystemMessage::SPAWNED, process_group->id());
+  if (!spawned) return INVALID_PROCESS_ID;
+
+  // The parked process is fully set up, so it just needs the arguments.
+  Process* process = process_group->unpark();
+  process_group->add(process);
+  process->set_spawn_method(method);
+  process->set_spawn_arguments(arguments->take_buffer());  // Neuters the encoder.
+
+  int pid = process->id();
+  spawned->set_pid(pid);
+  send_system_message(locker, spawned);
+  if (priority != -1) process->set_target_priority(priority);
+  add_process(locker, process);
+  return pid;
+}
+
+bool Scheduler::set_spawn_pool_size(Process* process, int size) {
+  ProcessGroup* group = process->group();
+  Program* program = process->program();
+  { Locker locker(mutex_);
+    group->set_spawn_pool_size(size);
+    delete_parked_processes(locker, group, size);
+  }
+  while (true) {
+    { Locker locker(mutex_);
+      if (!group->needs_parked_process()) return true;
+    }
+    // Allocation takes the memory lock which must happen without holding
+    // the scheduler lock.
+    InitialMemoryManager initial_memory;
+    if (!initial_memory.allocate()) return false;
+    initial_memory.global_variables = GlobalVariables::create(program);
+    if (!initial_memory.global_variables) return false;
+    Locker locker(mutex_);
+    if (!park_process(locker, program, group, &initial_memory)) return false;
+  }
+}
+
+bool Scheduler::park_process(Locker& locker, Program* program, ProcessGroup* group, InitialMemoryManager* initial_memory) {
+  SystemMessage* termination = new_process_message(SystemMessage::TERMINATED, group->id());
+  if (!termination) return false;
+
+  // Takes over the initial_memory. The spawn method is only known once the
+  // process is taken out of the pool.
+  Process* process = _new Process(program, group, termination, Method::invalid(), initial_memory);
+  if (!process) {
+    delete termination;
+    return false;
+  }
+
+  Interpreter interpreter;
+  interpreter.activate(process);
+  interpreter.prepare_process();
+  interpreter.deactivate();
+
+  // The process added itself to the group when it was constructed.
+  group->remove(process);
+  group->park(process);
+  return true;
+}
+
+void Scheduler::delete_parked_processes(Locker& locker, ProcessGroup* group, int keep) {
+  while (group->parked_count() > keep) {
+    Process* process = group->unpark();
+    // Deleting processes takes the TLS lock.
+    Unlocker unlock(locker);
+    delete process;
+  }
+}
+
 void Scheduler::new_process(Locker& locker, Process* process) {
   Interpreter interpreter;
   interpreter.activate(process);
@@ -392,13 +483,7 @@ void Scheduler::run(SchedulerThread* scheduler_thread) {
       continue;
     }
 
-    Process* process = null;
-    for (int i = 0; i < NUMBER_OF_READY_QUEUES; i++) {
-      ProcessListFromScheduler& ready_queue = ready_queue_[i];
-      if (ready_queue.is_empty()) continue;
-      process = ready_queue.remove_first();
-      break;
-    }
+    Process* process = next_ready_process(locker, scheduler_thread);
     ASSERT(process->state() == Process::SCHEDULED);
 
     if (has_ready_processes(locker)) {
@@ -417,6 +502,36 @@ void Scheduler::run(SchedulerThread* scheduler_thread) {
   OS::signal(has_threads_);
 }
 
+Process* Scheduler::next_ready_process(Locker& locker, SchedulerThread* scheduler_thread) {
+  for (int i = 0; i < NUMBER_OF_READY_QUEUES; i++) {
+    ProcessListFromScheduler& ready_queue = ready_queue_[i];
+    if (ready_queue.is_empty()) continue;
+    Process* first = ready_queue.first();
+    int node = scheduler_thread->numa_node();
+    if (node < 0 || first->numa_node() < 0 || first->numa_node() == node || first->numa_passed_over()) {
+      first->set_numa_passed_over(false);
+      return ready_queue.remove_first();
+    }
+    // Prefer a process that last ran on the node of this thread, so it
+    // finds its heap in local memory. We only look at the next few
+    // processes that are as urgent as the first one, and we pass over
+    // the first one at most once, so it doesn't starve.
+    int looked_at = 0;
+    for (Process* process : ready_queue) {
+      if (process->deadline() != first->deadline()) break;
+      if (looked_at++ == NUMA_LOOKAHEAD) break;
+      if (process->numa_node() == node) {
+        first->set_numa_passed_over(true);
+        ready_queue.remove(process);
+        return process;
+      }
+    }
+    return ready_queue.remove_first();
+  }
+  UNREACHABLE();
+  return null;
+}
+
 bool Scheduler::is_running(const Program* program) {
   Locker locker(mutex_);
   for (ProcessGroup* group : groups_) {
@@ -502,7 +617,12 @@ void Scheduler::gc(Process* process, bool malloc_failed, bool try_hard) {
     }
 
     for (Process* target : targets) {
+      // Keep the heap of the target on the NUMA node it runs on, even
+      // though we collect it from this thread.
+      int node = target->numa_node();
+      if (node >= 0) OS::set_thread_numa_node(node);
       GcType type = target->gc(try_hard);
+      if (node >= 0) OS::set_thread_numa_node(-1);
       if (type != NEW_SPACE_GC) {
         Locker locker(mutex_);
         target->set_idle_since_gc(true);
@@ -567,8 +687,53 @@ Object* Scheduler::process_stats(Array* array, int group_id, int process_id, Pro
   info.largest_free_block = Smi::MAX_SMI_VALUE;
 #endif
   uword max = Smi::MAX_SMI_VALUE;
+  // Include the time slices the processes are in the middle of. Use the
+  // same time for the process and its group, so the process never appears
+  // to have used more CPU time than its group.
+  int64 now = OS::get_monotonic_time();
   switch (length) {
     default:
+    case 19: {
+      Object* total = Primitive::integer(subject_process->object_heap()->deduplicated_bytes(), calling_process);
+      if (Primitive::is_error(total)) return total;
+      array->at_put(18, total);
+    }
+      [[fallthrough]];
+    case 18:
+      array->at_put(17, Smi::from(subject_process->object_heap()->interned_strings()));
+      [[fallthrough]];
+    case 17: {
+      Object* total = Primitive::integer(group->bytes_allocated(), calling_process);
+      if (Primitive::is_error(total)) return total;
+      array->at_put(16, total);
+    }
+      [[fallthrough]];
+    case 16: {
+      int64 cpu_time_us = group->cpu_time_us();
+      for (Process* process : group->processes()) cpu_time_us += process->run_time_us(now);
+      Object* total = Primitive::integer(cpu_time_us, calling_process);
+      if (Primitive::is_error(total)) return total;
+      array->at_put(15, total);
+    }
+      [[fallthrough]];
+    case 15: {
+      int64 cpu_time_us = subject_process->cpu_time_us() + subject_process->run_time_us(now);
+      Object* total = Primitive::integer(cpu_time_us, calling_process);
+      if (Primitive::is_error(total)) return total;
+      array->at_put(14, total);
+    }
+      [[fallthrough]];
+    case 14:
+      array->at_put(13, Smi::from(subject_process->numa_migrations()));
+      [[fallthrough]];
+    case 13:
+      array->at_put(12, Smi::from(subject_process->numa_node()));
+      [[fallthrough]];
+    case 12: {
+      GlobalVariables* globals = subject_process->object_heap()->global_variables();
+      array->at_put(11, Smi::from(globals == null ? 0 : globals->memory_usage()));
+    }
+      [[fallthrough]];
     case 11:
       array->at_put(10, Smi::from(subject_process->gc_count(COMPACTING_GC)));
       [[fallthrough]];
@@ -614,7 +779,9 @@ Object* Scheduler::process_stats(Array* array, int group_id, int process_id, Pro
 void Scheduler::run_process(Locker& locker, Process* process, SchedulerThread* scheduler_thread) {
   wait_for_any_gc_to_complete(locker, process, Process::RUNNING);
   process->set_scheduler_thread(scheduler_thread);
-  process->set_run_timestamp(OS::get_monotonic_time());
+  int64 run_start = OS::get_monotonic_time();
+  process->set_run_timestamp(run_start);
+  process->set_numa_node(scheduler_thread->numa_node());
   scheduler_thread->unpin();
 
   ProcessRunner* runner = process->runner();
@@ -647,6 +814,8 @@ void Scheduler::run_process(Locker& locker, Process* process, SchedulerThread* s
 
   process->clear_run_timestamp();
   process->set_scheduler_thread(null);
+  int64 now = OS::get_monotonic_time();
+  account(locker, process, now, now - run_start);
 
   while (result.state() != Interpreter::Result::TERMINATED) {
     uint32 signals = process->signals();
@@ -696,21 +865,39 @@ void Scheduler::run_process(Locker& locker, Process* process, SchedulerThread* s
 
       int id = process->id();
       ProcessGroup* group = process->group();
+      int group_id = group->id();
+      Program* program = process->program();
       bool last_in_group = !group->remove(process);
       ASSERT(group->lookup(id) == null);
       SystemMessage* message = process->take_termination_message(result.value());
 
+      // If the group keeps a pool of parked processes, the terminated process
+      // is replaced by a clean one that reuses parts of its memory.
+      InitialMemoryManager recycled;
+      bool refill = !last_in_group && program != null && group->needs_parked_process();
+      if (refill) process->object_heap()->recycle_initial_memory(&recycled);
+
       // Deleting processes might need to take the event source lock, so we have
       // to unlock the scheduler to not get into a deadlock with the delivery of
       // an asynchronous event that needs to call [process_ready] and thus also
       // take the scheduler lock.
       { Unlocker unlock(locker);
         delete process;
+        // Allocation takes the memory lock.
+        if (refill) refill = recycled.allocate();
       }
 
       num_processes_--;
       if (process == boot_process_) boot_process_ = null;
 
+      // Processes serving requests from the terminated process no longer
+      // need its priority.
+      for (ProcessGroup* group : groups_) {
+        for (Process* p : group->processes()) {
+          if (p->release_inherited_priorities(id)) reschedule(locker, p);
+        }
+      }
+
       // Send the termination message after having deleted the process. This ensures
       // that the message for the boot process will not be assumed to be handled by
       // the boot process that is going away.
@@ -722,8 +909,15 @@ void Scheduler::run_process(Locker& locker, Process* process, SchedulerThread* s
       }
 
       if (last_in_group) {
+        delete_parked_processes(locker, group, 0);
         group->unlink();
         delete group;
+      } else if (refill) {
+        // The group may have terminated while we didn't hold the lock.
+        group = find_group(locker, group_id);
+        if (group != null && group->needs_parked_process()) {
+          park_process(locker, program, group, &recycled);
+        }
       }
       break;
     }
@@ -739,7 +933,7 @@ void Scheduler::run_process(Locker& locker, Process* process, SchedulerThread* s
 int Scheduler::get_priority(int pid) {
   Locker locker(mutex_);
   Process* process = find_process(locker, pid);
-  return process ? process->priority() : -1;
+  return process ? process->target_priority() : -1;
 }
 
 bool Scheduler::set_priority(int pid, uint8 priority) {
@@ -750,8 +944,73 @@ bool Scheduler::set_priority(int pid, uint8 priority) {
   return true;
 }
 
+bool Scheduler::get_deadline(int pid, int64* deadline) {
+  Locker locker(mutex_);
+  Process* process = find_process(locker, pid);
+  if (!process) return false;
+  *deadline = process->target_deadline();
+  return true;
+}
+
+bool Scheduler::set_deadline(int pid, int64 deadline) {
+  Locker locker(mutex_);
+  Process* process = find_process(locker, pid);
+  if (!process) return false;
+  update_deadline(locker, process, deadline);
+  return true;
+}
+
+bool Scheduler::get_effective_priority(int pid, uint8* priority, int64* deadline) {
+  Locker locker(mutex_);
+  Process* process = find_process(locker, pid);
+  if (!process) return false;
+  process->compute_priority(priority, deadline);
+  return true;
+}
+
+void Scheduler::rpc_request(Process* sender, int target_id, int id, int64 deadline) {
+  Locker locker(mutex_);
+  Process* target = (target_id >= 0) ? find_process(locker, target_id) : boot_process_;
+  if (target == null || target == sender) return;
+  // The sender may have changed its priority or deadline since it was
+  // scheduled, so we use the values it runs with the next time.
+  uint8 priority;
+  int64 sender_deadline;
+  sender->compute_priority(&priority, &sender_deadline);
+  if (sender_deadline < deadline) deadline = sender_deadline;
+  if (target->inherit_priority(sender->id(), id, priority, deadline)) {
+    reschedule(locker, target);
+  }
+}
+
+void Scheduler::rpc_cancel(Process* sender, int target_id, int id) {
+  Locker locker(mutex_);
+  Process* target = (target_id >= 0) ? find_process(locker, target_id) : boot_process_;
+  if (target == null) return;
+  if (target->release_inherited_priority(sender->id(), id)) {
+    reschedule(locker, target);
+  }
+}
+
+void Scheduler::rpc_reply(Process* sender, int target_id, int id) {
+  Locker locker(mutex_);
+  if (sender->release_inherited_priority(target_id, id)) {
+    reschedule(locker, sender);
+  }
+}
+
 void Scheduler::update_priority(Locker& locker, Process* process, uint8 priority) {
   process->set_target_priority(priority);
+  reschedule(locker, process);
+}
+
+void Scheduler::update_deadline(Locker& locker, Process* process, int64 deadline) {
+  process->set_target_deadline(deadline);
+  reschedule(locker, process);
+}
+
+void Scheduler::reschedule(Locker& locker, Process* process) {
+  if (!process->has_priority_update()) return;
   if (process->state() == Process::RUNNING) {
     process->signal(Process::PREEMPT);
   } else if (process->state() == Process::SCHEDULED) {
@@ -761,6 +1020,69 @@ void Scheduler::update_priority(Locker& locker, Process* process, uint8 priority
   }
 }
 
+bool Scheduler::set_quota(int group_id, int64 cpu_time_us, int64 allocation) {
+  Locker locker(mutex_);
+  ProcessGroup* group = find_group(locker, group_id);
+  if (group == null) return false;
+  group->cpu_quota_us_ = cpu_time_us < 0 ? -1 : cpu_time_us;
+  group->allocation_quota_ = allocation < 0 ? -1 : allocation;
+  // Start a new period with the new quotas.
+  group->period_start_ = OS::get_monotonic_time();
+  group->period_cpu_time_us_ = 0;
+  group->period_bytes_allocated_ = 0;
+  if (group->is_throttled()) set_throttled(locker, group, false, null);
+  return true;
+}
+
+void Scheduler::account(Locker& locker, Process* process, int64 now, int64 cpu_time_us) {
+  // External processes don't allocate on a Toit heap.
+  int64 bytes = (process->program() == null) ? 0 : process->take_allocation_delta();
+  process->add_cpu_time(cpu_time_us);
+  ProcessGroup* group = process->group();
+  group->cpu_time_us_ += cpu_time_us;
+  group->bytes_allocated_ += bytes;
+  if (!group->has_quota()) return;
+
+  update_quota_period(locker, group, now);
+  group->period_cpu_time_us_ += cpu_time_us;
+  group->period_bytes_allocated_ += bytes;
+  if (group->is_throttled()) return;
+
+  int exceeded;
+  if (group->cpu_quota_us_ >= 0 && group->period_cpu_time_us_ > group->cpu_quota_us_) {
+    exceeded = QUOTA_CPU_TIME;
+  } else if (group->allocation_quota_ >= 0 && group->period_bytes_allocated_ > group->allocation_quota_) {
+    exceeded = QUOTA_ALLOCATION;
+  } else {
+    return;
+  }
+  // The process is between two time slices, and it picks up its new
+  // priority when it is ready to run again.
+  set_throttled(locker, group, true, process);
+
+  SystemMessage* message = new_process_message(SystemMessage::QUOTA_EXCEEDED, group->id(), exceeded);
+  if (message == null) return;  // The group is throttled anyway.
+  message->set_pid(process->id());
+  if (send_system_message(locker, message) != MESSAGE_OK) {
+    delete message;
+  }
+}
+
+void Scheduler::update_quota_period(Locker& locker, ProcessGroup* group, int64 now) {
+  if (now - group->period_start_ < QUOTA_PERIOD_US) return;
+  group->period_start_ = now;
+  group->period_cpu_time_us_ = 0;
+  group->period_bytes_allocated_ = 0;
+  if (group->is_throttled()) set_throttled(locker, group, false, null);
+}
+
+void Scheduler::set_throttled(Locker& locker, ProcessGroup* group, bool throttled, Process* except) {
+  group->throttled_ = throttled;
+  for (Process* process : group->processes()) {
+    if (process != except) reschedule(locker, process);
+  }
+}
+
 void Scheduler::gc_suspend_process(Locker& locker, Process* process) {
   ASSERT(process->state() != Process::RUNNING);  // Preempt the process first.
   ASSERT(process->state() != Process::SUSPENDED_AWAITING_GC);
@@ -802,9 +1124,10 @@ SchedulerThread* Scheduler::start_thread(Locker& locker) {
   // other threads. This should be enough, and should ensure that allocation
   // does not fail. On other platforms we assume that allocation will
   // not fail.
-  SchedulerThread* new_thread = _new SchedulerThread(this);
+  int core = num_threads_;
+  SchedulerThread* new_thread = _new SchedulerThread(this, core);
   if (new_thread == null) FATAL("OS thread spawn failed");
-  int core = num_threads_++;
+  num_threads_++;
   threads_.prepend(new_thread);
   // TODO(kasper): Try to get back to only using 4KB for the stacks. We
   // bumped the limit to support SD card mounting on ESP32.
@@ -834,7 +1157,17 @@ void Scheduler::process_ready(Locker& locker, Process* process) {
   }
 
   uint8 priority = process->update_priority();
-  ready_queue(priority).append(process);
+  int64 deadline = process->deadline();
+  ProcessListFromScheduler& queue = ready_queue(priority);
+  if (deadline == Process::NO_DEADLINE) {
+    queue.append(process);
+  } else {
+    // Earliest deadline first. Processes with the same deadline run in
+    // the order they became ready.
+    queue.insert_before(process, [deadline](Process* other) {
+      return deadline < other->deadline();
+    });
+  }
 
   // If all scheduler threads are busy running code, we preempt
   // the lowest priority process unless it is more important
@@ -857,7 +1190,7 @@ void Scheduler::process_ready(Locker& locker, Process* process) {
     // If a process is external we cannot preempt it.
     if (process->program() == null) continue;
     // If we already have a better candidate, we skip this one.
-    if (lowest && process->priority() >= lowest_priority) continue;
+    if (lowest && !is_more_urgent(lowest_priority, lowest->deadline(), process)) continue;
     lowest = process;
     lowest_priority = process->priority();
     lowest_thread = thread;
@@ -867,7 +1200,7 @@ void Scheduler::process_ready(Locker& locker, Process* process) {
   SchedulerThread* extra_thread = start_thread(locker);
   if (extra_thread) {
     extra_thread->pin();
-  } else if (lowest && lowest_priority < priority) {
+  } else if (lowest && is_more_urgent(priority, deadline, lowest)) {
     lowest_thread->pin();
     lowest->signal(Process::PREEMPT);
   }
@@ -900,6 +1233,10 @@ void Scheduler::tick(Locker& locker, int64 now) {
 
   bool any_profiling = num_profiled_processes_ > 0;
 
+  for (ProcessGroup* group : groups_) {
+    if (group->has_quota()) update_quota_period(locker, group, now);
+  }
+
   for (SchedulerThread* thread : threads_) {
     Process* process = thread->interpreter()->process();
     if (process == null) continue;
@@ -939,7 +1276,19 @@ void Scheduler::tick(Locker& locker, int64 now) {
     int ready_queue_index = compute_ready_queue_index(process->priority());
     bool is_profiling = any_profiling && process->profiler() != null;
     bool has_run_too_long = run_time_us > PROCESS_MAX_RUN_TIME_US / 2;
-    if (has_run_too_long || is_profiling || ready_queue_index >= first_non_empty_ready_queue) {
+    // A process that uses up the CPU time quota of its group ends its
+    // time slice, so we can account for it and throttle the group.
+    ProcessGroup* group = process->group();
+    bool has_used_quota = group->cpu_quota_us() >= 0 && !group->is_throttled() &&
+        group->period_cpu_time_us() + run_time_us > group->cpu_quota_us();
+    bool is_waiting_for_turn = ready_queue_index > first_non_empty_ready_queue;
+    if (ready_queue_index == first_non_empty_ready_queue) {
+      // Processes in the same ready queue take turns, unless the running
+      // process has an earlier deadline than all the waiting ones.
+      Process* next = ready_queue_[ready_queue_index].first();
+      is_waiting_for_turn = !(process->deadline() < next->deadline());
+    }
+    if (has_run_too_long || has_used_quota || is_profiling || is_waiting_for_turn) {
       process->signal(Process::PREEMPT);
     }
   }
@@ -973,6 +1322,13 @@ Process* Scheduler::find_process(Locker& locker, int pid) {
   return null;
 }
 
+ProcessGroup* Scheduler::find_group(Locker& locker, int group_id) {
+  for (ProcessGroup* group : groups_) {
+    if (group->id() == group_id) return group;
+  }
+  return null;
+}
+
 void Scheduler::iterate_process_chunks(void* context, process_chunk_callback_t* callback) {
   Locker locker(mutex_);
   for (ProcessGroup* group : groups_) {
@@ -35,9 +35,10 @@ enum scheduler_err_t : int {
 
 class SchedulerThread : public Thread, public SchedulerThreadList::Element {
  public:
-  explicit SchedulerThread(Scheduler* scheduler)
+  SchedulerThread(Scheduler* scheduler, int core)
       : Thread("Toit")
-      , scheduler_(scheduler) {}
+      , scheduler_(scheduler)
+      , core_(core) {}
 
   ~SchedulerThread() {}
 
@@ -49,10 +50,16 @@ class SchedulerThread : public Thread, public SchedulerThreadList::Element {
   void pin() { is_pinned_ = true; }
   void unpin() { is_pinned_ = false; }
 
+  // The NUMA node this thread runs on, or -1 if we don't schedule
+  // processes by node.
+  int numa_node() const { return numa_node_; }
+
  private:
   Scheduler* const scheduler_;
+  int const core_;
   Interpreter interpreter_;
   bool is_pinned_ = false;
+  int numa_node_ = -1;
 };
 
 class Scheduler {
@@ -118,6 +125,16 @@ class Scheduler {
   int spawn(Program* program, ProcessGroup* process_group, int priority,
             Method method, MessageEncoder* arguments, InitialMemoryManager* initial_memory);
 
+  // Starts a parked process of the group, if there is one. Takes over the
+  // arguments on success. Returns INVALID_PROCESS_ID if the pool is empty.
+  int spawn_parked(ProcessGroup* process_group, int priority, Method method, MessageEncoder* arguments);
+
+  // Keeps the given number of processes parked in the group of the process,
+  // so they can be started without allocating. When a process of the group
+  // terminates its heap mutex and global variables are reused to refill the
+  // pool. Returns false if the processes couldn't be allocated.
+  bool set_spawn_pool_size(Process* process, int size);
+
   // Returns a new process id (only called from Process constructor).
   int next_process_id();
   int next_group_id();
@@ -143,10 +160,40 @@ class Scheduler {
   void activate_profiler(Process* process) { notify_profiler(1); }
   void deactivate_profiler(Process* process) { notify_profiler(-1); }
 
-  // Process priority support.
+  // Process priority support. The priority is the one that was assigned
+  // to the process.
   int get_priority(int pid);
   bool set_priority(int pid, uint8 priority);
 
+  // Process deadline support. Returns false if there is no such process.
+  bool get_deadline(int pid, int64* deadline);
+  bool set_deadline(int pid, int64 deadline);
+
+  // The priority and the deadline a process runs with, including the ones
+  // it inherits from RPC callers. Returns false if there is no such process.
+  bool get_effective_priority(int pid, uint8* priority, int64* deadline);
+
+  // Keeps track of the RPC requests the sender has outstanding with other
+  // processes, so the receiver of a request can inherit the priority and
+  // the deadline of the sender until it replies. The request is identified
+  // by its id. A negative target id is the system process.
+  void rpc_request(Process* sender, int target_id, int id, int64 deadline);
+  void rpc_cancel(Process* sender, int target_id, int id);
+  void rpc_reply(Process* sender, int target_id, int id);
+
+  // Process group quota support. Limits the CPU time and the bytes the
+  // group allocates per quota period. Negative quotas don't limit
+  // anything. Returns false if there is no such group.
+  bool set_quota(int group_id, int64 cpu_time_us, int64 allocation);
+
+  // The quota that a group exceeded, sent as the value of the
+  // QUOTA_EXCEEDED system message.
+  enum QuotaKind {
+    QUOTA_CPU_TIME = 0,
+    QUOTA_ALLOCATION = 1,
+  };
+  static const int64 QUOTA_PERIOD_US = 1000 * 1000;  // 1 s.
+
   // Primitive support.
 
   // Fills in an array with stats for the process with the given ids.
@@ -166,10 +213,19 @@ class Scheduler {
   void new_process(Locker& locker, Process* process);
   void add_process(Locker& locker, Process* process);
   void run_process(Locker& locker, Process* process, SchedulerThread* scheduler_thread);
+  Process* next_ready_process(Locker& locker, SchedulerThread* scheduler_thread);
 
   // Update the priority of a process. This may cause preemption of the process
   // or it may move the process to another ready queue.
   void update_priority(Locker& locker, Process* process, uint8 value);
+  void update_deadline(Locker& locker, Process* process, int64 value);
+  void reschedule(Locker& locker, Process* process);
+
+  // Accounts for the CPU time and the allocations of a time slice of
+  // the process, and throttles its group if it exceeds a quota.
+  void account(Locker& locker, Process* process, int64 now, int64 cpu_time_us);
+  void update_quota_period(Locker& locker, ProcessGroup* group, int64 now);
+  void set_throttled(Locker& locker, ProcessGroup* group, bool throttled, Process* except);
 
   // Profiler support.
   void notify_profiler(int change);
@@ -200,9 +256,16 @@ class Scheduler {
   Scheduler::ExitState launch_program(Locker& locker, Process* process);
 
   Process* find_process(Locker& locker, int pid);
+  ProcessGroup* find_group(Locker& locker, int group_id);
+
+  // Sets up a process for the program and parks it in the group.
+  // Takes over the initial memory on success.
+  bool park_process(Locker& locker, Program* program, ProcessGroup* group, InitialMemoryManager* initial_memory);
+  // Deletes parked processes of the group until at most `keep` are left.
+  void delete_parked_processes(Locker& locker, ProcessGroup* group, int keep);
 
   Process* new_boot_process(Locker& locker, Program* program, int group_id);
-  SystemMessage* new_process_message(SystemMessage::Type type, int gid);
+  SystemMessage* new_process_message(SystemMessage::Type type, int gid, int value = 0);
 
   static const int TICK_PERIOD_US = 100 * 1000;          // 100 ms.
 #ifdef TOIT_FREERTOS
@@ -239,6 +302,9 @@ class Scheduler {
   int64 next_tick_ = 0;
 
   static const int NUMBER_OF_READY_QUEUES = 5;
+  // How many processes of a ready queue we look at to find one that ran
+  // on the same NUMA node as the scheduler thread.
+  static const int NUMA_LOOKAHEAD = 4;
   ProcessListFromScheduler ready_queue_[NUMBER_OF_READY_QUEUES];
 
   ProcessListFromScheduler& ready_queue(uint8 priority) {
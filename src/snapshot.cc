@@ -18,6 +18,8 @@
 #include <stdio.h>
 
 #include "snapshot.h"
+#include "snapshot_compression.h"
+#include "flags.h"
 #include "objects_inline.h"
 #include "program_heap.h"
 #include "os.h"
@@ -425,7 +427,8 @@ using WorkAroundMap = BinaryTreeMap<V>;
 class ImageSnapshotReader : public SnapshotReader {
  public:
   ImageSnapshotReader(const uint8* buffer, int length)
-    : SnapshotReader(buffer, length, &image_allocator_) {}
+    : SnapshotReader(buffer, length, &image_allocator_)
+    , input_length_(length) {}
 
   // Reads the snapshot.
   ProgramImage read_image(const uint8* id);
@@ -436,6 +439,7 @@ class ImageSnapshotReader : public SnapshotReader {
  private:
   ImageAllocator image_allocator_;
   Program* program_ = null;
+  int const input_length_;
 };
 
 class BaseSnapshotWriter : public SnapshotWriter {
@@ -563,10 +567,34 @@ SnapshotReader::SnapshotReader(const uint8* buffer, int length, SnapshotAllocato
     , snapshot_size_(0)
     , index_(0)
     , pos_(0)
-    , table_(null) {}
+    , table_(null) {
+  if (CompressedSnapshot::is_compressed(buffer, length)) {
+    compressed_ = _new CompressedSnapshot(buffer, length);
+    block_buffer_ = unvoid_cast<uint8*>(malloc(CompressedSnapshot::BLOCK_SIZE));
+    if (compressed_ == null || block_buffer_ == null || !compressed_->is_valid()) {
+      FATAL("Invalid compressed snapshot");
+    }
+    // The first block is decoded when the first byte is read.
+    buffer_ = block_buffer_;
+    length_ = 0;
+  }
+}
 
 SnapshotReader::~SnapshotReader() {
   delete[] table_;
+  delete compressed_;
+  free(block_buffer_);
+}
+
+void SnapshotReader::read_next_block() {
+  if (compressed_ == null || next_block_ == compressed_->block_count()) {
+    FATAL("Unexpected end of snapshot");
+  }
+  int length = compressed_->decode_block(next_block_++, block_buffer_);
+  if (length < 0) FATAL("Corrupt compressed snapshot");
+  window_offset_ += length_;
+  length_ = length;
+  pos_ = 0;
 }
 
 bool SnapshotReader::initialize(int snapshot_size,
@@ -677,10 +705,21 @@ uint64 SnapshotReader::read_cardinal64() {
 }
 
 uint8 SnapshotReader::read_byte() {
-  ASSERT(pos_ < length_);
+  if (pos_ == length_) read_next_block();
   return buffer_[pos_++];
 }
 
+void SnapshotReader::read_bytes(uint8* destination, int length) {
+  while (length > 0) {
+    if (pos_ == length_) read_next_block();
+    int chunk = Utils::min(length, length_ - pos_);
+    memcpy(destination, &buffer_[pos_], chunk);
+    pos_ += chunk;
+    destination += chunk;
+    length -= chunk;
+  }
+}
+
 double SnapshotReader::read_double() {
   uint8 bytes[8];
   for (int i = 0; i < 8; i++) bytes[i] = read_byte();
@@ -813,8 +852,7 @@ List<uint8> SnapshotReader::read_external_list_uint8() {
   int length = read_int32();
   uint8* data = allocate_external_bytes(length);
   ASSERT(Utils::is_aligned(reinterpret_cast<uword>(data), WORD_SIZE));
-  memcpy(data, &buffer_[pos_], length);
-  pos_ += length;
+  read_bytes(data, length);
   return List<uint8>(data, length);
 }
 
@@ -901,6 +939,7 @@ ProgramImage ImageSnapshotReader::read_image(const uint8* id) {
   // allocator_ is an ImageAllocator
   //   which is a subclass of HeapAllocator
   //     which is a subset of SnapshotAllocator
+  int64 start_time = Flags::report_snapshot ? OS::get_monotonic_time() : 0;
   bool succeeded = read_header();
   ASSERT(succeeded);  // We expect to never run out of memory on the desktop.
   program_  = new (image_allocator_.memory()) Program(id, image_allocator_.image()->byte_size());
@@ -909,6 +948,13 @@ ProgramImage ImageSnapshotReader::read_image(const uint8* id) {
   image_allocator_.expand();
   program_->read(this);
   image_allocator_.image()->mark_read_only();
+  if (Flags::report_snapshot) {
+    printf("Loaded %s snapshot of %d bytes into a %zu byte image in %lld us\n",
+           is_compressed() ? "compressed" : "uncompressed",
+           input_length_,
+           image_allocator_.image()->byte_size(),
+           static_cast<long long>(OS::get_monotonic_time() - start_time));
+  }
 
   return ProgramImage(image_allocator_.image());
 }
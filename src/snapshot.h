@@ -113,6 +113,8 @@ class Snapshot {
   const int size_;
 };
 
+class CompressedSnapshot;
+
 class SnapshotAllocator {
  public:
   virtual bool initialize(int normal_block_count,
@@ -163,7 +165,7 @@ class SnapshotReader {
     class_bits_length_ = length;
   }
 
-  bool eos() { return pos_ == snapshot_size_; }
+  bool eos() { return window_offset_ + pos_ == snapshot_size_; }
 
  protected:
   Object* read_integer(bool is_negated);
@@ -174,6 +176,8 @@ class SnapshotReader {
   void read_object_header(SnapshotTypeTag* tag, int* extra);
   Object* read_heap_object();
 
+  bool is_compressed() const { return compressed_ != null; }
+
  private:
   HeapObject* allocate_object(TypeTag tag, int length);
   Object** allocate_external_pointers(int count);
@@ -181,8 +185,18 @@ class SnapshotReader {
   int32* allocate_external_int32s(int count);
   uint8* allocate_external_bytes(int count);
 
-  const uint8* const buffer_;
-  int const length_;
+  void read_bytes(uint8* destination, int length);
+  void read_next_block();
+
+  // The bytes that are currently being read. For compressed snapshots this
+  //   is the most recently decoded block, starting at [window_offset_] in the
+  //   uncompressed snapshot.
+  const uint8* buffer_;
+  int length_;
+  int window_offset_ = 0;
+  CompressedSnapshot* compressed_ = null;
+  uint8* block_buffer_ = null;
+  int next_block_ = 0;
   SnapshotAllocator* allocator_;
 
   int large_integer_id_;  // Set in `read_header`.
@@ -277,6 +291,13 @@ class ImageOutputStream {
 
   void write(const word* buffer, int size, word* output = null);
 
+  // Moves the cursor back to an earlier position, so the words after it
+  //   can be written again.
+  void rewind(void* cursor) {
+    ASSERT(image_.begin() <= cursor && cursor <= current_);
+    current_ = reinterpret_cast<word*>(cursor);
+  }
+
   ProgramImage image() const { return image_; }
 
   const uint8* program_id() const { return &program_id_[0]; }
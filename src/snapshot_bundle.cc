@@ -156,6 +156,15 @@ bool SnapshotBundle::uuid(uint8* buffer_16) const {
   return true;
 }
 
+bool SnapshotBundle::source_map(List<const uint8>* result) const {
+  ar::MemoryReader reader(buffer_, size_);
+  ar::File file;
+  int status = reader.find(SOURCE_MAP_NAME, &file);
+  if (status != 0) return false;
+  *result = List<const uint8>(file.content(), file.byte_size);
+  return true;
+}
+
 SnapshotBundle SnapshotBundle::stripped() const {
   List<uint8> snapshot_bytes;
   const char* sdk_version = null;
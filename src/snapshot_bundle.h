@@ -64,6 +64,10 @@ class SnapshotBundle {
   // UUID was not in the snapshot file.
   bool uuid(uint8* buffer_16) const;
 
+  // Returns the source map of the main snapshot. Returns false if the
+  // bundle has no source map, for example because it was stripped.
+  bool source_map(List<const uint8>* result) const;
+
   // Builds a snapshot bundle without debugging information.
   // The old and new bundle don't share any code, and this instance's
   // buffer can be safely freed.
@@ -0,0 +1,203 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "top.h"
+
+#ifndef TOIT_FREERTOS
+
+#include "snapshot_compression.h"
+#include "utils.h"
+
+namespace toit {
+
+static const int HASH_BITS = 12;
+
+CompressedSnapshot::CompressedSnapshot(const uint8* buffer, int length)
+    : buffer_(buffer)
+    , length_(length) {
+  if (length < HEADER_BYTE_SIZE) return;
+  uncompressed_size_ = Utils::read_unaligned_uint32_le(buffer + UINT32_SIZE);
+  block_count_ = Utils::read_unaligned_uint32_le(buffer + 3 * UINT32_SIZE);
+}
+
+bool CompressedSnapshot::is_compressed(const uint8* buffer, int length) {
+  return length >= HEADER_BYTE_SIZE && Utils::read_unaligned_uint32_le(buffer) == MAGIC;
+}
+
+bool CompressedSnapshot::is_valid() const {
+  if (!is_compressed(buffer_, length_)) return false;
+  if (Utils::read_unaligned_uint32_le(buffer_ + 2 * UINT32_SIZE) != BLOCK_SIZE) return false;
+  if (uncompressed_size_ < 0 || block_count_ < 0) return false;
+  if (block_count_ != Utils::round_up(uncompressed_size_, BLOCK_SIZE) / BLOCK_SIZE) return false;
+  if (data() > buffer_ + length_) return false;
+  word data_size = (buffer_ + length_) - data();
+  if (block_offset(0) != 0 || block_offset(block_count_) != data_size) return false;
+  // The blocks are decoded from the data between two consecutive offsets,
+  //   so every offset must be within the data and none may go backwards.
+  for (int i = 0; i < block_count_; i++) {
+    uint32 start = block_offset(i);
+    uint32 end = block_offset(i + 1);
+    if (end < start || end > data_size) return false;
+  }
+  return true;
+}
+
+uint32 CompressedSnapshot::block_offset(int index) const {
+  return Utils::read_unaligned_uint32_le(this->index() + index * UINT32_SIZE);
+}
+
+static int read_length(const uint8** from, const uint8* end, int length) {
+  if (length != 15) return length;
+  while (true) {
+    if (*from >= end) return -1;
+    uint8 byte = *(*from)++;
+    length += byte;
+    if (byte != 255) return length;
+  }
+}
+
+int CompressedSnapshot::decode_block(int index, uint8* destination) const {
+  ASSERT(0 <= index && index < block_count_);
+  int block_length = Utils::min(BLOCK_SIZE, uncompressed_size_ - index * BLOCK_SIZE);
+  uint32 start = block_offset(index);
+  uint32 end = block_offset(index + 1);
+  if (end < start) return -1;
+  const uint8* from = data() + start;
+  const uint8* from_end = data() + end;
+  if (from_end - from == block_length) {
+    memcpy(destination, from, block_length);
+    return block_length;
+  }
+  uint8* to = destination;
+  uint8* to_end = destination + block_length;
+  while (true) {
+    if (from >= from_end) return -1;
+    uint8 token = *from++;
+    int literals = read_length(&from, from_end, token >> 4);
+    if (literals < 0 || literals > from_end - from || literals > to_end - to) return -1;
+    memcpy(to, from, literals);
+    from += literals;
+    to += literals;
+    if (to == to_end) return block_length;
+    if (from_end - from < 2) return -1;
+    int offset = Utils::read_unaligned_uint16(from);
+    from += 2;
+    int match = read_length(&from, from_end, token & 0xf);
+    if (match < 0) return -1;
+    match += MIN_MATCH;
+    if (offset == 0 || offset > to - destination || match > to_end - to) return -1;
+    // The match may overlap the bytes it produces, so copy byte by byte.
+    const uint8* source = to - offset;
+    for (int i = 0; i < match; i++) to[i] = source[i];
+    to += match;
+  }
+}
+
+static uint8* write_length(uint8* to, int length) {
+  if (length < 15) return to;
+  length -= 15;
+  while (length >= 255) {
+    *to++ = 255;
+    length -= 255;
+  }
+  *to++ = length;
+  return to;
+}
+
+static inline int hash_four_bytes(const uint8* from) {
+  return (Utils::read_unaligned_uint32(from) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Returns the compressed size. The destination must have room for the
+// worst-case expansion of the block.
+int CompressedSnapshot::compress_block(const uint8* source, int length, uint8* destination) {
+  // Positions are stored plus one, so that zero means empty.
+  uint16 table[1 << HASH_BITS];
+  memset(table, 0, sizeof(table));
+  uint8* to = destination;
+  int literal_start = 0;
+  int pos = 0;
+  while (pos + MIN_MATCH <= length) {
+    int hash = hash_four_bytes(source + pos);
+    int candidate = table[hash] - 1;
+    table[hash] = pos + 1;
+    if (candidate < 0 ||
+        Utils::read_unaligned_uint32(source + candidate) != Utils::read_unaligned_uint32(source + pos)) {
+      pos++;
+      continue;
+    }
+    int match = MIN_MATCH;
+    while (pos + match < length && source[candidate + match] == source[pos + match]) match++;
+    int literals = pos - literal_start;
+    int match_nibble = match - MIN_MATCH;
+    *to++ = (Utils::min(literals, 15) << 4) | Utils::min(match_nibble, 15);
+    to = write_length(to, literals);
+    memcpy(to, source + literal_start, literals);
+    to += literals;
+    Utils::write_unaligned_uint16(to, pos - candidate);
+    to += 2;
+    to = write_length(to, match_nibble);
+    pos += match;
+    literal_start = pos;
+  }
+  int literals = length - literal_start;
+  *to++ = Utils::min(literals, 15) << 4;
+  to = write_length(to, literals);
+  memcpy(to, source + literal_start, literals);
+  to += literals;
+  return to - destination;
+}
+
+uint8* CompressedSnapshot::compress(const uint8* snapshot, int length, int* compressed_length) {
+  int block_count = Utils::round_up(length, BLOCK_SIZE) / BLOCK_SIZE;
+  int index_size = (block_count + 1) * UINT32_SIZE;
+  // Every block is at most BLOCK_SIZE bytes, as incompressible blocks are
+  // stored as is.
+  int capacity = HEADER_BYTE_SIZE + index_size + length;
+  uint8* result = unvoid_cast<uint8*>(malloc(capacity));
+  // Room for the worst-case expansion of a single block.
+  uint8* scratch = unvoid_cast<uint8*>(malloc(BLOCK_SIZE + BLOCK_SIZE / 255 + 16));
+  if (result == null || scratch == null) FATAL("Out of memory compressing snapshot");
+
+  Utils::write_unaligned_uint32_le(result, MAGIC);
+  Utils::write_unaligned_uint32_le(result + UINT32_SIZE, length);
+  Utils::write_unaligned_uint32_le(result + 2 * UINT32_SIZE, BLOCK_SIZE);
+  Utils::write_unaligned_uint32_le(result + 3 * UINT32_SIZE, block_count);
+  uint8* index = result + HEADER_BYTE_SIZE;
+  uint8* data = index + index_size;
+  int offset = 0;
+  for (int i = 0; i < block_count; i++) {
+    Utils::write_unaligned_uint32_le(index + i * UINT32_SIZE, offset);
+    const uint8* block = snapshot + i * BLOCK_SIZE;
+    int block_length = Utils::min(BLOCK_SIZE, length - i * BLOCK_SIZE);
+    int size = compress_block(block, block_length, scratch);
+    if (size < block_length) {
+      memcpy(data + offset, scratch, size);
+    } else {
+      size = block_length;
+      memcpy(data + offset, block, size);
+    }
+    offset += size;
+  }
+  Utils::write_unaligned_uint32_le(index + block_count * UINT32_SIZE, offset);
+  free(scratch);
+
+  *compressed_length = HEADER_BYTE_SIZE + index_size + offset;
+  return unvoid_cast<uint8*>(realloc(result, *compressed_length));
+}
+
+} // namespace toit
+
+#endif  // TOIT_FREERTOS
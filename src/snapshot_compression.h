@@ -0,0 +1,86 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+
+namespace toit {
+
+#ifndef TOIT_FREERTOS
+
+/// A block-compressed container for program snapshots.
+///
+/// The snapshot is split into blocks of BLOCK_SIZE bytes that are compressed
+///   independently with a small LZ77 codec in the style of LZ4. The block
+///   index at the start of the container gives random access to each block,
+///   so readers can decode one block at a time instead of inflating the
+///   whole snapshot up front.
+///
+/// Layout, all words being little-endian uint32s:
+///   magic, uncompressed size, block size, block count,
+///   block count + 1 offsets of the blocks, relative to the end of the index,
+///   the block data.
+/// A block is stored uncompressed if compression doesn't make it smaller.
+///   Such a block is recognized by its size.
+///
+/// Compressed blocks are sequences of a token byte, literals and a match.
+///   The high nibble of the token is the number of literals, the low nibble
+///   the length of the match minus MIN_MATCH. A nibble of 15 is followed by
+///   bytes that are added to the length until a byte is not 255. The match
+///   is a 16-bit little-endian offset back into the decoded block. The last
+///   sequence of a block has no match.
+class CompressedSnapshot {
+ public:
+  static const uint32 MAGIC = 70177030;
+  static const int BLOCK_SIZE = 16 * KB;
+  static const int HEADER_BYTE_SIZE = 4 * UINT32_SIZE;
+
+  CompressedSnapshot(const uint8* buffer, int length);
+
+  static bool is_compressed(const uint8* buffer, int length);
+
+  // Compresses the given snapshot. The returned buffer is malloced.
+  static uint8* compress(const uint8* snapshot, int length, int* compressed_length);
+
+  // Whether the header and block index are consistent with the length of the buffer.
+  bool is_valid() const;
+
+  int uncompressed_size() const { return uncompressed_size_; }
+  int block_count() const { return block_count_; }
+
+  // Decodes the block with the given index into [destination], which must have
+  //   room for BLOCK_SIZE bytes.
+  // Returns the number of decoded bytes, or -1 if the block is malformed.
+  int decode_block(int index, uint8* destination) const;
+
+ private:
+  static const int MIN_MATCH = 4;
+
+  const uint8* buffer_;
+  int length_;
+  int uncompressed_size_ = 0;
+  int block_count_ = 0;
+
+  const uint8* index() const { return buffer_ + HEADER_BYTE_SIZE; }
+  const uint8* data() const { return index() + (block_count_ + 1) * UINT32_SIZE; }
+  uint32 block_offset(int index) const;
+
+  static int compress_block(const uint8* source, int length, uint8* destination);
+};
+
+#endif  // TOIT_FREERTOS
+
+} // namespace toit
@@ -0,0 +1,212 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "string_intern.h"
+
+#include "heap.h"
+#include "objects_inline.h"
+#include "third_party/dartino/gc_metadata.h"
+#include "third_party/dartino/object_memory.h"
+
+namespace toit {
+
+StringInternTable::~StringInternTable() {
+  free(entries_);
+}
+
+void StringInternTable::clear() {
+  free(entries_);
+  entries_ = null;
+  capacity_ = 0;
+  size_ = 0;
+}
+
+uint32 StringInternTable::hash(const uint8* bytes, word length) {
+  // FNV-1a.
+  uint32 result = 2166136261u;
+  for (word i = 0; i < length; i++) {
+    result = (result ^ bytes[i]) * 16777619u;
+  }
+  return result;
+}
+
+String* StringInternTable::lookup(const uint8* bytes, word length) const {
+  if (size_ == 0 || !is_candidate(length)) return null;
+  uint32 h = hash(bytes, length);
+  word mask = capacity_ - 1;
+  for (word i = h & mask; entries_[i].string != null; i = (i + 1) & mask) {
+    if (entries_[i].hash != h) continue;
+    String::Bytes candidate(entries_[i].string);
+    if (String::slow_equals(candidate.address(), candidate.length(), bytes, length)) {
+      return entries_[i].string;
+    }
+  }
+  return null;
+}
+
+void StringInternTable::insert(Entry* entries, word capacity, String* string, uint32 hash) {
+  word mask = capacity - 1;
+  word i = hash & mask;
+  while (entries[i].string != null) i = (i + 1) & mask;
+  entries[i].string = string;
+  entries[i].hash = hash;
+}
+
+bool StringInternTable::grow() {
+  word capacity = capacity_ == 0 ? INITIAL_CAPACITY : capacity_ * 2;
+  Entry* entries = unvoid_cast<Entry*>(calloc(capacity, sizeof(Entry)));
+  if (entries == null) return false;
+  for (word i = 0; i < capacity_; i++) {
+    if (entries_[i].string != null) insert(entries, capacity, entries_[i].string, entries_[i].hash);
+  }
+  free(entries_);
+  entries_ = entries;
+  capacity_ = capacity;
+  return true;
+}
+
+bool StringInternTable::add(String* string) {
+  String::Bytes bytes(string);
+  ASSERT(is_candidate(bytes.length()));
+  ASSERT(lookup(bytes.address(), bytes.length()) == null);
+  // Keep the load factor below one half, so probe sequences stay short.
+  if ((size_ + 1) * 2 > capacity_ && !grow()) return false;
+  insert(entries_, capacity_, string, hash(bytes.address(), bytes.length()));
+  size_++;
+  return true;
+}
+
+void StringInternTable::weak_processing(RootCallback* cb, LivenessOracle* oracle) {
+  bool removed = false;
+  for (word i = 0; i < capacity_; i++) {
+    if (entries_[i].string == null) continue;
+    if (oracle->is_alive(entries_[i].string)) {
+      cb->do_root(reinterpret_cast<Object**>(&entries_[i].string));
+    } else {
+      entries_[i].string = null;
+      size_--;
+      removed = true;
+    }
+  }
+  if (!removed) return;
+  // Removing entries breaks the probe sequences of the entries after them.
+  // Reinsert all entries, starting after an empty slot, so every entry finds
+  // its place before the entries that follow it in its probe sequence.
+  word mask = capacity_ - 1;
+  word start = 0;
+  while (entries_[start].string != null) start++;
+  for (word n = 1; n <= capacity_; n++) {
+    word i = (start + n) & mask;
+    String* string = entries_[i].string;
+    if (string == null) continue;
+    entries_[i].string = null;
+    insert(entries_, capacity_, string, entries_[i].hash);
+  }
+}
+
+void StringInternTable::roots_do(RootCallback* cb) {
+  for (word i = 0; i < capacity_; i++) {
+    if (entries_[i].string != null) cb->do_root(reinterpret_cast<Object**>(&entries_[i].string));
+  }
+}
+
+// Visits the live objects of a space, either to find the canonical strings or
+// to redirect the references to their copies.
+class DeduplicationVisitor : public HeapObjectVisitor {
+ public:
+  DeduplicationVisitor(Program* program, StringDeduplicator* deduplicator, OldSpace* old_space, bool redirect)
+      : HeapObjectVisitor(program)
+      , deduplicator_(deduplicator)
+      , old_space_(old_space)
+      , redirect_(redirect) {}
+
+  // Set if the pass ran out of memory for the canonical strings.
+  bool failed() const { return failed_; }
+
+  virtual uword visit(HeapObject* object) {
+    uword size = object->size(program_);
+    // The new-space is iterated with a liveness filter.  The old-space is not,
+    // since the dead objects must stay intact for the sweeper.
+    if (old_space_ != null && !old_space_->is_alive(object)) return size;
+    if (redirect_) {
+      object->roots_do(program_, deduplicator_);
+    } else if (!failed_ && is_string(object)) {
+      failed_ = !deduplicator_->add_canonical(String::cast(object));
+    }
+    return size;
+  }
+
+ private:
+  StringDeduplicator* deduplicator_;
+  OldSpace* old_space_;
+  bool redirect_;
+  bool failed_ = false;
+};
+
+bool StringDeduplicator::is_candidate(Object* object) {
+  if (!is_heap_object(object) || !is_string(object)) return false;
+  if (GcMetadata::get_page_type(object) != OLD_SPACE_PAGE) return false;
+  String* string = String::cast(object);
+  return string->content_on_heap() && StringInternTable::is_candidate(string->length());
+}
+
+bool StringDeduplicator::add_canonical(String* string) {
+  if (!is_candidate(string)) return true;
+  String::Bytes bytes(string);
+  String* canonical = canonicals_.lookup(bytes.address(), bytes.length());
+  if (canonical == null) return canonicals_.add(string);
+  if (canonical != string) {
+    deduplicated_++;
+    bytes_saved_ += string->size();
+  }
+  return true;
+}
+
+bool StringDeduplicator::run(ObjectHeap* heap, StringInternTable* interned) {
+  if (interned != null) {
+    seeding_ = true;
+    interned->roots_do(this);
+    seeding_ = false;
+    if (failed_) return false;
+  }
+
+  DeduplicationVisitor finder(program_, this, old_space_, false);
+  old_space_->iterate_objects(&finder);
+  if (finder.failed()) return false;
+  if (deduplicated_ == 0) return true;
+
+  DeduplicationVisitor old_redirector(program_, this, old_space_, true);
+  old_space_->iterate_objects(&old_redirector);
+  DeduplicationVisitor new_redirector(program_, this, null, true);
+  semi_space_->iterate_objects(&new_redirector, old_space_);
+  heap->iterate_roots(this);
+  return true;
+}
+
+void StringDeduplicator::do_roots(Object** roots, int length) {
+  for (int i = 0; i < length; i++) {
+    Object* object = roots[i];
+    if (seeding_) {
+      if (!failed_) failed_ = !add_canonical(String::cast(object));
+      continue;
+    }
+    if (!is_candidate(object)) continue;
+    String::Bytes bytes(String::cast(object));
+    String* canonical = canonicals_.lookup(bytes.address(), bytes.length());
+    if (canonical != null) roots[i] = canonical;
+  }
+}
+
+} // namespace toit
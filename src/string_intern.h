@@ -0,0 +1,126 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+#include "objects.h"
+
+namespace toit {
+
+class LivenessOracle;
+class ObjectHeap;
+class OldSpace;
+class SemiSpace;
+
+// A set of short strings, keyed by their content, that a process shares
+// instead of allocating equal copies.  The table holds its strings weakly:
+// strings that are only reachable from the table are dropped by the GC.
+//
+// The entries are kept in an open addressing hash table with linear probing.
+// The hashes are stored next to the strings, so the table can be rehashed in
+// the middle of a GC without looking at the strings.
+class StringInternTable {
+ public:
+  // Longer strings are rarely repeated, and are never interned.
+  static const int MAX_LENGTH = 64;
+
+  StringInternTable() {}
+  ~StringInternTable();
+
+  static bool is_candidate(word length) { return length <= MAX_LENGTH; }
+
+  // Returns the interned string with the given content, or null.
+  String* lookup(const uint8* bytes, word length) const;
+
+  // Adds a string, which must not have equal content to an entry.  Returns
+  // false if the table could not grow.
+  bool add(String* string);
+
+  word size() const { return size_; }
+
+  // Removes all strings and frees the entries.
+  void clear();
+
+  // Drops the dead strings and updates the pointers of the live ones.  Must
+  // not allocate, since it is called in the middle of a GC.
+  void weak_processing(RootCallback* cb, LivenessOracle* oracle);
+
+  // Visits all the strings, for example to fix pointers after compaction.
+  void roots_do(RootCallback* cb);
+
+  static uint32 hash(const uint8* bytes, word length);
+
+ private:
+  struct Entry {
+    String* string;
+    uint32 hash;
+  };
+
+  static const word INITIAL_CAPACITY = 64;
+
+  Entry* entries_ = null;
+  word capacity_ = 0;  // Always zero or a power of two.
+  word size_ = 0;
+
+  void insert(Entry* entries, word capacity, String* string, uint32 hash);
+  bool grow();
+};
+
+// Merges equal short strings in the old-space of a heap.  Runs at the end of
+// the marking phase of a mark-sweep GC, when the mark bits tell which objects
+// are live.  The first live copy of a string becomes the canonical one, and all
+// references to the other copies are redirected to it.  The copies are thus
+// only freed by the next GC.
+//
+// Only references to old-space strings are redirected, to old-space strings, so
+// the remembered set doesn't change.  New-space strings are deduplicated once
+// they are promoted.
+class StringDeduplicator : public RootCallback {
+ public:
+  StringDeduplicator(Program* program, OldSpace* old_space, SemiSpace* semi_space)
+      : program_(program)
+      , old_space_(old_space)
+      , semi_space_(semi_space) {}
+
+  // Runs the pass.  The interned strings are preferred as canonical copies.
+  // Returns false if there was not enough memory for the pass.
+  bool run(ObjectHeap* heap, StringInternTable* interned);
+
+  word deduplicated() const { return deduplicated_; }
+  word bytes_saved() const { return bytes_saved_; }
+
+  virtual void do_roots(Object** roots, int length);
+
+ private:
+  Program* const program_;
+  OldSpace* const old_space_;
+  SemiSpace* const semi_space_;
+  StringInternTable canonicals_;
+  word deduplicated_ = 0;
+  word bytes_saved_ = 0;
+  // Set while the interned strings are added as canonical copies.
+  bool seeding_ = false;
+  bool failed_ = false;
+
+  static bool is_candidate(Object* object);
+  // Adds the string as canonical copy, unless there already is one.  Returns
+  // false if the table could not grow.
+  bool add_canonical(String* string);
+
+  friend class DeduplicationVisitor;
+};
+
+} // namespace toit
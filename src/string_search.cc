@@ -0,0 +1,231 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "string_search.h"
+#include "utils.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>  // SSE2 primitives.
+#endif
+
+namespace toit {
+
+// Views of a byte sequence from its start, and from its end backwards. The
+// Two-Way search is written in terms of these, so the same code finds the
+// first occurrence, and the last occurrence by searching for the reversed
+// needle in the reversed haystack.
+struct ForwardBytes {
+  const uint8* start;
+  uint8 operator[](word index) const { return start[index]; }
+};
+
+struct BackwardBytes {
+  const uint8* end;
+  uint8 operator[](word index) const { return end[-1 - index]; }
+};
+
+// Computes the maximal suffix of the needle for the byte order, or for the
+// reversed byte order. Returns the index just before the suffix, and the
+// period of the suffix in *period.
+template<typename Bytes>
+static word maximal_suffix(Bytes needle, word length, bool reversed, word* period) {
+  word max_suffix = -1;
+  word j = 0;
+  word k = 1;
+  word p = 1;
+  while (j + k < length) {
+    uint8 a = needle[j + k];
+    uint8 b = needle[max_suffix + k];
+    if (reversed ? b < a : a < b) {
+      // The suffix starting at j + k is smaller. The period is the whole
+      // prefix so far.
+      j += k;
+      k = 1;
+      p = j - max_suffix;
+    } else if (a == b) {
+      // Advance through the repetition of the current period.
+      if (k != p) {
+        k++;
+      } else {
+        j += p;
+        k = 1;
+      }
+    } else {
+      // The suffix starting at j is larger.
+      max_suffix = j++;
+      k = p = 1;
+    }
+  }
+  *period = p;
+  return max_suffix;
+}
+
+template<typename Bytes>
+static void factorize(Bytes needle, word length, SubstringSearcher::Factorization* result) {
+  // The critical factorization is the later of the two maximal suffixes.
+  word period;
+  word reversed_period;
+  word suffix = maximal_suffix(needle, length, false, &period);
+  word reversed_suffix = maximal_suffix(needle, length, true, &reversed_period);
+  if (reversed_suffix < suffix) {
+    result->suffix = suffix + 1;
+    result->period = period;
+  } else {
+    result->suffix = reversed_suffix + 1;
+    result->period = reversed_period;
+  }
+  bool is_periodic = result->suffix + result->period <= length;
+  for (word i = 0; is_periodic && i < result->suffix; i++) {
+    is_periodic = needle[i] == needle[i + result->period];
+  }
+  result->is_periodic = is_periodic;
+  if (!is_periodic) {
+    // Without a period, the left part can't match again within the larger
+    // of the two parts.
+    result->period = Utils::max(result->suffix, length - result->suffix) + 1;
+  }
+}
+
+// Returns the index of the first occurrence of the needle in text[0..limit +
+// length[, or -1.
+template<typename Bytes>
+static word two_way(Bytes needle, word length, const SubstringSearcher::Factorization& factorization,
+                    Bytes text, word limit) {
+  const word suffix = factorization.suffix;
+  const word period = factorization.period;
+  word j = 0;
+  if (factorization.is_periodic) {
+    // The prefix that is known to match after a shift by the period.
+    word memory = 0;
+    while (j <= limit) {
+      // Match the right part, then the left part.
+      word i = Utils::max(suffix, memory);
+      while (i < length && needle[i] == text[i + j]) i++;
+      if (i >= length) {
+        i = suffix - 1;
+        while (memory < i + 1 && needle[i] == text[i + j]) i--;
+        if (i + 1 < memory + 1) return j;
+        j += period;
+        memory = length - period;
+      } else {
+        j += i - suffix + 1;
+        memory = 0;
+      }
+    }
+  } else {
+    while (j <= limit) {
+      word i = suffix;
+      while (i < length && needle[i] == text[i + j]) i++;
+      if (i >= length) {
+        i = suffix - 1;
+        while (i >= 0 && needle[i] == text[i + j]) i--;
+        if (i < 0) return j;
+        j += period;
+      } else {
+        j += i - suffix + 1;
+      }
+    }
+  }
+  return -1;
+}
+
+SubstringSearcher::SubstringSearcher(const uint8* needle, word needle_length)
+    : needle_(needle)
+    , length_(needle_length) {
+  if (length_ < TWO_WAY_THRESHOLD) return;
+  factorize(ForwardBytes { needle_ }, length_, &forward_);
+  factorize(BackwardBytes { needle_ + length_ }, length_, &backward_);
+}
+
+word SubstringSearcher::find(const uint8* haystack, word from, word to) const {
+  ASSERT(0 <= from && from <= to);
+  if (length_ == 0) return from;
+  if (to - from < length_) return -1;
+  if (length_ == 1) {
+    auto found = reinterpret_cast<const uint8*>(memchr(haystack + from, needle_[0], to - from));
+    return found == null ? -1 : found - haystack;
+  }
+  if (length_ < TWO_WAY_THRESHOLD) return find_short(haystack, from, to);
+  word index = two_way(ForwardBytes { needle_ }, length_, forward_,
+                       ForwardBytes { haystack + from }, to - from - length_);
+  return index < 0 ? -1 : from + index;
+}
+
+word SubstringSearcher::find_short(const uint8* haystack, word from, word to) const {
+  const uint8 first = needle_[0];
+  const uint8 last = needle_[length_ - 1];
+  const word limit = to - length_;
+  word i = from;
+#if defined(__x86_64__)
+  // Compares 16 candidate positions at a time. The candidates must have the
+  // first byte of the needle at their position and the last byte of the
+  // needle length - 1 bytes later. Only those are compared in full.
+  const __m128i first_mask = _mm_set1_epi8(first);
+  const __m128i last_mask = _mm_set1_epi8(last);
+  for (; i + 16 <= limit + 1; i += 16) {
+    __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+    __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + length_ - 1));
+    __m128i matches = _mm_and_si128(_mm_cmpeq_epi8(block_first, first_mask),
+                                    _mm_cmpeq_epi8(block_last, last_mask));
+    int bits = _mm_movemask_epi8(matches);
+    while (bits != 0) {
+      word candidate = i + Utils::ctz(bits);
+      if (memcmp(haystack + candidate + 1, needle_ + 1, length_ - 2) == 0) return candidate;
+      bits &= bits - 1;
+    }
+  }
+#endif
+  while (i <= limit) {
+    // Let memchr find the first byte, as it is optimized for the platform.
+    auto found = reinterpret_cast<const uint8*>(memchr(haystack + i, first, limit + 1 - i));
+    if (found == null) return -1;
+    i = found - haystack;
+    if (haystack[i + length_ - 1] == last &&
+        memcmp(haystack + i + 1, needle_ + 1, length_ - 2) == 0) {
+      return i;
+    }
+    i++;
+  }
+  return -1;
+}
+
+word SubstringSearcher::find_last(const uint8* haystack, word from, word to) const {
+  ASSERT(0 <= from && from <= to);
+  if (length_ == 0) return to;
+  if (to - from < length_) return -1;
+  if (length_ < TWO_WAY_THRESHOLD) {
+    // Scanning backwards costs at most TWO_WAY_THRESHOLD comparisons per
+    // position, so it stays linear in the length of the haystack.
+    const uint8 first = needle_[0];
+    const uint8 last = needle_[length_ - 1];
+    for (word i = to - length_; i >= from; i--) {
+      if (haystack[i] == first &&
+          haystack[i + length_ - 1] == last &&
+          memcmp(haystack + i, needle_, length_) == 0) {
+        return i;
+      }
+    }
+    return -1;
+  }
+  // The first occurrence of the reversed needle in the reversed haystack
+  // is the last occurrence of the needle.
+  word index = two_way(BackwardBytes { needle_ + length_ }, length_, backward_,
+                       BackwardBytes { haystack + to }, to - from - length_);
+  return index < 0 ? -1 : to - index - length_;
+}
+
+} // namespace toit
@@ -0,0 +1,63 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+
+namespace toit {
+
+// Searches for occurrences of a needle in byte sequences.
+//
+// Short needles are found by looking for their first and last byte, 16
+// positions at a time with SSE2 where it is available. Long needles use
+// the Two-Way algorithm by Crochemore and Perrin, which runs in linear
+// time and constant space, so repetitive inputs can't make the search
+// quadratic. The last occurrence of a long needle is found by running
+// Two-Way on the reversed needle and haystack.
+class SubstringSearcher {
+ public:
+  SubstringSearcher(const uint8* needle, word needle_length);
+
+  // A critical factorization of the needle, used by Two-Way.
+  struct Factorization {
+    word suffix = 0;
+    word period = 0;
+    bool is_periodic = false;
+  };
+
+  // Returns the index of the first occurrence of the needle that is fully
+  // contained in haystack[from..to[, or -1.
+  word find(const uint8* haystack, word from, word to) const;
+
+  // Returns the index of the last occurrence of the needle that is fully
+  // contained in haystack[from..to[, or -1.
+  word find_last(const uint8* haystack, word from, word to) const;
+
+ private:
+  // Needles of this length and longer use the Two-Way algorithm.
+  static const word TWO_WAY_THRESHOLD = 32;
+
+  word find_short(const uint8* haystack, word from, word to) const;
+
+  const uint8* const needle_;
+  const word length_;
+  // The factorizations of the needle and of the reversed needle, only used
+  // for long needles.
+  Factorization forward_;
+  Factorization backward_;
+};
+
+} // namespace toit
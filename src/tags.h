@@ -39,6 +39,8 @@ namespace toit {
   fn(Siphash)                           \
   fn(Adler32)                           \
   fn(ZlibRle)                           \
+  fn(DeltaPatcher)                      \
+  fn(Regexp)                            \
   fn(Zlib)                              \
   fn(UartResource)                      \
   fn(GpioResource)                      \
@@ -123,6 +125,7 @@ enum StructTag {
   LeakyDirectoryTag,
   FontTag,
   ImageOutputStreamTag,
+  ImageWriterTag,
   ChannelTag
 };
 
@@ -197,6 +197,9 @@ GcType TwoSpaceHeap::collect_new_space(bool try_hard) {
 
     visitor.complete_scavenge();
 
+    // Only the interned strings that are still reachable survive.
+    process_heap_->process_string_table(&visitor, from);
+
     old_space()->end_scavenge();
 
     total_bytes_allocated_ -= to->used();
@@ -387,6 +390,12 @@ bool TwoSpaceHeap::perform_garbage_collection(bool force_compact) {
 
   stack.process(&marking_visitor, old_space(), semi_space);
 
+  process_heap_->process_string_table(&marking_visitor, old_space());
+
+  // The mark bits are complete, so we know which strings are live and can
+  // merge the equal ones before the dead objects are freed.
+  process_heap_->deduplicate_strings(old_space(), semi_space);
+
   word regained_by_compacting = old_space()->compute_compaction_destinations();
 
   bool compact = force_compact || regained_by_compacting > 0;
@@ -0,0 +1,157 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "top.h"
+#include "debug_info.h"
+#include "snapshot_bundle.h"
+
+#ifndef TOIT_WINDOWS
+#include <sys/mman.h>
+#endif
+
+namespace toit {
+
+static void print_usage(int exit_code) {
+  printf("Usage:\n");
+  printf("toit.symbolize\n");
+  printf("  [-h] [--help]                             // This help message\n");
+  printf("  --build <snapshot> <debug-info>           // Writes the debug info of a snapshot\n");
+  printf("  <debug-info> [<absolute-bci>]*            // Symbolizes the given bcis\n");
+  printf("\n");
+  printf("Without bcis, the bcis are read from stdin, separated by whitespace.\n");
+  printf("The compiler doesn't write the debug info. Build it with --build from the\n");
+  printf("snapshot bundle after compiling.\n");
+  exit(exit_code);
+}
+
+static int build(const char* bundle_path, const char* debug_info_path) {
+  auto bundle = SnapshotBundle::read_from_file(bundle_path);
+  if (!bundle.is_valid()) return 1;
+  List<const uint8> source_map;
+  if (!bundle.source_map(&source_map)) {
+    fprintf(stderr, "Snapshot %s has no source map\n", bundle_path);
+    return 1;
+  }
+  uint8 uuid[UUID_SIZE];
+  int size;
+  uint8* debug_info = DebugInfo::build(source_map, bundle.uuid(uuid) ? uuid : null, &size);
+  free(bundle.buffer());
+  if (debug_info == null) {
+    fprintf(stderr, "Malformed source map in %s\n", bundle_path);
+    return 1;
+  }
+  FILE* file = fopen(debug_info_path, "wb");
+  if (file == null) {
+    fprintf(stderr, "Unable to open %s: %s\n", debug_info_path, strerror(errno));
+    free(debug_info);
+    return 1;
+  }
+  bool succeeded = fwrite(debug_info, size, 1, file) == 1;
+  fclose(file);
+  free(debug_info);
+  if (!succeeded) {
+    fprintf(stderr, "Unable to write %s\n", debug_info_path);
+    return 1;
+  }
+  return 0;
+}
+
+// Maps the file into memory. The mapping is never released, as it lives
+// until the tool exits.
+static const uint8* map_file(const char* path, word* size) {
+#ifdef TOIT_WINDOWS
+  int fd = open(path, O_RDONLY | O_BINARY);
+#else
+  int fd = open(path, O_RDONLY);
+#endif
+  if (fd < 0) return null;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    return null;
+  }
+  *size = info.st_size;
+#ifdef TOIT_WINDOWS
+  uint8* result = unvoid_cast<uint8*>(malloc(*size));
+  bool succeeded = result != null && read(fd, result, *size) == *size;
+  close(fd);
+  return succeeded ? result : null;
+#else
+  void* result = mmap(null, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  return result == MAP_FAILED ? null : static_cast<const uint8*>(result);
+#endif
+}
+
+static void symbolize(const DebugInfo& debug_info, const char* bci_string) {
+  char* end;
+  long absolute_bci = strtol(bci_string, &end, 0);
+  DebugInfo::Location location;
+  if (*end != '\0' || !debug_info.lookup(absolute_bci, &location)) {
+    printf("%s: <unknown>\n", bci_string);
+    return;
+  }
+  printf("%s: %s %s:%d:%d\n",
+         bci_string,
+         location.name,
+         location.path,
+         location.line,
+         location.column);
+}
+
+static int symbolize(const char* debug_info_path, int bci_count, char** bcis) {
+  word size;
+  const uint8* data = map_file(debug_info_path, &size);
+  if (data == null) {
+    fprintf(stderr, "Unable to read %s\n", debug_info_path);
+    return 1;
+  }
+  DebugInfo debug_info(data, size);
+  if (!debug_info.is_valid()) {
+    fprintf(stderr, "Not a valid debug info file %s\n", debug_info_path);
+    return 1;
+  }
+  if (bci_count > 0) {
+    for (int i = 0; i < bci_count; i++) symbolize(debug_info, bcis[i]);
+    return 0;
+  }
+  char buffer[32];
+  while (scanf("%31s", buffer) == 1) symbolize(debug_info, buffer);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) print_usage(1);
+  if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) print_usage(0);
+  if (strcmp(argv[1], "--build") == 0) {
+    if (argc != 4) print_usage(1);
+    return build(argv[2], argv[3]);
+  }
+  return symbolize(argv[1], argc - 2, &argv[2]);
+}
+
+} // namespace toit
+
+int main(int argc, char** argv) {
+  return toit::main(argc, argv);
+}
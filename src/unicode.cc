@@ -0,0 +1,361 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#include "top.h"
+#include "unicode.h"
+#include "utils.h"
+
+namespace toit {
+
+// Hangul syllables are composed and decomposed algorithmically.
+static const int HANGUL_S_BASE = 0xac00;
+static const int HANGUL_L_BASE = 0x1100;
+static const int HANGUL_V_BASE = 0x1161;
+static const int HANGUL_T_BASE = 0x11a7;
+static const int HANGUL_L_COUNT = 19;
+static const int HANGUL_V_COUNT = 21;
+static const int HANGUL_T_COUNT = 28;
+static const int HANGUL_N_COUNT = HANGUL_V_COUNT * HANGUL_T_COUNT;
+static const int HANGUL_S_COUNT = HANGUL_L_COUNT * HANGUL_N_COUNT;
+
+int Unicode::to_upper(int c) {
+  if (c <= Utils::MAX_ASCII) return ('a' <= c && c <= 'z') ? c - ('a' - 'A') : c;
+  return c + properties(c)->upper;
+}
+
+int Unicode::to_lower(int c) {
+  if (c <= Utils::MAX_ASCII) return ('A' <= c && c <= 'Z') ? c + ('a' - 'A') : c;
+  return c + properties(c)->lower;
+}
+
+int Unicode::fold(int c) {
+  return to_lower(to_upper(c));
+}
+
+int Unicode::combining_class(int c) {
+  if (c <= Utils::MAX_ASCII) return 0;
+  return properties(c)->combining_class;
+}
+
+const Unicode::Decomposition* Unicode::decomposition(int c) {
+  word low = 0;
+  word high = DECOMPOSITIONS_LENGTH - 1;
+  while (low <= high) {
+    word middle = (low + high) >> 1;
+    int code_point = DECOMPOSITIONS[middle].code_point;
+    if (code_point == c) return &DECOMPOSITIONS[middle];
+    if (code_point < c) {
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+  return null;
+}
+
+int Unicode::compose(int first, int second) {
+  if (HANGUL_L_BASE <= first && first < HANGUL_L_BASE + HANGUL_L_COUNT) {
+    if (HANGUL_V_BASE <= second && second < HANGUL_V_BASE + HANGUL_V_COUNT) {
+      return HANGUL_S_BASE + ((first - HANGUL_L_BASE) * HANGUL_V_COUNT + second - HANGUL_V_BASE) * HANGUL_T_COUNT;
+    }
+    return -1;
+  }
+  if (HANGUL_S_BASE <= first && first < HANGUL_S_BASE + HANGUL_S_COUNT) {
+    if ((first - HANGUL_S_BASE) % HANGUL_T_COUNT == 0 &&
+        HANGUL_T_BASE < second && second < HANGUL_T_BASE + HANGUL_T_COUNT) {
+      return first + second - HANGUL_T_BASE;
+    }
+    return -1;
+  }
+  word low = 0;
+  word high = COMPOSITIONS_LENGTH - 1;
+  while (low <= high) {
+    word middle = (low + high) >> 1;
+    const Decomposition* entry = &DECOMPOSITIONS[COMPOSITIONS[middle]];
+    int compared = static_cast<int>(entry->first) - first;
+    if (compared == 0) compared = static_cast<int>(entry->second) - second;
+    if (compared == 0) return entry->code_point;
+    if (compared < 0) {
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+  return -1;
+}
+
+static inline int decode(const uint8* input, word* position) {
+  uint8 prefix = input[*position];
+  if (prefix <= Utils::MAX_ASCII) {
+    (*position)++;
+    return prefix;
+  }
+  int count = Utils::bytes_in_utf_8_sequence(prefix);
+  int c = Utils::payload_from_prefix(prefix);
+  for (int j = 1; j < count; j++) {
+    c <<= Utils::UTF_8_BITS_PER_BYTE;
+    c |= input[*position + j] & Utils::UTF_8_MASK;
+  }
+  *position += count;
+  return c;
+}
+
+// Collects the UTF-8 of a result.  Without an output it only measures the
+// result, and compares it to the input to find out whether anything
+// changed.
+class Utf8Writer {
+ public:
+  Utf8Writer(const uint8* input, word length, uint8* output)
+      : input_(input)
+      , length_(length)
+      , output_(output) {}
+
+  void write(int c) {
+    uint8 buffer[4];
+    int n;
+    if (c <= Utils::MAX_ASCII) {
+      buffer[0] = c;
+      n = 1;
+    } else if (c <= Utils::MAX_TWO_BYTE_UNICODE) {
+      buffer[0] = 0xc0 | (c >> 6);
+      buffer[1] = Utils::UTF_8_PAYLOAD | (c & Utils::UTF_8_MASK);
+      n = 2;
+    } else if (c <= Utils::MAX_THREE_BYTE_UNICODE) {
+      buffer[0] = 0xe0 | (c >> 12);
+      buffer[1] = Utils::UTF_8_PAYLOAD | ((c >> 6) & Utils::UTF_8_MASK);
+      buffer[2] = Utils::UTF_8_PAYLOAD | (c & Utils::UTF_8_MASK);
+      n = 3;
+    } else {
+      buffer[0] = 0xf0 | (c >> 18);
+      buffer[1] = Utils::UTF_8_PAYLOAD | ((c >> 12) & Utils::UTF_8_MASK);
+      buffer[2] = Utils::UTF_8_PAYLOAD | ((c >> 6) & Utils::UTF_8_MASK);
+      buffer[3] = Utils::UTF_8_PAYLOAD | (c & Utils::UTF_8_MASK);
+      n = 4;
+    }
+    write(buffer, n);
+  }
+
+  // Writes a part of the input unchanged.
+  void copy(word from, word to) {
+    if (output_ == null && size_ == from) {
+      size_ += to - from;
+      return;
+    }
+    write(input_ + from, to - from);
+  }
+
+  word size() const { return size_; }
+  bool changed() const { return changed_ || size_ != length_; }
+
+ private:
+  const uint8* input_;
+  word length_;
+  uint8* output_;
+  word size_ = 0;
+  bool changed_ = false;
+
+  void write(const uint8* bytes, word n) {
+    if (output_ != null) {
+      memcpy(output_ + size_, bytes, n);
+    } else if (!changed_) {
+      changed_ = size_ + n > length_ || memcmp(input_ + size_, bytes, n) != 0;
+    }
+    size_ += n;
+  }
+};
+
+static inline int map(Unicode::Case mapping, int c) {
+  switch (mapping) {
+    case Unicode::UPPER_CASE: return Unicode::to_upper(c);
+    case Unicode::LOWER_CASE: return Unicode::to_lower(c);
+    case Unicode::FOLDED_CASE: return Unicode::fold(c);
+  }
+  UNREACHABLE();
+}
+
+word Unicode::map_case(Case mapping, const uint8* input, word length, uint8* output, bool* changed) {
+  Utf8Writer writer(input, length, output);
+  word i = 0;
+  while (i < length) {
+    // Copy the characters that don't change in bulk.
+    word start = i;
+    while (i < length && input[i] <= Utils::MAX_ASCII && map(mapping, input[i]) == input[i]) i++;
+    if (i != start) writer.copy(start, i);
+    if (i == length) break;
+    writer.write(map(mapping, decode(input, &i)));
+  }
+  if (changed) *changed = writer.changed();
+  return writer.size();
+}
+
+// The characters of a segment of the input that is being normalized, in
+// canonical order.  Most segments are short, and only segments with long
+// sequences of combining marks need to allocate.
+class NormalizationBuffer {
+ public:
+  ~NormalizationBuffer() {
+    if (entries_ != inline_entries_) free(entries_);
+  }
+
+  word length() const { return length_; }
+  bool is_empty() const { return length_ == 0; }
+
+  // Adds the full canonical decomposition of the character.
+  bool decompose(int c) {
+    if (HANGUL_S_BASE <= c && c < HANGUL_S_BASE + HANGUL_S_COUNT) {
+      int index = c - HANGUL_S_BASE;
+      if (!add(HANGUL_L_BASE + index / HANGUL_N_COUNT, 0)) return false;
+      if (!add(HANGUL_V_BASE + (index % HANGUL_N_COUNT) / HANGUL_T_COUNT, 0)) return false;
+      if (index % HANGUL_T_COUNT == 0) return true;
+      return add(HANGUL_T_BASE + index % HANGUL_T_COUNT, 0);
+    }
+    const Unicode::Properties* properties = Unicode::properties(c);
+    if ((properties->flags & Unicode::DECOMPOSES) == 0) return add(c, properties->combining_class);
+    const Unicode::Decomposition* decomposition = Unicode::decomposition(c);
+    ASSERT(decomposition != null);
+    if (!decompose(decomposition->first)) return false;
+    return decomposition->second == 0 || decompose(decomposition->second);
+  }
+
+  // Replaces the characters with their canonical compositions.
+  void compose() {
+    word starter = -1;
+    // The combining class of the last character that was kept after the
+    // starter, or -1 if there is none.
+    int last_class = -1;
+    word kept = 0;
+    for (word i = 0; i < length_; i++) {
+      int c = entries_[i].c;
+      int combining_class = entries_[i].combining_class;
+      if (starter >= 0) {
+        bool blocked = last_class >= 0 && (last_class == 0 || last_class >= combining_class);
+        if (!blocked) {
+          int composite = Unicode::compose(entries_[starter].c, c);
+          if (composite >= 0) {
+            entries_[starter].c = composite;
+            continue;
+          }
+        }
+      }
+      if (combining_class == 0) {
+        starter = kept;
+        last_class = -1;
+      } else {
+        last_class = combining_class;
+      }
+      entries_[kept++] = entries_[i];
+    }
+    length_ = kept;
+  }
+
+  void flush(Utf8Writer* writer) {
+    for (word i = 0; i < length_; i++) writer->write(entries_[i].c);
+    length_ = 0;
+  }
+
+ private:
+  struct Entry {
+    int32 c;
+    int32 combining_class;
+  };
+
+  static const int INLINE_CAPACITY = 32;
+  Entry inline_entries_[INLINE_CAPACITY];
+  Entry* entries_ = inline_entries_;
+  word length_ = 0;
+  word capacity_ = INLINE_CAPACITY;
+
+  // Adds the character, moving it in front of the combining marks with a
+  // higher combining class.
+  bool add(int c, int combining_class) {
+    if (length_ == capacity_) {
+      Entry* entries = unvoid_cast<Entry*>(malloc(capacity_ * 2 * sizeof(Entry)));
+      if (entries == null) return false;
+      memcpy(entries, entries_, length_ * sizeof(Entry));
+      if (entries_ != inline_entries_) free(entries_);
+      entries_ = entries;
+      capacity_ *= 2;
+    }
+    word position = length_++;
+    if (combining_class != 0) {
+      while (position > 0 && entries_[position - 1].combining_class > combining_class) {
+        entries_[position] = entries_[position - 1];
+        position--;
+      }
+    }
+    entries_[position].c = c;
+    entries_[position].combining_class = combining_class;
+    return true;
+  }
+};
+
+// Whether normalization can start afresh before the character, because it
+// is a starter that doesn't compose with what comes before it.
+static bool is_boundary(bool compose, int c) {
+  if (compose && HANGUL_V_BASE <= c && c < HANGUL_T_BASE + HANGUL_T_COUNT) return false;
+  const Unicode::Properties* properties = Unicode::properties(c);
+  if (properties->combining_class != 0) return false;
+  if (compose && (properties->flags & Unicode::COMBINES_BACKWARD) != 0) return false;
+  // Decompositions start with a starter, unless they have a combining
+  // class themselves, or combine backward.
+  if ((properties->flags & Unicode::DECOMPOSES) != 0) {
+    return is_boundary(compose, Unicode::decomposition(c)->first);
+  }
+  return true;
+}
+
+word Unicode::normalize(bool compose, const uint8* input, word length, uint8* output, bool* changed) {
+  Utf8Writer writer(input, length, output);
+  NormalizationBuffer buffer;
+  word i = 0;
+  while (i < length) {
+    if (input[i] <= Utils::MAX_ASCII) {
+      // ASCII characters are starters that don't decompose.  Only the last
+      // one in a run can compose with what comes after it.
+      word start = i;
+      while (i < length && input[i] <= Utils::MAX_ASCII) i++;
+      if (compose) buffer.compose();
+      buffer.flush(&writer);
+      writer.copy(start, i - 1);
+      if (!buffer.decompose(input[i - 1])) return -1;
+      continue;
+    }
+    int c = decode(input, &i);
+    if (!buffer.is_empty() && is_boundary(compose, c)) {
+      if (compose) buffer.compose();
+      buffer.flush(&writer);
+    }
+    if (!buffer.decompose(c)) return -1;
+  }
+  if (compose) buffer.compose();
+  buffer.flush(&writer);
+  if (changed) *changed = writer.changed();
+  return writer.size();
+}
+
+int Unicode::compare_folded(const uint8* input1, word length1, const uint8* input2, word length2) {
+  word i = 0;
+  word j = 0;
+  while (i < length1 && j < length2) {
+    int c1 = fold(decode(input1, &i));
+    int c2 = fold(decode(input2, &j));
+    if (c1 != c2) return c1 < c2 ? -1 : 1;
+  }
+  if (i < length1) return 1;
+  if (j < length2) return -1;
+  return 0;
+}
+
+} // namespace toit
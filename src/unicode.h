@@ -0,0 +1,109 @@
+// Copyright (C) 2024 Toitware ApS.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; version
+// 2.1 only.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// The license can be found in the file `LICENSE` in the top level
+// directory of this repository.
+
+#pragma once
+
+#include "top.h"
+
+namespace toit {
+
+// Case mapping, case folding and canonical normalization of UTF-8.
+//
+// The properties of characters come from tables that are generated from the
+// Unicode Character Database by tools/generate-unicode-tables.toit.  Case
+// mappings are the simple one-to-one mappings, so "ß" has no upper case, and
+// case folding maps a character to the lower case of its upper case.
+//
+// All functions take valid UTF-8, as found in strings, and runs of ASCII
+// never touch the tables.
+class Unicode {
+ public:
+  enum Case {
+    UPPER_CASE,
+    LOWER_CASE,
+    FOLDED_CASE,
+  };
+
+  static int to_upper(int c);
+  static int to_lower(int c);
+  static int fold(int c);
+  static int combining_class(int c);
+
+  // Maps the case of all characters in the input.  Returns the size of the
+  // result, which can differ from the size of the input.  If the output is
+  // null, only computes the size, and sets $changed to whether the result
+  // differs from the input.
+  static word map_case(Case mapping, const uint8* input, word length, uint8* output, bool* changed = null);
+
+  // Converts the input to Normalization Form C if $compose is set, and to
+  // Normalization Form D otherwise.  Otherwise works like $map_case.
+  // Returns -1 if memory runs out, which only happens for very long
+  // sequences of combining marks.
+  static word normalize(bool compose, const uint8* input, word length, uint8* output, bool* changed = null);
+
+  // Compares the case folded characters of the two inputs.  Returns -1, 0
+  // or 1.
+  static int compare_folded(const uint8* input1, word length1, const uint8* input2, word length2);
+
+  // The low bits of a code point select the properties in a block.  Must
+  // match tools/generate-unicode-tables.toit.
+  static const int BLOCK_BITS = 6;
+
+  // Flags of the properties.
+  static const int COMBINES_BACKWARD = 1 << 0;
+  static const int DECOMPOSES = 1 << 1;
+
+  struct Properties {
+    // The differences between the upper and lower case and the character.
+    int32 upper;
+    int32 lower;
+    uint8 combining_class;
+    uint8 flags;
+  };
+
+  // A canonical decomposition into one or two characters.  The second is
+  // zero for decompositions into a single character.
+  struct Decomposition {
+    uint32 code_point;
+    uint32 first;
+    uint32 second;
+  };
+
+  static const Properties* properties(int c) {
+    int block = c >> BLOCK_BITS;
+    if (block >= STAGE_1_LENGTH) return &PROPERTIES[0];
+    return &PROPERTIES[STAGE_2[(STAGE_1[block] << BLOCK_BITS) + (c & ((1 << BLOCK_BITS) - 1))]];
+  }
+
+  static const Decomposition* decomposition(int c);
+  // The primary composite of the two characters, or -1.
+  static int compose(int first, int second);
+
+ private:
+  // The generated tables in unicode_tables.cc.
+  static const int STAGE_1_LENGTH;
+  static const int DECOMPOSITIONS_LENGTH;
+  static const int COMPOSITIONS_LENGTH;
+  static const uint8 STAGE_1[];
+  static const uint8 STAGE_2[];
+  static const Properties PROPERTIES[];
+  // Sorted by code point.
+  static const Decomposition DECOMPOSITIONS[];
+  // The indexes of the decompositions that are recomposed, sorted by their
+  // first and second character.
+  static const uint16 COMPOSITIONS[];
+};
+
+} // namespace toit
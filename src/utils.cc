@@ -17,6 +17,10 @@
 #include "objects.h"
 #include "process.h"
 
+#if defined(__x86_64__)
+#include <emmintrin.h>  // SSE2 primitives.
+#endif
+
 #ifndef TOIT_MODEL
 #error "TOIT_MODEL is not set"
 #endif
@@ -295,7 +299,7 @@ static const uint32 HIGH_BIT_OF_EACH_BYTE = 0x80808080;
 
 #endif
 
-bool Utils::is_valid_utf_8(const uint8* buffer, int length) {
+bool Utils::is_valid_utf_8(const uint8* buffer, int length, bool* is_ascii) {
   // Align.
   while (length != 0 && !is_aligned(buffer, WORD_SIZE) && (buffer[0] & 0xff) <= MAX_ASCII) {
     length--;
@@ -308,6 +312,12 @@ bool Utils::is_valid_utf_8(const uint8* buffer, int length) {
       length -= WORD_SIZE;
     }
   }
+  // Skip the ASCII tail, so we can tell whether the buffer is all ASCII.
+  while (length != 0 && buffer[0] <= MAX_ASCII) {
+    length--;
+    buffer++;
+  }
+  if (is_ascii != null) *is_ascii = length == 0;
 #ifdef BUILD_64
   // Thanks to Per Vognsen.  Explanation at
   // https://gist.github.com/pervognsen/218ea17743e1442e59bb60d29b1aa725
@@ -331,39 +341,169 @@ bool Utils::is_valid_utf_8(const uint8* buffer, int length) {
 #endif
 }
 
+#if !defined(__x86_64__)
+// Counts the bits in a word that only has the high bit of some bytes set.
+static inline word count_high_bits(uword w) {
+#ifdef BUILD_64
+  return Utils::popcount(w);
+#else
+  // The 1's can only be at the bit positions 7, 15, 23, and 31.  We could
+  // use popcount, but ESP32 does not have an instruction for that.
+  w += w >> 16;
+  // Now we have a 2-bit count at bit positions 7-8 and 15-16.
+  return ((w >> 7) + (w >> 15)) & 7;
+#endif
+}
+#endif
+
+// Counts the runes in valid UTF-8.  If $surrogates is set, runes outside the
+// basic plane are counted twice, so the result is the length in UTF-16.
+static word count_utf_8(const uint8* input, word length, bool surrogates) {
+  word count = 0;
+  word i = 0;
+#if defined(__x86_64__)
+  // As signed bytes, the continuation bytes 0x80-0xbf are the ones below
+  // -64, and the prefixes of four-byte sequences, 0xf0-0xf4, are the
+  // negative ones above -17.
+  const __m128i continuation_limit = _mm_set1_epi8(-64);
+  const __m128i four_byte_limit = _mm_set1_epi8(-17);
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= length; i += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+    int continuations = _mm_movemask_epi8(_mm_cmplt_epi8(chunk, continuation_limit));
+    count += 16 - Utils::popcount(continuations);
+    if (surrogates) {
+      __m128i four_byte = _mm_and_si128(_mm_cmpgt_epi8(chunk, four_byte_limit), _mm_cmplt_epi8(chunk, zero));
+      count += Utils::popcount(_mm_movemask_epi8(four_byte));
+    }
+  }
+#else
+#ifdef BUILD_64
+  const uword HIGH_BITS_IN_BYTES = 0x8080808080808080LL;
+#else
+  const uword HIGH_BITS_IN_BYTES = 0x80808080;
+#endif
+  for (; i < length && !Utils::is_aligned(input + i, WORD_SIZE); i++) {
+    if ((input[i] & 0xc0) != Utils::UTF_8_PAYLOAD) count++;
+    if (surrogates && input[i] >= 0xf0) count++;
+  }
+  for (; i + WORD_SIZE <= length; i += WORD_SIZE) {
+    uword w = *reinterpret_cast<const uword*>(input + i);
+    // The high bit in each byte of starts reflects whether the byte is an
+    // ASCII character (the ~w) or the prefix of a multi-byte sequence (the
+    // 11 in the top bits).  Four-byte sequences have four 1s in the top.
+    uword starts = ((w & (w << 1)) | ~w) & HIGH_BITS_IN_BYTES;
+    count += count_high_bits(starts);
+    if (surrogates) {
+      uword four_byte = w & (w << 1) & (w << 2) & (w << 3) & HIGH_BITS_IN_BYTES;
+      if (four_byte != 0) count += count_high_bits(four_byte);
+    }
+  }
+#endif
+  for (; i < length; i++) {
+    if ((input[i] & 0xc0) != Utils::UTF_8_PAYLOAD) count++;
+    if (surrogates && input[i] >= 0xf0) count++;
+  }
+  return count;
+}
+
+word Utils::utf_8_rune_count(const uint8* input, word length) {
+  return count_utf_8(input, length, false);
+}
+
+word Utils::utf_8_skip_runes(const uint8* input, word length, word from, word runes) {
+  word position = from;
+  // Every rune is at least one byte, so the next $runes bytes can't contain
+  // more than $runes runes.  Count them in bulk until we are close.  This
+  // may leave the position in the middle of a rune that was counted.
+  while (runes >= 16) {
+    if (position + runes > length) return -1;
+    word counted = count_utf_8(input + position, runes, false);
+    position += runes;
+    runes -= counted;
+  }
+  while (position < length && (input[position] & 0xc0) == UTF_8_PAYLOAD) position++;
+  for (; runes > 0; runes--) {
+    if (position == length) return -1;
+    position++;
+    while (position < length && (input[position] & 0xc0) == UTF_8_PAYLOAD) position++;
+  }
+  return position;
+}
+
+// Copies the ASCII prefix of the input to the output, widening it to UTF-16,
+// and returns its length.
+static word widen_ascii(const uint8* input, word length, uint16* output) {
+  word i = 0;
+#if defined(__x86_64__)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= length; i += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+    if (_mm_movemask_epi8(chunk) != 0) break;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_unpacklo_epi8(chunk, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 8), _mm_unpackhi_epi8(chunk, zero));
+  }
+#endif
+  for (; i < length && input[i] <= Utils::MAX_ASCII; i++) {
+    output[i] = input[i];
+  }
+  return i;
+}
+
+// Returns the length of the ASCII prefix of the input, and copies it to the
+// output, narrowing it to UTF-8, unless the output is null.
+static word narrow_ascii(const uint16* input, word length, uint8* output) {
+  word i = 0;
+#if defined(__x86_64__)
+  const __m128i non_ascii = _mm_set1_epi16(static_cast<int16>(0xff80));
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= length; i += 8) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+    __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(chunk, non_ascii), zero);
+    if (_mm_movemask_epi8(ascii) != 0xffff) break;
+    if (output) _mm_storel_epi64(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(chunk, chunk));
+  }
+#endif
+  for (; i < length && input[i] <= Utils::MAX_ASCII; i++) {
+    if (output) output[i] = input[i];
+  }
+  return i;
+}
+
 // Assumes the input is valid UTF-8, for example from a Toit string.
 // See also is_valid_utf_8.  Returns size in 16 bit code units.
 // If output is null, does not write.  If output_length is too small,
 // returns -1.
 word Utils::utf_8_to_16(const uint8* input, word length, uint16* output, word output_length) {
+  if (!output) return count_utf_8(input, length, true);
   word size = 0;
   for (word i = 0; i < length; ) {
     uint8 prefix = input[i];
+    if (prefix <= Utils::MAX_ASCII) {
+      // Runs of ASCII are copied in bulk.
+      word ascii = widen_ascii(input + i, Utils::min(length - i, output_length - size), output + size);
+      i += ascii;
+      size += ascii;
+      if (i == length) break;
+      prefix = input[i];
+      if (prefix <= Utils::MAX_ASCII) return -1;  // Out of space.
+    }
     word count = Utils::bytes_in_utf_8_sequence(prefix);
-    int c;
-    if (prefix > Utils::MAX_ASCII) {
-      c = Utils::payload_from_prefix(prefix);
-      for (word j = 1; j < count; j++) {
-        c <<= Utils::UTF_8_BITS_PER_BYTE;
-        c |= input[i + j] & Utils::UTF_8_MASK;
-      }
-    } else {
-      c = prefix;
+    int c = Utils::payload_from_prefix(prefix);
+    for (word j = 1; j < count; j++) {
+      c <<= Utils::UTF_8_BITS_PER_BYTE;
+      c |= input[i + j] & Utils::UTF_8_MASK;
     }
     if (c < 0x10000) {
-      if (output) {
-        if (size >= output_length) return -1;
-        output[size] = c;
-      }
+      if (size >= output_length) return -1;
+      output[size] = c;
       size++;
     } else {
       // Surrogate pair.
-      if (output) {
-        c -= 0x10000;
-        if (size + 1 >= output_length) return -1;
-        output[size] = 0xd800 + (c >> 10);
-        output[size + 1] = 0xdc00 + (c & 0x3ff);
-      }
+      c -= 0x10000;
+      if (size + 1 >= output_length) return -1;
+      output[size] = 0xd800 + (c >> 10);
+      output[size + 1] = 0xdc00 + (c & 0x3ff);
       size += 2;
     }
     i += count;
@@ -379,6 +519,15 @@ word Utils::utf_16_to_8(const uint16* input, word length, uint8* output, word ou
   word size = 0;
   for (word i = 0; i < length; i++) {
     int c = input[i];
+    if (c <= Utils::MAX_ASCII) {
+      // Runs of ASCII are copied in bulk.
+      word limit = output ? Utils::min(length - i, output_length - size) : length - i;
+      word ascii = narrow_ascii(input + i, limit, output ? output + size : null);
+      if (ascii == 0) return -1;  // Out of space.
+      size += ascii;
+      i += ascii - 1;
+      continue;
+    }
     if (Utils::MIN_SURROGATE <= c && c <= Utils::MAX_SURROGATE) {
       // Surrogate pairs.
       int decoded = 0xfffd;  // Substitute character for illegal sequences.
@@ -391,13 +540,7 @@ word Utils::utf_16_to_8(const uint16* input, word length, uint8* output, word ou
       }
       c = decoded;
     }
-    if (c <= Utils::MAX_ASCII) {
-      if (output) {
-        if (size == output_length) return -1;
-        output[size] = c;
-      }
-      size++;
-    } else if (c <= Utils::MAX_TWO_BYTE_UNICODE) {
+    if (c <= Utils::MAX_TWO_BYTE_UNICODE) {
       if (output) {
         if (size + 1 >= output_length) return -1;
         output[size]     = 0xc0 + (c >> 6);
@@ -293,6 +293,12 @@ class Utils {
 
   static word utf_16_to_8(const uint16* input, word length, uint8* output = null, word output_length = 0);
   static word utf_8_to_16(const uint8* input, word length, uint16* output = null, word output_length = 0);
+  // The number of runes in valid UTF-8.
+  static word utf_8_rune_count(const uint8* input, word length);
+  // Returns the position of the rune that is $runes runes after the one
+  // at $from in valid UTF-8, or -1 if there are too few runes.  Returns
+  // the length if the runes end exactly at the end of the input.
+  static word utf_8_skip_runes(const uint8* input, word length, word from, word runes);
 #ifdef TOIT_WINDOWS
   static inline word utf_16_to_8(const wchar_t* input, word length, uint8* output, word output_length) {
     return utf_16_to_8(reinterpret_cast<const uint16*>(input), length, output, output_length);
@@ -326,7 +332,9 @@ class Utils {
     return prefix & ((1 << (7 - n_byte_sequence)) - 1);
   }
 
-  static bool is_valid_utf_8(const uint8* buffer, int length);
+  // If $is_ascii is not null, it is set to whether the buffer only contains
+  // ASCII characters.  It is only meaningful if the function returns true.
+  static bool is_valid_utf_8(const uint8* buffer, int length, bool* is_ascii = null);
 
  private:
   static const uint8 REVERSE_NIBBLE[16];
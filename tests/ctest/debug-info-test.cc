@@ -0,0 +1,102 @@
+// Copyright (C) 2024 Toitware ApS.
+// Use of this source code is governed by a Zero-Clause BSD license that can
+// be found in the tests/LICENSE file.
+
+#include <string.h>
+
+#include "../../src/compiler/compiler.h"
+#include "../../src/debug_info.h"
+#include "../../src/flags.h"
+#include "../../src/objects_inline.h"
+#include "../../src/os.h"
+#include "../../src/snapshot.h"
+#include "../../src/snapshot_bundle.h"
+#include "../../src/third_party/dartino/gc_metadata.h"
+
+namespace toit {
+
+static SnapshotBundle compile(const char* input_path) {
+  Flags::no_fork = true;
+  compiler::Compiler compiler;
+  return compiler.compile(input_path,
+                          null,
+                          null, {
+                            .dep_file = null,
+                            .dep_format = compiler::Compiler::DepFormat::none,
+                            .project_root = null,
+                            .force = false,
+                            .werror = true,
+                          });
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) FATAL("wrong number of arguments");
+  throwing_new_allowed = true;
+  OS::set_up();
+  ObjectMemory::set_up();
+
+  auto bundle = compile(argv[1]);
+  throwing_new_allowed = true;
+
+  List<const uint8> source_map;
+  if (!bundle.source_map(&source_map)) FATAL("no source map");
+  uint8 uuid[UUID_SIZE];
+  if (!bundle.uuid(uuid)) FATAL("no uuid");
+  int size;
+  uint8* data = DebugInfo::build(source_map, uuid, &size);
+  if (data == null) FATAL("couldn't build debug info");
+  DebugInfo debug_info(data, size);
+  if (!debug_info.is_valid()) FATAL("invalid debug info");
+  if (memcmp(debug_info.uuid(), uuid, UUID_SIZE) != 0) FATAL("wrong uuid");
+  if (DebugInfo(data, size - 4).is_valid()) FATAL("truncation not detected");
+
+  // Entries that point outside their sections are detected.
+  auto methods = reinterpret_cast<DebugInfo::MethodEntry*>(data + sizeof(DebugInfo::Header));
+  uint32 name = methods[0].name;
+  methods[0].name = size;
+  if (DebugInfo(data, size).is_valid()) FATAL("corrupt name not detected");
+  methods[0].name = name;
+  uint32 position_count = methods[0].position_count;
+  methods[0].position_count = 0xffffffff;
+  if (DebugInfo(data, size).is_valid()) FATAL("corrupt positions not detected");
+  methods[0].position_count = position_count;
+  if (!debug_info.is_valid()) FATAL("invalid debug info after restoring");
+
+  auto image = bundle.snapshot().read_image(null);
+  Program* program = image.program();
+  int bytecodes_length = program->bytecodes.length();
+
+  bool found_call = false;
+  bool found_block = false;
+  int last_method_id = -1;
+  for (int bci = 0; bci < bytecodes_length; bci++) {
+    DebugInfo::Location location;
+    if (!debug_info.lookup(bci, &location)) continue;
+    if (location.method_id > bci) FATAL("method starts after bci");
+    if (location.method_id < last_method_id) FATAL("methods not sorted");
+    last_method_id = location.method_id;
+    if (location.bci != bci - location.method_id - Method::entry_offset()) FATAL("wrong relative bci");
+    if (strcmp(location.name, "Foo.call-bar") == 0 && location.line == 7) {
+      if (location.column != 12) FATAL("wrong column for call");
+      if (strstr(location.path, "debug-info-input.toit") == null) FATAL("wrong path");
+      found_call = true;
+    }
+    if (strcmp(location.name, "main.<block>") == 0) found_block = true;
+  }
+  if (!found_call) FATAL("call to bar not found");
+  if (!found_block) FATAL("block in main not found");
+
+  DebugInfo::Location location;
+  if (debug_info.lookup(bytecodes_length + 100, &location)) FATAL("found bci outside of program");
+
+  image.release();
+  free(data);
+  free(bundle.buffer());
+  return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+  return toit::main(argc, argv);
+}
@@ -0,0 +1,122 @@
+// Copyright (C) 2024 Toitware ApS.
+// Use of this source code is governed by a Zero-Clause BSD license that can
+// be found in the tests/LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "../../src/compiler/filesystem_hybrid.h"
+#include "../../src/compiler/filesystem_local.h"
+#include "../../src/os.h"
+
+namespace toit {
+namespace compiler {
+
+static void write_file(const std::string& path, const std::string& content) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == null) FATAL("couldn't create %s", path.c_str());
+  fwrite(content.c_str(), 1, content.size(), file);
+  fclose(file);
+}
+
+static std::string content_of(Filesystem* fs, const std::string& path) {
+  int size;
+  auto content = fs->read_content(path.c_str(), &size);
+  if (content == null) FATAL("couldn't read %s", path.c_str());
+  std::string result(reinterpret_cast<const char*>(content), size);
+  free(const_cast<uint8*>(content));
+  return result;
+}
+
+// The cached filesystem must give the same answers as the uncached one.
+static void check_same(Filesystem* cached, Filesystem* uncached, const std::string& path) {
+  const char* p = path.c_str();
+  if (cached->exists(p) != uncached->exists(p)) FATAL("exists differs for %s", p);
+  if (cached->is_regular_file(p) != uncached->is_regular_file(p)) FATAL("is_regular_file differs for %s", p);
+  if (cached->is_directory(p) != uncached->is_directory(p)) FATAL("is_directory differs for %s", p);
+}
+
+int main(int argc, char** argv) {
+  throwing_new_allowed = true;
+  OS::set_up();
+
+  char directory_template[] = "/tmp/filesystem-test-XXXXXX";
+  if (mkdtemp(directory_template) == null) FATAL("couldn't create temporary directory");
+  std::string root = directory_template;
+
+  mkdir((root + "/src").c_str(), 0700);
+  mkdir((root + "/src/nested").c_str(), 0700);
+  std::vector<std::string> files;
+  for (int i = 0; i < 20; i++) {
+    std::string path = root + "/src/file" + std::to_string(i) + ".toit";
+    write_file(path, "content " + std::to_string(i));
+    files.push_back(path);
+  }
+  write_file(root + "/src/nested/nested.toit", "nested");
+  if (symlink((root + "/src/file0.toit").c_str(), (root + "/src/link.toit").c_str()) != 0) FATAL("symlink");
+  if (symlink((root + "/src/nested").c_str(), (root + "/src/link-dir").c_str()) != 0) FATAL("symlink");
+  if (symlink((root + "/missing").c_str(), (root + "/src/dangling.toit").c_str()) != 0) FATAL("symlink");
+
+  const char* probes[] = {
+    "", "/src", "/src/", "/src/file3.toit", "/src/file20.toit", "/src/nested",
+    "/src/nested/nested.toit", "/src/nested/missing.toit", "/src/link.toit",
+    "/src/link-dir", "/src/link-dir/nested.toit", "/src/dangling.toit",
+    "/src/missing/file.toit", "/src/file3.toit/file.toit", "/missing",
+  };
+
+  FilesystemHybrid cached(null);
+  FilesystemLocal uncached;
+  cached.initialize(null);
+  uncached.initialize(null);
+  // Twice, so the second round is answered from the cache.
+  for (int round = 0; round < 2; round++) {
+    for (auto probe : probes) check_same(&cached, &uncached, root + probe);
+  }
+  auto statistics = cached.statistics();
+  if (statistics.probes < 2 * 3 * static_cast<int>(ARRAY_SIZE(probes))) FATAL("probes not counted");
+  if (statistics.directory_reads == 0) FATAL("directories not listed");
+  if (statistics.stats >= static_cast<int>(ARRAY_SIZE(probes))) FATAL("too many stats: %d", statistics.stats);
+
+  // Prefetched files are read once, and only handed out once.
+  if (!cached.can_prefetch()) FATAL("can't prefetch");
+  std::vector<std::string> prefetch_paths = files;
+  prefetch_paths.push_back(root + "/src/file20.toit");  // Missing.
+  prefetch_paths.push_back(files[0]);                   // Duplicate.
+  cached.prefetch(prefetch_paths);
+  statistics = cached.statistics();
+  if (statistics.prefetched != static_cast<int>(files.size())) FATAL("prefetched %d", statistics.prefetched);
+  for (size_t i = 0; i < files.size(); i++) {
+    if (content_of(&cached, files[i]) != "content " + std::to_string(i)) FATAL("wrong content for %s", files[i].c_str());
+  }
+  if (cached.statistics().file_reads != statistics.file_reads) FATAL("prefetched files read again");
+  if (content_of(&cached, files[3]) != "content 3") FATAL("wrong content after prefetch");
+  if (cached.statistics().file_reads != statistics.file_reads + 1) FATAL("file read not counted");
+
+  // Intercepted files take precedence over the disk and are never prefetched.
+  std::string intercepted_path = root + "/src/intercepted.toit";
+  cached.register_intercepted(intercepted_path, reinterpret_cast<const uint8*>("intercepted"), 11);
+  if (!cached.is_regular_file(intercepted_path.c_str())) FATAL("intercepted file not found");
+
+  for (auto probe : { "/src/link.toit", "/src/link-dir", "/src/dangling.toit" }) {
+    unlink((root + probe).c_str());
+  }
+  for (auto path : files) unlink(path.c_str());
+  unlink((root + "/src/nested/nested.toit").c_str());
+  rmdir((root + "/src/nested").c_str());
+  rmdir((root + "/src").c_str());
+  rmdir(root.c_str());
+  return 0;
+}
+
+} // namespace toit::compiler
+} // namespace toit
+
+int main(int argc, char** argv) {
+  return toit::compiler::main(argc, argv);
+}
@@ -12,6 +12,7 @@
 #include "../../src/compiler/compiler.h"
 #include "../../src/flags.h"
 #include "../../src/snapshot.h"
+#include "../../src/snapshot_compression.h"
 #include "../../src/os.h"
 #include "../../src/third_party/dartino/gc_metadata.h"
 
@@ -104,6 +105,30 @@ int main(int argc, char** argv) {
     if (memcmp(generator.the_buffer(), bytecodes, generator.the_length()) != 0) FATAL("not equal");
   }
 
+  {
+    // Check that the compressed snapshot decodes to the same program.
+    int compressed_size;
+    uint8* compressed = CompressedSnapshot::compress(bytecodes, bytecodes_size, &compressed_size);
+    if (compressed_size >= bytecodes_size) FATAL("not compressed");
+    auto image = Snapshot(compressed, compressed_size).read_image(null);
+    auto program = reinterpret_cast<Program*>(image.address());
+    SnapshotGenerator generator(program);
+    generator.generate(program);
+    if (generator.the_length() != bytecodes_size) FATAL("not same size");
+    if (memcmp(generator.the_buffer(), bytecodes, generator.the_length()) != 0) FATAL("not equal");
+    image.release();
+
+    // Check that an intermediate block offset outside the data is rejected.
+    if (CompressedSnapshot(compressed, compressed_size).block_count() < 2) FATAL("single block");
+    uint8* offset = compressed + CompressedSnapshot::HEADER_BYTE_SIZE + UINT32_SIZE;
+    uint32 original = Utils::read_unaligned_uint32_le(offset);
+    Utils::write_unaligned_uint32_le(offset, compressed_size);
+    if (CompressedSnapshot(compressed, compressed_size).is_valid()) FATAL("corrupt offset accepted");
+    Utils::write_unaligned_uint32_le(offset, original);
+    if (!CompressedSnapshot(compressed, compressed_size).is_valid()) FATAL("not valid");
+    free(compressed);
+  }
+
   // Transform it to be position independent.
   ProgramImage relocatable = anchored_to_relocatable(anchored_image);
   // Try again, to verify that the two don't differ.
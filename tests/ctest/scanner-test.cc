@@ -0,0 +1,290 @@
+// Copyright (C) 2024 Toitware ApS.
+// Use of this source code is governed by a Zero-Clause BSD license that can
+// be found in the tests/LICENSE file.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "../../src/compiler/byte_scanner.h"
+#include "../../src/compiler/diagnostic.h"
+#include "../../src/compiler/scanner.h"
+#include "../../src/compiler/symbol_canonicalizer.h"
+#include "../../src/flags.h"
+#include "../../src/os.h"
+
+namespace toit {
+namespace compiler {
+
+class TestSource : public Source {
+ public:
+  TestSource(const std::string& path, const uint8* text, int size)
+      : path_(path), text_(text), size_(size) {}
+
+  const char* absolute_path() const { return path_.c_str(); }
+  Package package() const { return Package::invalid(); }
+  std::string error_path() const { return path_; }
+  const uint8* text() const { return text_; }
+  Range range(int from, int to) const {
+    return Range(Position::from_token(from), Position::from_token(to));
+  }
+  int size() const { return size_; }
+  int offset_in_source(Position position) const { return position.token(); }
+  bool is_lsp_marker_at(int offset) { return false; }
+  void text_range_without_marker(int from, int to, const uint8** text_from, const uint8** text_to) {
+    *text_from = &text_[from];
+    *text_to = &text_[to];
+  }
+
+ private:
+  std::string path_;
+  const uint8* text_;
+  int size_;
+};
+
+struct ScannedToken {
+  int kind;
+  int from;
+  int to;
+  int indentation;
+  bool is_attached;
+  std::string data;
+
+  bool operator==(const ScannedToken& other) const {
+    return kind == other.kind &&
+        from == other.from &&
+        to == other.to &&
+        indentation == other.indentation &&
+        is_attached == other.is_attached &&
+        data == other.data;
+  }
+};
+
+static void add(std::vector<ScannedToken>* tokens, const Scanner::State& state) {
+  tokens->push_back({
+    .kind = state.token(),
+    .from = state.from,
+    .to = state.to,
+    .indentation = state.indentation,
+    .is_attached = state.is_attached(),
+    .data = state.data.is_valid() ? state.data.c_str() : "",
+  });
+}
+
+// Scans the whole source, driving the scanner through string interpolations
+// roughly the way the parser does. Comments are appended as pseudo tokens.
+static std::vector<ScannedToken> scan(Source* source, SymbolCanonicalizer* symbols, bool* had_errors) {
+  NullDiagnostics diagnostics(static_cast<SourceManager*>(null));
+  Scanner scanner(source, symbols, &diagnostics);
+  scanner.skip_hash_bang_line();
+  std::vector<ScannedToken> tokens;
+  while (true) {
+    auto state = scanner.next();
+    add(&tokens, state);
+    if (state.token() == Token::EOS) break;
+    while (state.token() == Token::STRING_PART || state.token() == Token::STRING_PART_MULTI_LINE) {
+      bool is_multiline = state.token() == Token::STRING_PART_MULTI_LINE;
+      state = scanner.next_interpolated_part();
+      add(&tokens, state);
+      if (state.token() == Token::LPAREN) {
+        int depth = 1;
+        while (depth > 0 && state.token() != Token::EOS) {
+          state = scanner.next();
+          add(&tokens, state);
+          if (state.token() == Token::LPAREN) depth++;
+          if (state.token() == Token::RPAREN) depth--;
+        }
+      }
+      if (state.token() == Token::EOS) break;
+      state = scanner.next_string_part(is_multiline);
+      add(&tokens, state);
+    }
+    if (state.token() == Token::EOS) break;
+  }
+  for (auto comment : scanner.comments()) {
+    tokens.push_back({
+      .kind = comment.is_multiline() ? -1 : -2,
+      .from = comment.range().from().token(),
+      .to = comment.range().to().token(),
+      .indentation = 0,
+      .is_attached = comment.is_toitdoc(),
+      .data = "",
+    });
+  }
+  *had_errors = diagnostics.encountered_error();
+  return tokens;
+}
+
+static std::string read_file(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == null) FATAL("couldn't open %s", path.c_str());
+  std::string result;
+  char buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) result.append(buffer, read);
+  fclose(file);
+  return result;
+}
+
+static void collect_toit_files(const std::string& directory, std::vector<std::string>* paths) {
+  DIR* dir = opendir(directory.c_str());
+  if (dir == null) return;
+  while (struct dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] == '.') continue;
+    std::string path = directory + "/" + entry->d_name;
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) continue;
+    if (S_ISDIR(info.st_mode)) {
+      collect_toit_files(path, paths);
+    } else if (path.size() > 5 && path.compare(path.size() - 5, 5, ".toit") == 0) {
+      paths->push_back(path);
+    }
+  }
+  closedir(dir);
+}
+
+static const uint8* reference_skip(const uint8* from, const uint8* to, const char* members, bool negate) {
+  while (from < to && (*from != '\0' && strchr(members, *from) != null) != negate) from++;
+  return from;
+}
+
+// Compares the byte scanner against a straightforward implementation for
+// all bytes at all offsets of a vector.
+static void test_byte_scanner() {
+  const char* identifier_parts =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+  uint8 buffer[64];
+  for (int scalar = 0; scalar < 2; scalar++) {
+    Flags::scalar_scanner = scalar == 1;
+    for (int c = 0; c < 256; c++) {
+      for (int position = 0; position < 40; position++) {
+        memset(buffer, 'a', sizeof(buffer));
+        buffer[position] = c;
+        for (int length = position; length <= 48; length += 7) {
+          const uint8* from = buffer;
+          const uint8* to = buffer + length;
+          memset(buffer, ' ', position);
+          if (ByteScanner::skip_blanks(from, to) != reference_skip(from, to, " \t", false)) FATAL("blanks");
+          if (ByteScanner::skip_spaces(from, to) != reference_skip(from, to, " ", false)) FATAL("spaces");
+          memset(buffer, 'a', position);
+          if (ByteScanner::skip_identifier_part(from, to) != reference_skip(from, to, identifier_parts, false)) {
+            FATAL("identifier part %d at %d", c, position);
+          }
+          if (ByteScanner::skip_line_text(from, to) != reference_skip(from, to, "\r\n", true)) FATAL("line");
+          if (ByteScanner::skip_string_text(from, to) != reference_skip(from, to, "\"\\$\r\n", true)) FATAL("string");
+          if (ByteScanner::skip_comment_text(from, to) != reference_skip(from, to, "*/\\", true)) FATAL("comment");
+        }
+      }
+    }
+  }
+  Flags::scalar_scanner = false;
+}
+
+static int64 scan_all(const std::vector<std::string>& sources,
+                      SymbolCanonicalizer* symbols,
+                      std::vector<std::vector<ScannedToken>>* results) {
+  int64 start = OS::get_monotonic_time();
+  for (size_t i = 0; i < sources.size(); i++) {
+    TestSource source("", reinterpret_cast<const uint8*>(sources[i].c_str()), sources[i].size());
+    bool had_errors;
+    (*results)[i] = scan(&source, symbols, &had_errors);
+    // Record whether there were errors as a final pseudo token.
+    (*results)[i].push_back({
+      .kind = had_errors ? -3 : -4,
+      .from = 0,
+      .to = 0,
+      .indentation = 0,
+      .is_attached = false,
+      .data = "",
+    });
+  }
+  return OS::get_monotonic_time() - start;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) FATAL("wrong number of arguments");
+  throwing_new_allowed = true;
+  OS::set_up();
+
+  test_byte_scanner();
+
+  // Scan the input and all the Toit sources of the SDK: the library and the tests.
+  std::string input = argv[1];
+  std::string tests_directory = input.substr(0, input.rfind('/')) + "/..";
+  std::vector<std::string> paths;
+  paths.push_back(input);
+  collect_toit_files(tests_directory + "/../lib", &paths);
+  collect_toit_files(tests_directory, &paths);
+
+  std::vector<std::string> sources;
+  size_t total_size = 0;
+  for (auto path : paths) {
+    sources.push_back(read_file(path));
+    total_size += sources.back().size();
+  }
+  // The input again, with Windows line endings.
+  std::string crlf;
+  for (char c : sources[0]) {
+    if (c == '\n') crlf += '\r';
+    crlf += c;
+  }
+  sources.push_back(crlf);
+  paths.push_back(input + " (crlf)");
+
+  SymbolCanonicalizer symbols;
+  std::vector<std::vector<ScannedToken>> scalar(sources.size());
+  std::vector<std::vector<ScannedToken>> vector(sources.size());
+  // Warm up the caches and the symbol table, so both timed runs see the
+  // same state.
+  scan_all(sources, &symbols, &vector);
+  Flags::scalar_scanner = true;
+  int64 scalar_time = scan_all(sources, &symbols, &scalar);
+  Flags::scalar_scanner = false;
+  int64 vector_time = scan_all(sources, &symbols, &vector);
+
+  for (size_t i = 0; i < sources.size(); i++) {
+    if (scalar[i].size() != vector[i].size()) {
+      FATAL("token count differs for %s: %zd != %zd", paths[i].c_str(), scalar[i].size(), vector[i].size());
+    }
+    for (size_t j = 0; j < scalar[i].size(); j++) {
+      if (!(scalar[i][j] == vector[i][j])) {
+        FATAL("token %zd differs for %s at offset %d", j, paths[i].c_str(), scalar[i][j].from);
+      }
+    }
+  }
+  if (scalar[0].size() < 100) FATAL("input not scanned");
+
+  // Every prefix of the input, so all paths to the end of the source are
+  // exercised.
+  for (size_t i = 0; i < sources[0].size(); i++) {
+    std::string prefix = sources[0].substr(0, i);
+    TestSource source("", reinterpret_cast<const uint8*>(prefix.c_str()), prefix.size());
+    bool scalar_errors;
+    bool vector_errors;
+    Flags::scalar_scanner = true;
+    auto scalar_tokens = scan(&source, &symbols, &scalar_errors);
+    Flags::scalar_scanner = false;
+    auto vector_tokens = scan(&source, &symbols, &vector_errors);
+    if (scalar_tokens != vector_tokens || scalar_errors != vector_errors) {
+      FATAL("tokens differ for the first %zd bytes of the input", i);
+    }
+  }
+
+  printf("Scanned %zd files (%zd KB)\n", paths.size(), total_size / KB);
+  printf("Scalar: %lld us\n", static_cast<long long>(scalar_time));
+  printf("%s: %lld us\n",
+         ByteScanner::has_vector_support() ? "Vector" : "Scalar (no vector support)",
+         static_cast<long long>(vector_time));
+  return 0;
+}
+
+} // namespace toit::compiler
+} // namespace toit
+
+int main(int argc, char** argv) {
+  return toit::compiler::main(argc, argv);
+}
@@ -111,10 +111,52 @@ void test_equals() {
   if (!Utils::utf_8_equals_utf_16(str_8z, 10, str_16, 5)) fatal(__LINE__);        // Omit last char.
 }
 
+void test_long_mixed() {
+  // Runs of ASCII of different lengths, so the bulk paths start and stop
+  // at all offsets.
+  static uint8 utf_8[2000];
+  word length = 0;
+  word runes = 0;
+  word utf_16_length = 0;
+  for (int run = 0; run < 40; run++) {
+    for (int i = 0; i < run; i++) utf_8[length++] = 'a' + (i % 26);
+    memcpy(utf_8 + length, "æ€😹", 9);
+    length += 9;
+    runes += run + 3;
+    utf_16_length += run + 4;
+  }
+  if (Utils::utf_8_rune_count(utf_8, length) != runes) fatal(__LINE__);
+  if (Utils::utf_8_to_16(utf_8, length) != utf_16_length) fatal(__LINE__);
+
+  static uint16 utf_16[2000];
+  if (Utils::utf_8_to_16(utf_8, length, utf_16, utf_16_length) != utf_16_length) fatal(__LINE__);
+  for (word i = utf_16_length - 1; i >= 0; i -= 7) {
+    if (Utils::utf_8_to_16(utf_8, length, utf_16, i) != -1) fatal(__LINE__);
+  }
+  if (Utils::utf_16_to_8(utf_16, utf_16_length) != length) fatal(__LINE__);
+  static uint8 round_trip[2000];
+  if (Utils::utf_16_to_8(utf_16, utf_16_length, round_trip, length) != length) fatal(__LINE__);
+  if (memcmp(utf_8, round_trip, length) != 0) fatal(__LINE__);
+  for (word i = length - 1; i >= 0; i -= 7) {
+    if (Utils::utf_16_to_8(utf_16, utf_16_length, round_trip, i) != -1) fatal(__LINE__);
+  }
+
+  // Skipping runes agrees with going through them one at a time.
+  word position = 0;
+  for (word rune = 0; rune <= runes; rune++) {
+    if (Utils::utf_8_skip_runes(utf_8, length, 0, rune) != position) fatal(__LINE__);
+    if (position < length) position += Utils::bytes_in_utf_8_sequence(utf_8[position]);
+  }
+  if (Utils::utf_8_skip_runes(utf_8, length, 0, runes + 1) != -1) fatal(__LINE__);
+  if (Utils::utf_8_skip_runes(utf_8, length, 0, runes + 100) != -1) fatal(__LINE__);
+  if (Utils::utf_8_skip_runes(utf_8, length, length, 0) != length) fatal(__LINE__);
+}
+
 int main(int argc, char **argv) {
   test_utf_16_to_8();
   test_utf_8_to_16();
   test_equals();
+  test_long_mixed();
   return 0;
 }
 
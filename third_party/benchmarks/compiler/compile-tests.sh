@@ -0,0 +1,35 @@
+#!/usr/bin/env bash
+# Copyright (C) 2024 Toitware ApS. All rights reserved.
+# Use of this source code is governed by an MIT-style license that can be
+# found in the lib/LICENSE file.
+
+# Compiles every test of the SDK and reports the total compilation time and
+# the highest peak memory of a single compilation.
+#
+# Usage: compile-tests.sh <path-to-toit.compile> [<optimization-level>]
+
+set -e
+
+TOITC=$1
+LEVEL=${2:-1}
+ROOT=$(cd "$(dirname "$0")/../../.." && pwd)
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+total_ms=0
+max_peak_kb=0
+count=0
+for test in "$ROOT"/tests/*-test.toit; do
+  report=$("$TOITC" -O$LEVEL -Xreport_compiler_memory -w "$OUT/test.snapshot" "$test" 2>/dev/null) || continue
+  # The compiler runs one pipeline for the program and one for its debug
+  # information. Each of them reports its own numbers.
+  ms=$(echo "$report" | awk '/^Compilation time:/ { sum += $3 } END { print sum + 0 }')
+  peak_kb=$(echo "$report" | awk '/^Peak memory:/ { if ($3 > max) max = $3 } END { print max + 0 }')
+  total_ms=$((total_ms + ms))
+  if [ "$peak_kb" -gt "$max_peak_kb" ]; then max_peak_kb=$peak_kb; fi
+  count=$((count + 1))
+done
+
+echo "Compiled $count tests with -O$LEVEL"
+echo "Total compilation time: $total_ms ms"
+echo "Highest peak memory: $max_peak_kb KB"